@@ -7,6 +7,9 @@ $CFLAGS << ' -O3 -msse -msse2 -msse3 -msse4.1 -msse4.2'
 
 # Check for dependencies
 have_header( 'emmintrin.h' )
+have_header( 'pthread.h' )
+have_library( 'pthread' )
+have_func( 'rb_ext_ractor_safe', 'ruby.h' )
 
 # Do the work
 create_makefile "vector_sse/vector_sse"
@@ -34,6 +34,23 @@
 #include "vector_sse_sum.h"
 #include "vector_sse_mul.h"
 #include "vector_sse_vec_mul.h"
+#include "vector_sse_cumsum.h"
+#include "vector_sse_distance.h"
+#include "vector_sse_packed.h"
+#include "vector_sse_convert.h"
+#include "vector_sse_broadcast.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_sparse.h"
+#include "vector_sse_linalg.h"
+#include "vector_sse_gather.h"
+#include "vector_sse_histogram.h"
+#include "vector_sse_sort.h"
+#include "vector_sse_convolve.h"
+#include "vector_sse_syrk.h"
+#include "vector_sse_chain.h"
+#include "vector_sse_async.h"
+#include "vector_sse_tuning.h"
+#include "vector_sse_accumulator.h"
 
 // TODO:
 struct vector_sse_result {
@@ -43,6 +60,8 @@ struct vector_sse_result {
 
 // Defining a space for information and references about the module to be stored internally
 VALUE VectorSSE = Qnil;
+VALUE VectorSSEJob = Qnil;
+VALUE VectorSSEAccumulator = Qnil;
 
 // Prototype for the initialization method - Ruby calls this, not you
 void Init_vector_sse();
@@ -51,6 +70,12 @@ void Init_vector_sse();
 // The initialization method for this module
 void Init_vector_sse() {
 
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+   // Kernels keep their state on the stack or in the objects they are
+   // given, so they may run in any Ractor.
+   rb_ext_ractor_safe( true );
+#endif
+
    VectorSSE = rb_define_module("VectorSSE");
 
    rb_define_singleton_method( VectorSSE, "add_s32", method_vec_add_s32, 2 );
@@ -71,10 +96,142 @@ void Init_vector_sse() {
    rb_define_singleton_method( VectorSSE, "mul_s32", method_mat_mul_s32, 6 );
    rb_define_singleton_method( VectorSSE, "mul_s64", method_mat_mul_s64, 6 );
    rb_define_singleton_method( VectorSSE, "mul_f32", method_mat_mul_f32, 6 );
+   rb_define_singleton_method( VectorSSE, "mul_f64", method_mat_mul_f64, 6 );
 
    rb_define_singleton_method( VectorSSE, "vec_mul_s32", method_vec_mul_s32, 2 );
    rb_define_singleton_method( VectorSSE, "vec_mul_s64", method_vec_mul_s64, 2 );
    rb_define_singleton_method( VectorSSE, "vec_mul_f32", method_vec_mul_f32, 2 );
    rb_define_singleton_method( VectorSSE, "vec_mul_f64", method_vec_mul_f64, 2 );
+
+   rb_define_singleton_method( VectorSSE, "cumsum_s32", method_cumsum_s32, 5 );
+   rb_define_singleton_method( VectorSSE, "cumsum_s64", method_cumsum_s64, 5 );
+   rb_define_singleton_method( VectorSSE, "cumsum_f32", method_cumsum_f32, 5 );
+   rb_define_singleton_method( VectorSSE, "cumsum_f64", method_cumsum_f64, 5 );
+
+   rb_define_singleton_method( VectorSSE, "cumprod_s32", method_cumprod_s32, 5 );
+   rb_define_singleton_method( VectorSSE, "cumprod_s64", method_cumprod_s64, 5 );
+   rb_define_singleton_method( VectorSSE, "cumprod_f32", method_cumprod_f32, 5 );
+   rb_define_singleton_method( VectorSSE, "cumprod_f64", method_cumprod_f64, 5 );
+
+   rb_define_singleton_method( VectorSSE, "pairwise_f32", method_pairwise_f32, 7 );
+   rb_define_singleton_method( VectorSSE, "pairwise_f64", method_pairwise_f64, 7 );
+
+   rb_define_singleton_method( VectorSSE, "knn_f32", method_knn_f32, 8 );
+   rb_define_singleton_method( VectorSSE, "knn_f64", method_knn_f64, 8 );
+
+   rb_define_singleton_method( VectorSSE, "pack", method_pack, 4 );
+   rb_define_singleton_method( VectorSSE, "unpack", method_unpack, 4 );
+   rb_define_singleton_method( VectorSSE, "mul_packed", method_mul_packed, 11 );
+
+   rb_define_singleton_method( VectorSSE, "convert", method_convert, 5 );
+
+   rb_define_singleton_method( VectorSSE, "broadcast_s32", method_broadcast_s32, 7 );
+   rb_define_singleton_method( VectorSSE, "broadcast_s64", method_broadcast_s64, 7 );
+   rb_define_singleton_method( VectorSSE, "broadcast_f32", method_broadcast_f32, 7 );
+   rb_define_singleton_method( VectorSSE, "broadcast_f64", method_broadcast_f64, 7 );
+
+   rb_define_singleton_method( VectorSSE, "thread_count", method_get_thread_count, 0 );
+   rb_define_singleton_method( VectorSSE, "tuning", method_get_tuning, 0 );
+   rb_define_singleton_method( VectorSSE, "benchmark_gemm", method_benchmark_gemm, 3 );
+
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+   // Thread count and tuning are process-wide, so only the main Ractor
+   // may change them.
+   rb_ext_ractor_safe( false );
+#endif
+
+   rb_define_singleton_method( VectorSSE, "thread_count=", method_set_thread_count, 1 );
+
+   rb_define_singleton_method( VectorSSE, "tuning=", method_set_tuning, 1 );
+   rb_define_singleton_method( VectorSSE, "reset_tuning!", method_reset_tuning, 0 );
+   rb_define_singleton_method( VectorSSE, "load_profile", method_load_profile, 1 );
+
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+   rb_ext_ractor_safe( true );
+#endif
+
+   tuning_load_default_profile();
+
+   rb_define_singleton_method( VectorSSE, "csr_from_coo_f32", method_csr_from_coo_f32, 5 );
+   rb_define_singleton_method( VectorSSE, "csr_from_coo_f64", method_csr_from_coo_f64, 5 );
+   rb_define_singleton_method( VectorSSE, "csr_from_dense_f32", method_csr_from_dense_f32, 3 );
+   rb_define_singleton_method( VectorSSE, "csr_from_dense_f64", method_csr_from_dense_f64, 3 );
+   rb_define_singleton_method( VectorSSE, "csr_to_dense_f32", method_csr_to_dense_f32, 4 );
+   rb_define_singleton_method( VectorSSE, "csr_to_dense_f64", method_csr_to_dense_f64, 4 );
+
+   rb_define_singleton_method( VectorSSE, "spmv_f32", method_spmv_f32, 5 );
+   rb_define_singleton_method( VectorSSE, "spmv_f64", method_spmv_f64, 5 );
+   rb_define_singleton_method( VectorSSE, "spmm_f32", method_spmm_f32, 6 );
+   rb_define_singleton_method( VectorSSE, "spmm_f64", method_spmm_f64, 6 );
+
+   rb_define_singleton_method( VectorSSE, "lu_f32", method_lu_f32, 2 );
+   rb_define_singleton_method( VectorSSE, "lu_f64", method_lu_f64, 2 );
+   rb_define_singleton_method( VectorSSE, "solve_f32", method_solve_f32, 4 );
+   rb_define_singleton_method( VectorSSE, "solve_f64", method_solve_f64, 4 );
+   rb_define_singleton_method( VectorSSE, "inverse_f32", method_inverse_f32, 2 );
+   rb_define_singleton_method( VectorSSE, "inverse_f64", method_inverse_f64, 2 );
+   rb_define_singleton_method( VectorSSE, "cholesky_f32", method_cholesky_f32, 2 );
+   rb_define_singleton_method( VectorSSE, "cholesky_f64", method_cholesky_f64, 2 );
+
+   rb_define_singleton_method( VectorSSE, "take", method_take, 3 );
+   rb_define_singleton_method( VectorSSE, "put", method_put, 4 );
+   rb_define_singleton_method( VectorSSE, "index_add_s32", method_index_add_s32, 4 );
+   rb_define_singleton_method( VectorSSE, "index_add_s64", method_index_add_s64, 4 );
+   rb_define_singleton_method( VectorSSE, "index_add_f32", method_index_add_f32, 4 );
+   rb_define_singleton_method( VectorSSE, "index_add_f64", method_index_add_f64, 4 );
+
+   rb_define_singleton_method( VectorSSE, "histogram", method_histogram, 4 );
+   rb_define_singleton_method( VectorSSE, "histogram_edges", method_histogram_edges, 2 );
+   rb_define_singleton_method( VectorSSE, "digitize", method_digitize, 2 );
+
+   rb_define_singleton_method( VectorSSE, "sort_s32", method_sort_s32, 1 );
+   rb_define_singleton_method( VectorSSE, "sort_s64", method_sort_s64, 1 );
+   rb_define_singleton_method( VectorSSE, "sort_f32", method_sort_f32, 1 );
+   rb_define_singleton_method( VectorSSE, "sort_f64", method_sort_f64, 1 );
+
+   rb_define_singleton_method( VectorSSE, "argsort_s32", method_argsort_s32, 1 );
+   rb_define_singleton_method( VectorSSE, "argsort_s64", method_argsort_s64, 1 );
+   rb_define_singleton_method( VectorSSE, "argsort_f32", method_argsort_f32, 1 );
+   rb_define_singleton_method( VectorSSE, "argsort_f64", method_argsort_f64, 1 );
+
+   rb_define_singleton_method( VectorSSE, "top_k_s32", method_top_k_s32, 2 );
+   rb_define_singleton_method( VectorSSE, "top_k_s64", method_top_k_s64, 2 );
+   rb_define_singleton_method( VectorSSE, "top_k_f32", method_top_k_f32, 2 );
+   rb_define_singleton_method( VectorSSE, "top_k_f64", method_top_k_f64, 2 );
+
+   rb_define_singleton_method( VectorSSE, "correlate_f32", method_correlate_f32, 7 );
+   rb_define_singleton_method( VectorSSE, "correlate_f64", method_correlate_f64, 7 );
+
+   rb_define_singleton_method( VectorSSE, "gram_f32", method_gram_f32, 5 );
+   rb_define_singleton_method( VectorSSE, "gram_f64", method_gram_f64, 5 );
+
+   rb_define_singleton_method( VectorSSE, "chain_order", method_chain_order, 1 );
+   rb_define_singleton_method( VectorSSE, "chain_mul_f32", method_chain_mul_f32, 3 );
+   rb_define_singleton_method( VectorSSE, "chain_mul_f64", method_chain_mul_f64, 3 );
+
+   rb_define_singleton_method( VectorSSE, "mul_async_f32", method_mul_async_f32, 7 );
+   rb_define_singleton_method( VectorSSE, "mul_async_f64", method_mul_async_f64, 7 );
+
+   VectorSSEJob = rb_define_class_under( VectorSSE, "Job", rb_cObject );
+   rb_undef_alloc_func( VectorSSEJob );
+   rb_define_method( VectorSSEJob, "ready?", method_job_ready, 0 );
+   rb_define_method( VectorSSEJob, "wait", method_job_wait, 0 );
+   rb_define_method( VectorSSEJob, "result", method_job_result, 0 );
+   rb_define_method( VectorSSEJob, "notify_fd", method_job_notify_fd, 0 );
+
+   VectorSSEAccumulator = rb_define_class_under( VectorSSE, "Accumulator", rb_cObject );
+   rb_define_alloc_func( VectorSSEAccumulator, accumulator_alloc );
+   rb_define_method( VectorSSEAccumulator, "initialize", method_accumulator_initialize, 1 );
+   rb_define_method( VectorSSEAccumulator, "type", method_accumulator_type, 0 );
+   rb_define_method( VectorSSEAccumulator, "add_array", method_accumulator_add_array, 1 );
+   rb_define_method( VectorSSEAccumulator, "add_bytes", method_accumulator_add_bytes, 1 );
+   rb_define_method( VectorSSEAccumulator, "merge!", method_accumulator_merge, 1 );
+   rb_define_method( VectorSSEAccumulator, "count", method_accumulator_count, 0 );
+   rb_define_method( VectorSSEAccumulator, "sum", method_accumulator_sum, 0 );
+   rb_define_method( VectorSSEAccumulator, "min", method_accumulator_min, 0 );
+   rb_define_method( VectorSSEAccumulator, "max", method_accumulator_max, 0 );
+   rb_define_method( VectorSSEAccumulator, "mean", method_accumulator_mean, 0 );
+   rb_define_method( VectorSSEAccumulator, "native_variance", method_accumulator_variance, 1 );
+   rb_define_method( VectorSSEAccumulator, "pending_bytes", method_accumulator_pending_bytes, 0 );
 }
 
@@ -0,0 +1,622 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <smmintrin.h>
+#include "vector_sse_accumulator.h"
+#include "vector_sse_convert.h"
+#include "ruby/thread.h"
+
+// Elements converted or reduced at a time. Bounds the memory used for
+// Array input and for realigning byte input.
+#define  ACCUMULATOR_CHUNK       (4096)
+
+// Byte strings at least this long are reduced with the GVL released.
+#define  ACCUMULATOR_NOGVL_BYTES (1 << 20)
+
+struct moments {
+   uint64_t count;
+   double   mean;
+   double   m2;
+   double   sum;
+   double   min;
+   double   max;
+   int64_t  int_sum;
+   int64_t  int_min;
+   int64_t  int_max;
+};
+
+struct accumulator {
+   int            type;
+   size_t         element_size;
+   struct moments state;
+
+   // Bytes of a partial element left over from the last byte chunk.
+   uint8_t        pending[ sizeof( int64_t ) ];
+   size_t         pending_length;
+
+   // Set while add_bytes runs without the GVL, when another Ruby thread
+   // could otherwise update the same accumulator underneath it.
+   int            busy;
+};
+
+typedef void ( *chunk_stats )( const void* data, size_t count, struct moments* out );
+
+static const rb_data_type_t accumulator_type = {
+   "VectorSSE::Accumulator",
+   { NULL, RUBY_TYPED_DEFAULT_FREE, NULL, },
+   0, 0, RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+static struct accumulator* accumulator_of( VALUE self )
+{
+   struct accumulator* acc = (struct accumulator*)rb_check_typeddata( self, &accumulator_type );
+
+   if ( acc->element_size == 0 )
+   {
+      rb_raise( rb_eRuntimeError, "uninitialized accumulator" );
+   }
+
+   return acc;
+}
+
+// As accumulator_of, for methods that change the accumulator.
+static struct accumulator* accumulator_for_update( VALUE self )
+{
+   struct accumulator* acc = accumulator_of( self );
+
+   if ( acc->busy )
+   {
+      rb_raise( rb_eRuntimeError, "accumulator is in use by another thread" );
+   }
+
+   return acc;
+}
+
+static int integer_type( int type )
+{
+   return ( type == VECTOR_TYPE_S32 ) || ( type == VECTOR_TYPE_S64 );
+}
+
+// Folds 'chunk' into 'into'. Both hold complete statistics for disjoint
+// parts of the stream.
+static void moments_merge( struct moments* into, const struct moments* chunk )
+{
+   uint64_t count = into->count + chunk->count;
+   double delta = chunk->mean - into->mean;
+
+   if ( chunk->count == 0 )
+   {
+      return;
+   }
+   if ( into->count == 0 )
+   {
+      *into = *chunk;
+      return;
+   }
+
+   into->mean += delta * chunk->count / count;
+   into->m2   += chunk->m2 + delta * delta * ( (double)into->count * chunk->count / count );
+   into->sum  += chunk->sum;
+   into->int_sum += chunk->int_sum;
+   into->min = ( chunk->min < into->min ) ? chunk->min : into->min;
+   into->max = ( chunk->max > into->max ) ? chunk->max : into->max;
+   into->int_min = ( chunk->int_min < into->int_min ) ? chunk->int_min : into->int_min;
+   into->int_max = ( chunk->int_max > into->int_max ) ? chunk->int_max : into->int_max;
+   into->count = count;
+}
+
+static inline double hsum_pd( __m128d vec )
+{
+   return _mm_cvtsd_f64( _mm_add_sd( vec, _mm_unpackhi_pd( vec, vec ) ) );
+}
+
+// Each chunk is reduced in two passes: sum, min and max first, then the
+// squared deviations from the chunk mean, which avoids the cancellation of
+// a single-pass sum of squares.
+
+static void stats_f32( const void* data, size_t count, struct moments* out )
+{
+   const float* values = (const float*)data;
+   size_t pos = 0;
+   double deviation = 0;
+
+   __m128  value_vec;
+   __m128  min_vec = _mm_set1_ps( values[ 0 ] );
+   __m128  max_vec = min_vec;
+   __m128d sum_lo = _mm_setzero_pd(), sum_hi = _mm_setzero_pd();
+   __m128d mean_vec, dev_lo, dev_hi;
+
+   memset( out, 0, sizeof( *out ) );
+   out->count = count;
+
+   for ( pos = 0; pos + 4 <= count; pos += 4 )
+   {
+      value_vec = _mm_loadu_ps( values + pos );
+      min_vec = _mm_min_ps( min_vec, value_vec );
+      max_vec = _mm_max_ps( max_vec, value_vec );
+      sum_lo = _mm_add_pd( sum_lo, _mm_cvtps_pd( value_vec ) );
+      sum_hi = _mm_add_pd( sum_hi, _mm_cvtps_pd( _mm_movehl_ps( value_vec, value_vec ) ) );
+   }
+
+   min_vec = _mm_min_ps( min_vec, _mm_movehl_ps( min_vec, min_vec ) );
+   max_vec = _mm_max_ps( max_vec, _mm_movehl_ps( max_vec, max_vec ) );
+   out->min = _mm_cvtss_f32( _mm_min_ss( min_vec, _mm_shuffle_ps( min_vec, min_vec, 1 ) ) );
+   out->max = _mm_cvtss_f32( _mm_max_ss( max_vec, _mm_shuffle_ps( max_vec, max_vec, 1 ) ) );
+
+   out->sum = hsum_pd( _mm_add_pd( sum_lo, sum_hi ) );
+   for ( ; pos < count; ++pos )
+   {
+      out->sum += values[ pos ];
+      out->min = ( values[ pos ] < out->min ) ? values[ pos ] : out->min;
+      out->max = ( values[ pos ] > out->max ) ? values[ pos ] : out->max;
+   }
+   out->mean = out->sum / count;
+
+   mean_vec = _mm_set1_pd( out->mean );
+   sum_lo = _mm_setzero_pd();
+   sum_hi = _mm_setzero_pd();
+   for ( pos = 0; pos + 4 <= count; pos += 4 )
+   {
+      value_vec = _mm_loadu_ps( values + pos );
+      dev_lo = _mm_sub_pd( _mm_cvtps_pd( value_vec ), mean_vec );
+      dev_hi = _mm_sub_pd( _mm_cvtps_pd( _mm_movehl_ps( value_vec, value_vec ) ), mean_vec );
+      sum_lo = _mm_add_pd( sum_lo, _mm_mul_pd( dev_lo, dev_lo ) );
+      sum_hi = _mm_add_pd( sum_hi, _mm_mul_pd( dev_hi, dev_hi ) );
+   }
+   out->m2 = hsum_pd( _mm_add_pd( sum_lo, sum_hi ) );
+   for ( ; pos < count; ++pos )
+   {
+      deviation = values[ pos ] - out->mean;
+      out->m2 += deviation * deviation;
+   }
+}
+
+static void stats_f64( const void* data, size_t count, struct moments* out )
+{
+   const double* values = (const double*)data;
+   size_t pos = 0;
+   double deviation = 0;
+
+   __m128d value_vec, dev_vec;
+   __m128d min_vec = _mm_set1_pd( values[ 0 ] );
+   __m128d max_vec = min_vec;
+   __m128d sum_vec = _mm_setzero_pd();
+   __m128d mean_vec;
+
+   memset( out, 0, sizeof( *out ) );
+   out->count = count;
+
+   for ( pos = 0; pos + 2 <= count; pos += 2 )
+   {
+      value_vec = _mm_loadu_pd( values + pos );
+      min_vec = _mm_min_pd( min_vec, value_vec );
+      max_vec = _mm_max_pd( max_vec, value_vec );
+      sum_vec = _mm_add_pd( sum_vec, value_vec );
+   }
+
+   out->min = _mm_cvtsd_f64( _mm_min_sd( min_vec, _mm_unpackhi_pd( min_vec, min_vec ) ) );
+   out->max = _mm_cvtsd_f64( _mm_max_sd( max_vec, _mm_unpackhi_pd( max_vec, max_vec ) ) );
+   out->sum = hsum_pd( sum_vec );
+   for ( ; pos < count; ++pos )
+   {
+      out->sum += values[ pos ];
+      out->min = ( values[ pos ] < out->min ) ? values[ pos ] : out->min;
+      out->max = ( values[ pos ] > out->max ) ? values[ pos ] : out->max;
+   }
+   out->mean = out->sum / count;
+
+   mean_vec = _mm_set1_pd( out->mean );
+   sum_vec = _mm_setzero_pd();
+   for ( pos = 0; pos + 2 <= count; pos += 2 )
+   {
+      dev_vec = _mm_sub_pd( _mm_loadu_pd( values + pos ), mean_vec );
+      sum_vec = _mm_add_pd( sum_vec, _mm_mul_pd( dev_vec, dev_vec ) );
+   }
+   out->m2 = hsum_pd( sum_vec );
+   for ( ; pos < count; ++pos )
+   {
+      deviation = values[ pos ] - out->mean;
+      out->m2 += deviation * deviation;
+   }
+}
+
+static void stats_s32( const void* data, size_t count, struct moments* out )
+{
+   const int32_t* values = (const int32_t*)data;
+   size_t pos = 0;
+   int64_t sums[ 2 ];
+   double deviation = 0;
+
+   __m128i value_vec;
+   __m128i min_vec = _mm_set1_epi32( values[ 0 ] );
+   __m128i max_vec = min_vec;
+   __m128i sum_vec = _mm_setzero_si128();
+   __m128d mean_vec, dev_lo, dev_hi;
+   __m128d m2_lo = _mm_setzero_pd(), m2_hi = _mm_setzero_pd();
+
+   memset( out, 0, sizeof( *out ) );
+   out->count = count;
+
+   for ( pos = 0; pos + 4 <= count; pos += 4 )
+   {
+      value_vec = _mm_loadu_si128( (const __m128i*)( values + pos ) );
+      min_vec = _mm_min_epi32( min_vec, value_vec );
+      max_vec = _mm_max_epi32( max_vec, value_vec );
+
+      // Widen to 64-bit lanes so that the sum cannot overflow.
+      sum_vec = _mm_add_epi64( sum_vec, _mm_cvtepi32_epi64( value_vec ) );
+      sum_vec = _mm_add_epi64( sum_vec, _mm_cvtepi32_epi64( _mm_unpackhi_epi64( value_vec, value_vec ) ) );
+   }
+
+   min_vec = _mm_min_epi32( min_vec, _mm_shuffle_epi32( min_vec, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+   max_vec = _mm_max_epi32( max_vec, _mm_shuffle_epi32( max_vec, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+   out->int_min = _mm_cvtsi128_si32( _mm_min_epi32( min_vec, _mm_shuffle_epi32( min_vec, _MM_SHUFFLE( 2, 3, 0, 1 ) ) ) );
+   out->int_max = _mm_cvtsi128_si32( _mm_max_epi32( max_vec, _mm_shuffle_epi32( max_vec, _MM_SHUFFLE( 2, 3, 0, 1 ) ) ) );
+
+   _mm_storeu_si128( (__m128i*)sums, sum_vec );
+   out->int_sum = sums[ 0 ] + sums[ 1 ];
+   for ( ; pos < count; ++pos )
+   {
+      out->int_sum += values[ pos ];
+      out->int_min = ( values[ pos ] < out->int_min ) ? values[ pos ] : out->int_min;
+      out->int_max = ( values[ pos ] > out->int_max ) ? values[ pos ] : out->int_max;
+   }
+   out->mean = (double)out->int_sum / count;
+
+   mean_vec = _mm_set1_pd( out->mean );
+   for ( pos = 0; pos + 4 <= count; pos += 4 )
+   {
+      value_vec = _mm_loadu_si128( (const __m128i*)( values + pos ) );
+      dev_lo = _mm_sub_pd( _mm_cvtepi32_pd( value_vec ), mean_vec );
+      dev_hi = _mm_sub_pd( _mm_cvtepi32_pd( _mm_unpackhi_epi64( value_vec, value_vec ) ), mean_vec );
+      m2_lo = _mm_add_pd( m2_lo, _mm_mul_pd( dev_lo, dev_lo ) );
+      m2_hi = _mm_add_pd( m2_hi, _mm_mul_pd( dev_hi, dev_hi ) );
+   }
+   out->m2 = hsum_pd( _mm_add_pd( m2_lo, m2_hi ) );
+   for ( ; pos < count; ++pos )
+   {
+      deviation = values[ pos ] - out->mean;
+      out->m2 += deviation * deviation;
+   }
+}
+
+// SSE has no 64-bit integer min, max or conversion to double, so S64 is
+// reduced with scalar code.
+static void stats_s64( const void* data, size_t count, struct moments* out )
+{
+   const int64_t* values = (const int64_t*)data;
+   size_t pos = 0;
+   double deviation = 0;
+
+   memset( out, 0, sizeof( *out ) );
+   out->count = count;
+   out->int_min = values[ 0 ];
+   out->int_max = values[ 0 ];
+
+   for ( pos = 0; pos < count; ++pos )
+   {
+      out->int_sum = (int64_t)( (uint64_t)out->int_sum + (uint64_t)values[ pos ] );
+      out->int_min = ( values[ pos ] < out->int_min ) ? values[ pos ] : out->int_min;
+      out->int_max = ( values[ pos ] > out->int_max ) ? values[ pos ] : out->int_max;
+      out->mean += values[ pos ];
+   }
+   out->mean /= count;
+
+   for ( pos = 0; pos < count; ++pos )
+   {
+      deviation = values[ pos ] - out->mean;
+      out->m2 += deviation * deviation;
+   }
+}
+
+static chunk_stats stats_for( int type )
+{
+   switch ( type )
+   {
+   case VECTOR_TYPE_S32: return stats_s32;
+   case VECTOR_TYPE_S64: return stats_s64;
+   case VECTOR_TYPE_F32: return stats_f32;
+   default:              return stats_f64;
+   }
+}
+
+struct bytes_job {
+   chunk_stats    stats;
+   const uint8_t* bytes;
+   size_t         count;
+   size_t         element_size;
+   struct moments result;
+};
+
+// Reduces 'count' elements starting at 'bytes' into job->result, copying
+// through an aligned buffer when the elements are not naturally aligned.
+static void* reduce_bytes( void* arg )
+{
+   struct bytes_job* job = (struct bytes_job*)arg;
+   struct moments chunk;
+   int64_t buffer[ ACCUMULATOR_CHUNK ];
+   size_t pos = 0;
+   size_t length = 0;
+   const void* source = NULL;
+
+   memset( &job->result, 0, sizeof( job->result ) );
+
+   for ( pos = 0; pos < job->count; pos += length )
+   {
+      length = ( job->count - pos < ACCUMULATOR_CHUNK ) ? job->count - pos : ACCUMULATOR_CHUNK;
+      source = job->bytes + pos * job->element_size;
+
+      if ( (uintptr_t)source % job->element_size != 0 )
+      {
+         memcpy( buffer, source, length * job->element_size );
+         source = buffer;
+      }
+
+      job->stats( source, length, &chunk );
+      moments_merge( &job->result, &chunk );
+   }
+
+   return NULL;
+}
+
+VALUE accumulator_alloc( VALUE klass )
+{
+   struct accumulator* acc = NULL;
+   VALUE object = TypedData_Make_Struct( klass, struct accumulator, &accumulator_type, acc );
+
+   memset( acc, 0, sizeof( *acc ) );
+
+   return object;
+}
+
+VALUE method_accumulator_initialize( VALUE self, VALUE type_rb )
+{
+   struct accumulator* acc = (struct accumulator*)rb_check_typeddata( self, &accumulator_type );
+   int type = NUM2INT( type_rb );
+
+   if ( acc->busy )
+   {
+      rb_raise( rb_eRuntimeError, "accumulator is in use by another thread" );
+   }
+
+   switch ( type )
+   {
+   case VECTOR_TYPE_S32:
+   case VECTOR_TYPE_F32:
+      acc->element_size = 4;
+      break;
+   case VECTOR_TYPE_S64:
+   case VECTOR_TYPE_F64:
+      acc->element_size = 8;
+      break;
+   default:
+      rb_raise( rb_eArgError, "invalid SSE accumulator type for argument 0" );
+   }
+
+   acc->type = type;
+   memset( &acc->state, 0, sizeof( acc->state ) );
+   acc->pending_length = 0;
+
+   return self;
+}
+
+VALUE method_accumulator_type( VALUE self )
+{
+   return INT2NUM( accumulator_of( self )->type );
+}
+
+VALUE method_accumulator_add_array( VALUE self, VALUE values )
+{
+   struct accumulator* acc = accumulator_for_update( self );
+   chunk_stats stats = stats_for( acc->type );
+   struct moments chunk;
+   long length = 0;
+   long pos = 0;
+   long offset = 0;
+   VALUE value;
+
+   union {
+      int32_t s32[ ACCUMULATOR_CHUNK ];
+      int64_t s64[ ACCUMULATOR_CHUNK ];
+      float   f32[ ACCUMULATOR_CHUNK ];
+      double  f64[ ACCUMULATOR_CHUNK ];
+   } buffer;
+
+   Check_Type( values, T_ARRAY );
+
+   for ( offset = 0; offset < RARRAY_LEN( values ); offset += length )
+   {
+      length = RARRAY_LEN( values ) - offset;
+      length = ( length < ACCUMULATOR_CHUNK ) ? length : ACCUMULATOR_CHUNK;
+
+      for ( pos = 0; pos < length; ++pos )
+      {
+         value = rb_ary_entry( values, offset + pos );
+         switch ( acc->type )
+         {
+         case VECTOR_TYPE_S32: buffer.s32[ pos ] = NUM2INT( value ); break;
+         case VECTOR_TYPE_S64: buffer.s64[ pos ] = NUM2LL( value ); break;
+         case VECTOR_TYPE_F32: buffer.f32[ pos ] = NUM2DBL( value ); break;
+         default:              buffer.f64[ pos ] = NUM2DBL( value ); break;
+         }
+      }
+
+      stats( &buffer, length, &chunk );
+      moments_merge( &acc->state, &chunk );
+   }
+
+   return self;
+}
+
+// Adds the native-endian packed elements in a binary String. A trailing
+// partial element is kept and completed by the next call, so a stream may
+// be split anywhere.
+VALUE method_accumulator_add_bytes( VALUE self, VALUE bytes )
+{
+   struct accumulator* acc = accumulator_for_update( self );
+   struct bytes_job job;
+   struct moments chunk;
+   const uint8_t* data = NULL;
+   size_t length = 0;
+   size_t fill = 0;
+
+   StringValue( bytes );
+   data = (const uint8_t*)RSTRING_PTR( bytes );
+   length = RSTRING_LEN( bytes );
+
+   job.stats = stats_for( acc->type );
+   job.element_size = acc->element_size;
+
+   if ( acc->pending_length > 0 )
+   {
+      fill = acc->element_size - acc->pending_length;
+      fill = ( fill < length ) ? fill : length;
+      memcpy( acc->pending + acc->pending_length, data, fill );
+      acc->pending_length += fill;
+      data += fill;
+      length -= fill;
+
+      if ( acc->pending_length < acc->element_size )
+      {
+         return self;
+      }
+
+      job.stats( acc->pending, 1, &chunk );
+      moments_merge( &acc->state, &chunk );
+      acc->pending_length = 0;
+   }
+
+   job.bytes = data;
+   job.count = length / acc->element_size;
+
+   if ( length >= ACCUMULATOR_NOGVL_BYTES )
+   {
+      // Other threads may run meanwhile, so the string is locked against
+      // modification, the accumulator is marked busy, and the result is
+      // merged only once the GVL is back. The reduction runs at memory
+      // speed and cannot be cut short, so there is no unblock function;
+      // interrupts are delivered when it returns.
+      rb_str_locktmp( bytes );
+      acc->busy = 1;
+      rb_thread_call_without_gvl( reduce_bytes, &job, NULL, NULL );
+      acc->busy = 0;
+      rb_str_unlocktmp( bytes );
+   }
+   else
+   {
+      reduce_bytes( &job );
+   }
+   moments_merge( &acc->state, &job.result );
+
+   acc->pending_length = length % acc->element_size;
+   memcpy( acc->pending, data + job.count * acc->element_size, acc->pending_length );
+
+   return self;
+}
+
+VALUE method_accumulator_merge( VALUE self, VALUE other )
+{
+   struct accumulator* acc = accumulator_for_update( self );
+   struct accumulator* other_acc = accumulator_of( other );
+
+   if ( acc->type != other_acc->type )
+   {
+      rb_raise( rb_eArgError, "accumulator types must match" );
+   }
+
+   moments_merge( &acc->state, &other_acc->state );
+
+   return self;
+}
+
+VALUE method_accumulator_count( VALUE self )
+{
+   return ULL2NUM( accumulator_of( self )->state.count );
+}
+
+VALUE method_accumulator_sum( VALUE self )
+{
+   struct accumulator* acc = accumulator_of( self );
+
+   return integer_type( acc->type ) ? LL2NUM( acc->state.int_sum ) : DBL2NUM( acc->state.sum );
+}
+
+VALUE method_accumulator_min( VALUE self )
+{
+   struct accumulator* acc = accumulator_of( self );
+
+   if ( acc->state.count == 0 )
+   {
+      return Qnil;
+   }
+
+   return integer_type( acc->type ) ? LL2NUM( acc->state.int_min ) : DBL2NUM( acc->state.min );
+}
+
+VALUE method_accumulator_max( VALUE self )
+{
+   struct accumulator* acc = accumulator_of( self );
+
+   if ( acc->state.count == 0 )
+   {
+      return Qnil;
+   }
+
+   return integer_type( acc->type ) ? LL2NUM( acc->state.int_max ) : DBL2NUM( acc->state.max );
+}
+
+VALUE method_accumulator_mean( VALUE self )
+{
+   struct accumulator* acc = accumulator_of( self );
+
+   return ( acc->state.count == 0 ) ? Qnil : DBL2NUM( acc->state.mean );
+}
+
+VALUE method_accumulator_variance( VALUE self, VALUE ddof_rb )
+{
+   struct accumulator* acc = accumulator_of( self );
+   long ddof = NUM2LONG( ddof_rb );
+
+   if ( ( ddof < 0 ) || ( acc->state.count <= (uint64_t)ddof ) )
+   {
+      return Qnil;
+   }
+
+   return DBL2NUM( acc->state.m2 / ( acc->state.count - ddof ) );
+}
+
+VALUE method_accumulator_pending_bytes( VALUE self )
+{
+   return SIZET2NUM( accumulator_of( self )->pending_length );
+}
@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_ACCUMULATOR_H
+#define  VECTOR_SSE_ACCUMULATOR_H
+
+#include "ruby.h"
+
+// Running count, sum, min, max, mean and variance of a stream of values,
+// held natively in a VectorSSE::Accumulator. Chunks are reduced with SIMD
+// and folded into the running state with the pairwise (Chan et al.) update,
+// so accumulators built on different threads can be merged exactly.
+
+VALUE accumulator_alloc( VALUE klass );
+
+VALUE method_accumulator_initialize( VALUE self, VALUE type_rb );
+VALUE method_accumulator_type( VALUE self );
+VALUE method_accumulator_add_array( VALUE self, VALUE values );
+VALUE method_accumulator_add_bytes( VALUE self, VALUE bytes );
+VALUE method_accumulator_merge( VALUE self, VALUE other );
+VALUE method_accumulator_count( VALUE self );
+VALUE method_accumulator_sum( VALUE self );
+VALUE method_accumulator_min( VALUE self );
+VALUE method_accumulator_max( VALUE self );
+VALUE method_accumulator_mean( VALUE self );
+VALUE method_accumulator_variance( VALUE self, VALUE ddof_rb );
+VALUE method_accumulator_pending_bytes( VALUE self );
+
+#endif // VECTOR_SSE_ACCUMULATOR_H
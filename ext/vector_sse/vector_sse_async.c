@@ -0,0 +1,438 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "vector_sse_async.h"
+#include "vector_sse_gemm.h"
+#include "vector_sse_parallel.h"
+#include "ruby/thread.h"
+
+#define  JOB_MUL_F32    (0)
+#define  JOB_MUL_F64    (1)
+
+struct async_job {
+   int      kind;
+   uint32_t rows;
+   uint32_t cols;
+   uint32_t common;
+   void*    left;
+   void*    right;
+   void*    result;
+   int      notify_read;
+   int      notify_write;
+
+   // Protected by pool_lock.
+   int      done;
+   int      references;
+   struct async_job* next;
+};
+
+// The pool is started on first use. All job state changes happen under
+// pool_lock; job_done is broadcast whenever any job finishes.
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  job_done = PTHREAD_COND_INITIALIZER;
+static struct async_job* queue_head = NULL;
+static struct async_job* queue_tail = NULL;
+static int pool_started = 0;
+static int fork_handler_installed = 0;
+
+static void job_release_locked( struct async_job* job )
+{
+   if ( --job->references > 0 )
+   {
+      return;
+   }
+
+   if ( job->notify_read >= 0 )
+   {
+      close( job->notify_read );
+   }
+
+   free( job->left );
+   free( job->right );
+   free( job->result );
+   free( job );
+}
+
+static void job_run( struct async_job* job )
+{
+   switch ( job->kind )
+   {
+   case JOB_MUL_F32:
+      gemm_f32( job->rows, job->cols, job->common, 1,
+         (const float*)job->left, job->common, (const float*)job->right, job->cols,
+         (float*)job->result, job->cols );
+      break;
+   case JOB_MUL_F64:
+      gemm_f64( job->rows, job->cols, job->common, 1,
+         (const double*)job->left, job->common, (const double*)job->right, job->cols,
+         (double*)job->result, job->cols );
+      break;
+   }
+}
+
+static void* worker_main( void* arg )
+{
+   struct async_job* job = NULL;
+   char signal = 1;
+
+   parallel_enter_native_thread();
+
+   for ( ;; )
+   {
+      pthread_mutex_lock( &pool_lock );
+      while ( queue_head == NULL )
+      {
+         pthread_cond_wait( &work_ready, &pool_lock );
+      }
+      job = queue_head;
+      queue_head = job->next;
+      if ( queue_head == NULL )
+      {
+         queue_tail = NULL;
+      }
+      pthread_mutex_unlock( &pool_lock );
+
+      job_run( job );
+
+      if ( job->notify_write >= 0 )
+      {
+         if ( write( job->notify_write, &signal, 1 ) < 0 )
+         {
+            // The reader is gone; nobody is waiting on the pipe.
+         }
+         close( job->notify_write );
+         job->notify_write = -1;
+      }
+
+      pthread_mutex_lock( &pool_lock );
+      job->done = 1;
+      pthread_cond_broadcast( &job_done );
+      job_release_locked( job );
+      pthread_mutex_unlock( &pool_lock );
+   }
+
+   return NULL;
+}
+
+// Worker threads do not survive fork, so the child starts a new pool on
+// its next job. Jobs queued before the fork are lost to the child.
+static void pool_after_fork( void )
+{
+   pthread_mutex_init( &pool_lock, NULL );
+   pthread_cond_init( &work_ready, NULL );
+   pthread_cond_init( &job_done, NULL );
+   queue_head = NULL;
+   queue_tail = NULL;
+   pool_started = 0;
+}
+
+// Called with pool_lock held. Returns zero if no worker could be started.
+static int pool_start_locked( void )
+{
+   pthread_t thread;
+   int worker = 0;
+
+   if ( pool_started )
+   {
+      return 1;
+   }
+
+   for ( worker = 0; worker < ASYNC_WORKERS; ++worker )
+   {
+      if ( pthread_create( &thread, NULL, worker_main, NULL ) == 0 )
+      {
+         pthread_detach( thread );
+         pool_started = 1;
+      }
+   }
+
+   if ( pool_started && !fork_handler_installed )
+   {
+      pthread_atfork( NULL, NULL, pool_after_fork );
+      fork_handler_installed = 1;
+   }
+
+   return pool_started;
+}
+
+static void job_free( void* ptr )
+{
+   struct async_job* job = (struct async_job*)ptr;
+
+   pthread_mutex_lock( &pool_lock );
+   job_release_locked( job );
+   pthread_mutex_unlock( &pool_lock );
+}
+
+static size_t job_size( const void* ptr )
+{
+   const struct async_job* job = (const struct async_job*)ptr;
+   size_t element = ( job->kind == JOB_MUL_F32 ) ? sizeof( float ) : sizeof( double );
+
+   return sizeof( *job ) + element *
+      ( (size_t)job->rows * job->common + (size_t)job->common * job->cols + (size_t)job->rows * job->cols );
+}
+
+static const rb_data_type_t job_type = {
+   "VectorSSE::Job",
+   { NULL, job_free, job_size, },
+   0, 0, RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+static struct async_job* job_of( VALUE self )
+{
+   return (struct async_job*)rb_check_typeddata( self, &job_type );
+}
+
+static VALUE job_submit( VALUE module, struct async_job* job, VALUE notify )
+{
+   int fds[ 2 ];
+   VALUE job_class = rb_const_get( module, rb_intern( "Job" ) );
+   VALUE object = Qnil;
+
+   job->notify_read  = -1;
+   job->notify_write = -1;
+   job->done = 0;
+   job->next = NULL;
+
+   // One reference for the Ruby object and one for the queue.
+   job->references = 2;
+
+   if ( RTEST( notify ) )
+   {
+      if ( pipe( fds ) != 0 )
+      {
+         free( job->left ); free( job->right ); free( job->result ); free( job );
+         rb_sys_fail( "pipe" );
+      }
+      fcntl( fds[ 0 ], F_SETFD, FD_CLOEXEC );
+      fcntl( fds[ 1 ], F_SETFD, FD_CLOEXEC );
+      job->notify_read  = fds[ 0 ];
+      job->notify_write = fds[ 1 ];
+   }
+
+   object = TypedData_Wrap_Struct( job_class, &job_type, job );
+
+   pthread_mutex_lock( &pool_lock );
+   if ( !pool_start_locked() )
+   {
+      // Only the Ruby object holds the job now, and no worker will ever
+      // signal its pipe.
+      job->references = 1;
+      if ( job->notify_write >= 0 )
+      {
+         close( job->notify_write );
+         close( job->notify_read );
+         job->notify_write = -1;
+         job->notify_read  = -1;
+      }
+      pthread_mutex_unlock( &pool_lock );
+      rb_raise( rb_eRuntimeError, "unable to start worker threads" );
+   }
+   if ( queue_tail )
+   {
+      queue_tail->next = job;
+   }
+   else
+   {
+      queue_head = job;
+   }
+   queue_tail = job;
+   pthread_cond_signal( &work_ready );
+   pthread_mutex_unlock( &pool_lock );
+
+   return object;
+}
+
+
+#define  TEMPLATE_MUL_ASYNC( FUNC_NAME, TYPE, KIND ) \
+VALUE FUNC_NAME( VALUE self, VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE right, VALUE right_rows_rb, VALUE right_cols_rb, VALUE notify ) \
+{ \
+   uint32_t left_rows = NUM2UINT( left_rows_rb ); \
+   uint32_t left_cols = NUM2UINT( left_cols_rb ); \
+   uint32_t right_rows = NUM2UINT( right_rows_rb ); \
+   uint32_t right_cols = NUM2UINT( right_cols_rb ); \
+   uint64_t left_length = (uint64_t)left_rows * left_cols; \
+   uint64_t right_length = (uint64_t)right_rows * right_cols; \
+   uint64_t pos = 0; \
+\
+   struct async_job* job = NULL; \
+   TYPE* left_native = NULL; \
+   TYPE* right_native = NULL; \
+\
+   Check_Type( left, T_ARRAY ); \
+   Check_Type( right, T_ARRAY ); \
+\
+   if ( left_cols != right_rows ) \
+   { \
+      rb_raise( rb_eRuntimeError, "invalid matrix dimensions" ); \
+   } \
+   if ( ( (uint64_t)RARRAY_LEN( left ) != left_length ) || \
+        ( (uint64_t)RARRAY_LEN( right ) != right_length ) ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   /* Operands are copied while the GVL is held; the workers only ever */ \
+   /* see native buffers. */ \
+   left_native  = (TYPE*)malloc( ( left_length + 1 ) * sizeof( TYPE ) ); \
+   right_native = (TYPE*)malloc( ( right_length + 1 ) * sizeof( TYPE ) ); \
+   for ( pos = 0; pos < left_length; ++pos ) \
+   { \
+      left_native[ pos ] = NUM2DBL( rb_ary_entry( left, pos ) ); \
+   } \
+   for ( pos = 0; pos < right_length; ++pos ) \
+   { \
+      right_native[ pos ] = NUM2DBL( rb_ary_entry( right, pos ) ); \
+   } \
+\
+   job = (struct async_job*)malloc( sizeof( struct async_job ) ); \
+   job->kind   = KIND; \
+   job->rows   = left_rows; \
+   job->cols   = right_cols; \
+   job->common = left_cols; \
+   job->left   = left_native; \
+   job->right  = right_native; \
+   job->result = calloc( (uint64_t)left_rows * right_cols + 1, sizeof( TYPE ) ); \
+\
+   return job_submit( self, job, notify ); \
+}
+
+TEMPLATE_MUL_ASYNC( method_mul_async_f32, float, JOB_MUL_F32 );
+TEMPLATE_MUL_ASYNC( method_mul_async_f64, double, JOB_MUL_F64 );
+
+VALUE method_job_ready( VALUE self )
+{
+   struct async_job* job = job_of( self );
+   int done = 0;
+
+   pthread_mutex_lock( &pool_lock );
+   done = job->done;
+   pthread_mutex_unlock( &pool_lock );
+
+   return done ? Qtrue : Qfalse;
+}
+
+// One per waiting thread, so that an interrupt for one waiter cannot be
+// consumed by another thread waiting on the same job.
+struct job_waiter {
+   struct async_job* job;
+
+   // Protected by pool_lock.
+   int interrupted;
+};
+
+static void* job_wait_without_gvl( void* arg )
+{
+   struct job_waiter* waiter = (struct job_waiter*)arg;
+
+   pthread_mutex_lock( &pool_lock );
+   while ( !waiter->job->done && !waiter->interrupted )
+   {
+      pthread_cond_wait( &job_done, &pool_lock );
+   }
+   pthread_mutex_unlock( &pool_lock );
+
+   return NULL;
+}
+
+// Wakes a waiting thread so that Ruby can deliver an interrupt to it.
+static void job_wait_unblock( void* arg )
+{
+   struct job_waiter* waiter = (struct job_waiter*)arg;
+
+   pthread_mutex_lock( &pool_lock );
+   waiter->interrupted = 1;
+   pthread_cond_broadcast( &job_done );
+   pthread_mutex_unlock( &pool_lock );
+}
+
+// Blocks until the job is done, with the GVL released so that other Ruby
+// threads keep running.
+VALUE method_job_wait( VALUE self )
+{
+   struct job_waiter waiter;
+
+   waiter.job = job_of( self );
+
+   while ( method_job_ready( self ) == Qfalse )
+   {
+      waiter.interrupted = 0;
+      rb_thread_call_without_gvl( job_wait_without_gvl, &waiter, job_wait_unblock, &waiter );
+      rb_thread_check_ints();
+   }
+
+   return self;
+}
+
+VALUE method_job_result( VALUE self )
+{
+   struct async_job* job = job_of( self );
+   uint64_t length = (uint64_t)job->rows * job->cols;
+   uint64_t pos = 0;
+   VALUE result = Qnil;
+
+   method_job_wait( self );
+
+   result = rb_ary_new2( length );
+   for ( pos = 0; pos < length; ++pos )
+   {
+      if ( job->kind == JOB_MUL_F32 )
+      {
+         rb_ary_push( result, DBL2NUM( ( (const float*)job->result )[ pos ] ) );
+      }
+      else
+      {
+         rb_ary_push( result, DBL2NUM( ( (const double*)job->result )[ pos ] ) );
+      }
+   }
+
+   return result;
+}
+
+// Read end of the completion pipe, or nil. The caller takes ownership of
+// the descriptor, which can be handed to IO.for_fd.
+VALUE method_job_notify_fd( VALUE self )
+{
+   struct async_job* job = job_of( self );
+   int fd = job->notify_read;
+
+   job->notify_read = -1;
+
+   return ( fd >= 0 ) ? INT2NUM( fd ) : Qnil;
+}
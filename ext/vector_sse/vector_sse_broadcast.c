@@ -0,0 +1,257 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <string.h>
+#include <emmintrin.h>
+#include "vector_sse_broadcast.h"
+#include "vector_sse_common.h"
+
+// SSE has no integer divide. These divide lane by lane and round toward
+// negative infinity to match Ruby's Integer#/. Zero divisors are rejected
+// before any kernel runs.
+#define  TEMPLATE_DIV_LANES( FUNC_NAME, TYPE, UTYPE, EL_PER_VEC ) \
+static __m128i FUNC_NAME( const __m128i left, const __m128i right ) \
+{ \
+   uint32_t vector_pos = 0; \
+   TYPE left_lanes[ EL_PER_VEC ]; \
+   TYPE right_lanes[ EL_PER_VEC ]; \
+   TYPE quotient = 0; \
+\
+   _mm_storeu_si128( (__m128i*)left_lanes, left ); \
+   _mm_storeu_si128( (__m128i*)right_lanes, right ); \
+\
+   for ( vector_pos = 0; vector_pos < EL_PER_VEC; ++vector_pos ) \
+   { \
+      if ( right_lanes[ vector_pos ] == -1 ) \
+      { \
+         quotient = (TYPE)( (UTYPE)0 - (UTYPE)left_lanes[ vector_pos ] ); \
+      } \
+      else \
+      { \
+         quotient = left_lanes[ vector_pos ] / right_lanes[ vector_pos ]; \
+         if ( ( left_lanes[ vector_pos ] % right_lanes[ vector_pos ] != 0 ) && \
+              ( ( left_lanes[ vector_pos ] < 0 ) != ( right_lanes[ vector_pos ] < 0 ) ) ) \
+         { \
+            --quotient; \
+         } \
+      } \
+      left_lanes[ vector_pos ] = quotient; \
+   } \
+\
+   return _mm_loadu_si128( (const __m128i*)left_lanes ); \
+}
+
+TEMPLATE_DIV_LANES( div_s32, int32_t, uint32_t, 4 );
+TEMPLATE_DIV_LANES( div_s64, int64_t, uint64_t, 2 );
+
+
+// One output row. A splatted operand is a single value (a rows x 1 column
+// vector, or a scalar) repeated across the row; the other operand is
+// either a full row or a row vector shared by every output row, which
+// stays in L1 across calls.
+#define  TEMPLATE_BROADCAST_ROW( FUNC_NAME, TYPE, EL_PER_VEC, OP ) \
+static void FUNC_NAME( const TYPE* left, int left_splat, const TYPE* right, int right_splat, TYPE* output, uint32_t cols ) \
+{ \
+   uint32_t offset = 0; \
+   uint32_t vector_pos = 0; \
+\
+   TYPE left_segment[ EL_PER_VEC ]; \
+   TYPE right_segment[ EL_PER_VEC ]; \
+   TYPE result_segment[ EL_PER_VEC ]; \
+\
+   __m128i left_splat_vec; \
+   __m128i right_splat_vec; \
+\
+   for ( vector_pos = 0; vector_pos < EL_PER_VEC; ++vector_pos ) \
+   { \
+      left_segment[ vector_pos ]  = left[ 0 ]; \
+      right_segment[ vector_pos ] = right[ 0 ]; \
+   } \
+   left_splat_vec  = _mm_loadu_si128( (const __m128i *)left_segment ); \
+   right_splat_vec = _mm_loadu_si128( (const __m128i *)right_segment ); \
+\
+   for ( offset = 0; offset + EL_PER_VEC <= cols; offset += EL_PER_VEC ) \
+   { \
+      _mm_storeu_si128( (__m128i *)( output + offset ), OP( \
+         left_splat ? left_splat_vec : _mm_loadu_si128( (const __m128i *)( left + offset ) ), \
+         right_splat ? right_splat_vec : _mm_loadu_si128( (const __m128i *)( right + offset ) ) ) ); \
+   } \
+\
+   if ( offset < cols ) \
+   { \
+      /* Pad the right operand with ones so the tail never divides by zero. */ \
+      for ( vector_pos = 0; vector_pos < EL_PER_VEC; ++vector_pos ) \
+      { \
+         if ( offset + vector_pos < cols ) \
+         { \
+            left_segment[ vector_pos ]  = left_splat ? left[ 0 ] : left[ offset + vector_pos ]; \
+            right_segment[ vector_pos ] = right_splat ? right[ 0 ] : right[ offset + vector_pos ]; \
+         } \
+         else \
+         { \
+            left_segment[ vector_pos ]  = 0; \
+            right_segment[ vector_pos ] = 1; \
+         } \
+      } \
+\
+      _mm_storeu_si128( (__m128i *)result_segment, OP( \
+         _mm_loadu_si128( (const __m128i *)left_segment ), \
+         _mm_loadu_si128( (const __m128i *)right_segment ) ) ); \
+      memcpy( output + offset, result_segment, ( cols - offset ) * sizeof( TYPE ) ); \
+   } \
+}
+
+TEMPLATE_BROADCAST_ROW( add_row_s32, int32_t, 4, _mm_add_epi32 );
+TEMPLATE_BROADCAST_ROW( sub_row_s32, int32_t, 4, _mm_sub_epi32 );
+TEMPLATE_BROADCAST_ROW( mul_row_s32, int32_t, 4, mul_lo_s32 );
+TEMPLATE_BROADCAST_ROW( div_row_s32, int32_t, 4, div_s32 );
+
+TEMPLATE_BROADCAST_ROW( add_row_s64, int64_t, 2, _mm_add_epi64 );
+TEMPLATE_BROADCAST_ROW( sub_row_s64, int64_t, 2, _mm_sub_epi64 );
+TEMPLATE_BROADCAST_ROW( mul_row_s64, int64_t, 2, mul_lo_s64 );
+TEMPLATE_BROADCAST_ROW( div_row_s64, int64_t, 2, div_s64 );
+
+TEMPLATE_BROADCAST_ROW( add_row_f32, float, 4, add_f32 );
+TEMPLATE_BROADCAST_ROW( sub_row_f32, float, 4, sub_f32 );
+TEMPLATE_BROADCAST_ROW( mul_row_f32, float, 4, mul_f32 );
+TEMPLATE_BROADCAST_ROW( div_row_f32, float, 4, div_f32 );
+
+TEMPLATE_BROADCAST_ROW( add_row_f64, double, 2, add_f64 );
+TEMPLATE_BROADCAST_ROW( sub_row_f64, double, 2, sub_f64 );
+TEMPLATE_BROADCAST_ROW( mul_row_f64, double, 2, mul_f64 );
+TEMPLATE_BROADCAST_ROW( div_row_f64, double, 2, div_f64 );
+
+
+#define  TEMPLATE_BROADCAST_S( FUNC_NAME, TYPE, CONV_IN, CONV_OUT, IS_INTEGER, ADD_ROW, SUB_ROW, MUL_ROW, DIV_ROW ) \
+VALUE FUNC_NAME( VALUE self, VALUE op_rb, VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE right, VALUE right_rows_rb, VALUE right_cols_rb ) \
+{ \
+   uint32_t row = 0; \
+   uint32_t pos = 0; \
+\
+   int      op         = NUM2INT( op_rb ); \
+   uint32_t left_rows  = NUM2UINT( left_rows_rb ); \
+   uint32_t left_cols  = NUM2UINT( left_cols_rb ); \
+   uint32_t right_rows = NUM2UINT( right_rows_rb ); \
+   uint32_t right_cols = NUM2UINT( right_cols_rb ); \
+\
+   uint32_t rows = ( left_rows > right_rows ) ? left_rows : right_rows; \
+   uint32_t cols = ( left_cols > right_cols ) ? left_cols : right_cols; \
+\
+   uint32_t left_length   = left_rows * left_cols; \
+   uint32_t right_length  = right_rows * right_cols; \
+   uint32_t result_length = rows * cols; \
+\
+   void ( *row_kernel )( const TYPE*, int, const TYPE*, int, TYPE*, uint32_t ) = NULL; \
+\
+   TYPE* left_native   = NULL; \
+   TYPE* right_native  = NULL; \
+   TYPE* result_native = NULL; \
+\
+   VALUE result = Qnil; \
+\
+   Check_Type( left, T_ARRAY ); \
+   Check_Type( right, T_ARRAY ); \
+\
+   if ( ( ( left_rows != right_rows ) && ( left_rows != 1 ) && ( right_rows != 1 ) ) || \
+        ( ( left_cols != right_cols ) && ( left_cols != 1 ) && ( right_cols != 1 ) ) ) \
+   { \
+      rb_raise( rb_eArgError, "operands could not be broadcast together" ); \
+   } \
+\
+   if ( ( RARRAY_LEN( left ) != left_length ) || ( RARRAY_LEN( right ) != right_length ) || \
+        ( left_length == 0 ) || ( right_length == 0 ) ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   switch ( op ) \
+   { \
+   case BROADCAST_OP_ADD: row_kernel = ADD_ROW; break; \
+   case BROADCAST_OP_SUB: row_kernel = SUB_ROW; break; \
+   case BROADCAST_OP_MUL: row_kernel = MUL_ROW; break; \
+   case BROADCAST_OP_DIV: row_kernel = DIV_ROW; break; \
+   default: \
+      rb_raise( rb_eArgError, "invalid broadcast operation" ); \
+   } \
+\
+   left_native   = (TYPE*) malloc( left_length * sizeof( TYPE ) ); \
+   right_native  = (TYPE*) malloc( right_length * sizeof( TYPE ) ); \
+\
+   for ( pos = 0; pos < left_length; ++pos ) \
+   { \
+      left_native[ pos ] = CONV_IN( rb_ary_entry( left, pos ) ); \
+   } \
+   for ( pos = 0; pos < right_length; ++pos ) \
+   { \
+      right_native[ pos ] = CONV_IN( rb_ary_entry( right, pos ) ); \
+   } \
+\
+   if ( IS_INTEGER && ( op == BROADCAST_OP_DIV ) ) \
+   { \
+      for ( pos = 0; pos < right_length; ++pos ) \
+      { \
+         if ( right_native[ pos ] == 0 ) \
+         { \
+            free( left_native ); \
+            free( right_native ); \
+            rb_raise( rb_eZeroDivError, "divided by 0" ); \
+         } \
+      } \
+   } \
+\
+   result_native = (TYPE*) malloc( result_length * sizeof( TYPE ) ); \
+\
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      row_kernel( \
+         left_native + ( ( left_rows == 1 ) ? 0 : row ) * left_cols, ( left_cols == 1 ) && ( cols > 1 ), \
+         right_native + ( ( right_rows == 1 ) ? 0 : row ) * right_cols, ( right_cols == 1 ) && ( cols > 1 ), \
+         result_native + row * cols, cols ); \
+   } \
+\
+   result = rb_ary_new2( result_length ); \
+   for ( pos = 0; pos < result_length; ++pos ) \
+   { \
+      rb_ary_push( result, CONV_OUT( result_native[ pos ] ) ); \
+   } \
+\
+   free( left_native ); \
+   free( right_native ); \
+   free( result_native ); \
+\
+   return result; \
+}
+
+TEMPLATE_BROADCAST_S( method_broadcast_s32, int32_t, NUM2INT, INT2NUM, 1, add_row_s32, sub_row_s32, mul_row_s32, div_row_s32 );
+TEMPLATE_BROADCAST_S( method_broadcast_s64, int64_t, NUM2LL, LL2NUM, 1, add_row_s64, sub_row_s64, mul_row_s64, div_row_s64 );
+TEMPLATE_BROADCAST_S( method_broadcast_f32, float, NUM2DBL, DBL2NUM, 0, add_row_f32, sub_row_f32, mul_row_f32, div_row_f32 );
+TEMPLATE_BROADCAST_S( method_broadcast_f64, double, NUM2DBL, DBL2NUM, 0, add_row_f64, sub_row_f64, mul_row_f64, div_row_f64 );
@@ -0,0 +1,295 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include "vector_sse_chain.h"
+#include "vector_sse_gemm.h"
+
+struct chain_shape {
+   uint32_t  count;
+   uint32_t* dims;
+   uint32_t* splits;
+};
+
+static void chain_shape_free( struct chain_shape* shape )
+{
+   free( shape->dims );
+   free( shape->splits );
+}
+
+// Loads the chain dimensions and, unless 'splits' is nil, a split table
+// as returned by chain_order. Every split the evaluation can reach, the
+// entry for first..last with first < last, must lie in [first, last).
+static void chain_shape_init( struct chain_shape* shape, VALUE dims, VALUE splits )
+{
+   uint32_t pos = 0;
+   uint32_t first = 0;
+   uint32_t last = 0;
+
+   Check_Type( dims, T_ARRAY );
+
+   if ( RARRAY_LEN( dims ) < 2 )
+   {
+      rb_raise( rb_eArgError, "a matrix chain needs at least one matrix" );
+   }
+
+   if ( ( splits != Qnil ) &&
+        ( RARRAY_LEN( splits ) != ( RARRAY_LEN( dims ) - 1 ) * ( RARRAY_LEN( dims ) - 1 ) ) )
+   {
+      rb_raise( rb_eArgError, "matrix chain does not match its dimensions" );
+   }
+
+   shape->count = RARRAY_LEN( dims ) - 1;
+   shape->dims = (uint32_t*)malloc( ( shape->count + 1 ) * sizeof( uint32_t ) );
+   shape->splits = (uint32_t*)calloc( (uint64_t)shape->count * shape->count, sizeof( uint32_t ) );
+
+   for ( pos = 0; pos <= shape->count; ++pos )
+   {
+      shape->dims[ pos ] = NUM2UINT( rb_ary_entry( dims, pos ) );
+   }
+
+   if ( splits != Qnil )
+   {
+      for ( pos = 0; pos < shape->count * shape->count; ++pos )
+      {
+         shape->splits[ pos ] = NUM2UINT( rb_ary_entry( splits, pos ) );
+      }
+
+      for ( first = 0; first < shape->count; ++first )
+      {
+         for ( last = first + 1; last < shape->count; ++last )
+         {
+            pos = shape->splits[ first * shape->count + last ];
+            if ( ( pos < first ) || ( pos >= last ) )
+            {
+               chain_shape_free( shape );
+               rb_raise( rb_eArgError, "matrix chain split out of range" );
+            }
+         }
+      }
+   }
+}
+
+static uint64_t chain_size( const struct chain_shape* shape, uint32_t first, uint32_t last )
+{
+   return (uint64_t)shape->dims[ first ] * shape->dims[ last + 1 ];
+}
+
+// Scratch elements needed to evaluate matrices first..last into a buffer
+// provided by the caller. The left factor is kept while the right one is
+// evaluated; both are released once they have been multiplied.
+static uint64_t chain_scratch( const struct chain_shape* shape, uint32_t first, uint32_t last )
+{
+   uint32_t split = 0;
+   uint64_t left = 0;
+   uint64_t right = 0;
+   uint64_t left_peak = 0;
+   uint64_t right_peak = 0;
+
+   if ( first == last )
+   {
+      return 0;
+   }
+
+   split = shape->splits[ first * shape->count + last ];
+   left = ( first < split ) ? chain_size( shape, first, split ) : 0;
+   right = ( split + 1 < last ) ? chain_size( shape, split + 1, last ) : 0;
+
+   left_peak = left + chain_scratch( shape, first, split );
+   right_peak = left + right + chain_scratch( shape, split + 1, last );
+
+   return ( left_peak > right_peak ) ? left_peak : right_peak;
+}
+
+VALUE method_chain_order( VALUE self, VALUE dims )
+{
+   struct chain_shape shape;
+   double* costs = NULL;
+   double cost = 0.0;
+   uint32_t length = 0;
+   uint32_t first = 0;
+   uint32_t last = 0;
+   uint32_t split = 0;
+   uint32_t pos = 0;
+   VALUE result;
+
+   chain_shape_init( &shape, dims, Qnil );
+   costs = (double*)calloc( (uint64_t)shape.count * shape.count, sizeof( double ) );
+
+   // costs[ first, last ] is the fewest multiply-adds needed for the
+   // product of matrices first..last, built up by increasing chain length.
+   // Counts are kept as doubles since they can overflow 64-bit integers.
+   for ( length = 2; length <= shape.count; ++length )
+   {
+      for ( first = 0; first + length <= shape.count; ++first )
+      {
+         last = first + length - 1;
+         costs[ first * shape.count + last ] = -1.0;
+
+         for ( split = first; split < last; ++split )
+         {
+            cost = costs[ first * shape.count + split ] +
+                   costs[ ( split + 1 ) * shape.count + last ] +
+                   (double)shape.dims[ first ] * shape.dims[ split + 1 ] * shape.dims[ last + 1 ];
+
+            if ( ( costs[ first * shape.count + last ] < 0.0 ) ||
+                 ( cost < costs[ first * shape.count + last ] ) )
+            {
+               costs[ first * shape.count + last ] = cost;
+               shape.splits[ first * shape.count + last ] = split;
+            }
+         }
+      }
+   }
+
+   result = rb_ary_new2( (uint64_t)shape.count * shape.count );
+   for ( pos = 0; pos < shape.count * shape.count; ++pos )
+   {
+      rb_ary_push( result, UINT2NUM( shape.splits[ pos ] ) );
+   }
+
+   free( costs );
+   chain_shape_free( &shape );
+
+   return result;
+}
+
+#define  TEMPLATE_CHAIN_MUL( SUFFIX, TYPE, GEMM ) \
+/* Evaluates matrices first..last and returns the product. A single matrix \
+   is returned in place; otherwise the product is written to 'out' and \
+   intermediates are stacked in 'scratch'. */ \
+static const TYPE* chain_eval_##SUFFIX( const struct chain_shape* shape, TYPE** operands, \
+   uint32_t first, uint32_t last, TYPE* out, TYPE* scratch ) \
+{ \
+   uint32_t split = 0; \
+   uint32_t common = 0; \
+   uint64_t left_size = 0; \
+   uint64_t right_size = 0; \
+   const TYPE* left = NULL; \
+   const TYPE* right = NULL; \
+\
+   if ( first == last ) \
+   { \
+      return operands[ first ]; \
+   } \
+\
+   split = shape->splits[ first * shape->count + last ]; \
+   common = shape->dims[ split + 1 ]; \
+   left_size = ( first < split ) ? chain_size( shape, first, split ) : 0; \
+   right_size = ( split + 1 < last ) ? chain_size( shape, split + 1, last ) : 0; \
+\
+   left = chain_eval_##SUFFIX( shape, operands, first, split, \
+      scratch, scratch + left_size ); \
+   right = chain_eval_##SUFFIX( shape, operands, split + 1, last, \
+      scratch + left_size, scratch + left_size + right_size ); \
+\
+   memset( out, 0, chain_size( shape, first, last ) * sizeof( TYPE ) ); \
+   GEMM( shape->dims[ first ], shape->dims[ last + 1 ], common, 1, \
+      left, common, right, shape->dims[ last + 1 ], out, shape->dims[ last + 1 ] ); \
+\
+   return out; \
+} \
+\
+VALUE method_chain_mul_##SUFFIX( VALUE self, VALUE operands_rb, VALUE dims, VALUE splits ) \
+{ \
+   struct chain_shape shape; \
+   TYPE** operands = NULL; \
+   TYPE* scratch = NULL; \
+   TYPE* out = NULL; \
+   const TYPE* product = NULL; \
+   VALUE operand; \
+   VALUE result; \
+   uint64_t length = 0; \
+   uint64_t pos = 0; \
+   uint32_t index = 0; \
+\
+   Check_Type( operands_rb, T_ARRAY ); \
+   Check_Type( splits, T_ARRAY ); \
+   chain_shape_init( &shape, dims, splits ); \
+\
+   if ( RARRAY_LEN( operands_rb ) != shape.count ) \
+   { \
+      chain_shape_free( &shape ); \
+      rb_raise( rb_eArgError, "matrix chain does not match its dimensions" ); \
+   } \
+\
+   operands = (TYPE**)calloc( shape.count, sizeof( TYPE* ) ); \
+   for ( index = 0; index < shape.count; ++index ) \
+   { \
+      operand = rb_ary_entry( operands_rb, index ); \
+      length = chain_size( &shape, index, index ); \
+\
+      if ( !RB_TYPE_P( operand, T_ARRAY ) || ( (uint64_t)RARRAY_LEN( operand ) != length ) ) \
+      { \
+         while ( index > 0 ) \
+         { \
+            free( operands[ --index ] ); \
+         } \
+         free( operands ); \
+         chain_shape_free( &shape ); \
+         rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+      } \
+\
+      operands[ index ] = (TYPE*)malloc( ( length + 1 ) * sizeof( TYPE ) ); \
+      for ( pos = 0; pos < length; ++pos ) \
+      { \
+         operands[ index ][ pos ] = NUM2DBL( rb_ary_entry( operand, pos ) ); \
+      } \
+   } \
+\
+   length = chain_size( &shape, 0, shape.count - 1 ); \
+   out = (TYPE*)malloc( ( length + 1 ) * sizeof( TYPE ) ); \
+   scratch = (TYPE*)malloc( ( chain_scratch( &shape, 0, shape.count - 1 ) + 1 ) * sizeof( TYPE ) ); \
+\
+   product = chain_eval_##SUFFIX( &shape, operands, 0, shape.count - 1, out, scratch ); \
+\
+   result = rb_ary_new2( length ); \
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( product[ pos ] ) ); \
+   } \
+\
+   for ( index = 0; index < shape.count; ++index ) \
+   { \
+      free( operands[ index ] ); \
+   } \
+   free( operands ); \
+   free( scratch ); \
+   free( out ); \
+   chain_shape_free( &shape ); \
+\
+   return result; \
+}
+
+TEMPLATE_CHAIN_MUL( f32, float, gemm_f32 );
+TEMPLATE_CHAIN_MUL( f64, double, gemm_f64 );
@@ -1,3 +1,7 @@
+#include <stdint.h>
+#ifdef __SSE4_1__  // modern CPU - use SSE 4.1
+#include <smmintrin.h>
+#endif
 #include "vector_sse_common.h"
 
 __m128i add_f32( const __m128i left, const __m128i right )
@@ -7,7 +11,7 @@ __m128i add_f32( const __m128i left, const __m128i right )
 
 __m128i add_f64( const __m128i left, const __m128i right )
 {
-   return _mm_cvtpd_epi32( _mm_add_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
+   return _mm_castpd_si128( _mm_add_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
 }
 
 __m128i sub_f32( const __m128i left, const __m128i right )
@@ -17,7 +21,7 @@ __m128i sub_f32( const __m128i left, const __m128i right )
 
 __m128i sub_f64( const __m128i left, const __m128i right )
 {
-   return _mm_cvtpd_epi32( _mm_sub_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
+   return _mm_castpd_si128( _mm_sub_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
 }
 
 __m128i mul_f32( const __m128i left, const __m128i right )
@@ -27,5 +31,42 @@ __m128i mul_f32( const __m128i left, const __m128i right )
 
 __m128i mul_f64( const __m128i left, const __m128i right )
 {
-   return _mm_cvtpd_epi32( _mm_mul_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
+   return _mm_castpd_si128( _mm_mul_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
+}
+
+__m128i div_f32( const __m128i left, const __m128i right )
+{
+   return _mm_castps_si128( _mm_div_ps( _mm_castsi128_ps( left ), _mm_castsi128_ps( right ) ) );
+}
+
+__m128i div_f64( const __m128i left, const __m128i right )
+{
+   return _mm_castpd_si128( _mm_div_pd( _mm_castsi128_pd( left ), _mm_castsi128_pd( right ) ) );
+}
+
+__m128i mul_lo_s32( const __m128i left, const __m128i right )
+{
+#ifdef __SSE4_1__
+   return _mm_mullo_epi32( left, right );
+#else               // old CPU - use SSE 2
+   __m128i tmp1 = _mm_mul_epu32( left, right ); /* mul 2,0*/
+   __m128i tmp2 = _mm_mul_epu32( _mm_srli_si128( left, 4 ), _mm_srli_si128( right, 4 ) ); /* mul 3,1 */
+   return _mm_unpacklo_epi32( _mm_shuffle_epi32( tmp1, _MM_SHUFFLE( 0, 0, 2, 0 ) ), _mm_shuffle_epi32( tmp2, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+#endif
+}
+
+__m128i mul_lo_s64( const __m128i left, const __m128i right )
+{
+   // SSE has no 64-bit integer multiply, so multiply the two lanes in
+   // scalar registers. Unsigned arithmetic gives the wrap-around result.
+   uint64_t left_lanes[ 2 ];
+   uint64_t right_lanes[ 2 ];
+
+   _mm_storeu_si128( (__m128i*)left_lanes, left );
+   _mm_storeu_si128( (__m128i*)right_lanes, right );
+
+   left_lanes[ 0 ] *= right_lanes[ 0 ];
+   left_lanes[ 1 ] *= right_lanes[ 1 ];
+
+   return _mm_loadu_si128( (const __m128i*)left_lanes );
 }
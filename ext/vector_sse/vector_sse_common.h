@@ -9,5 +9,9 @@ __m128i sub_f32( const __m128i left, const __m128i right );
 __m128i sub_f64( const __m128i left, const __m128i right );
 __m128i mul_f32( const __m128i left, const __m128i right );
 __m128i mul_f64( const __m128i left, const __m128i right );
+__m128i div_f32( const __m128i left, const __m128i right );
+__m128i div_f64( const __m128i left, const __m128i right );
+__m128i mul_lo_s32( const __m128i left, const __m128i right );
+__m128i mul_lo_s64( const __m128i left, const __m128i right );
 
 #endif // VECTOR_SSE_COMMON_H
\ No newline at end of file
@@ -0,0 +1,400 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <string.h>
+#include <math.h>
+#include <emmintrin.h>
+#include "vector_sse_convert.h"
+#include "vector_sse_common.h"
+
+#define  CONVERSION( FROM, TO )  ( ( (FROM) << 4 ) | (TO) )
+
+// Largest float below 2^31; anything above it is out of int32 range.
+#define  S32_MAX_AS_F32   (2147483520.0f)
+
+
+static uint32_t vector_type_size( int type )
+{
+   switch ( type )
+   {
+   case VECTOR_TYPE_S32:
+   case VECTOR_TYPE_F32:
+      return 4;
+   case VECTOR_TYPE_S64:
+   case VECTOR_TYPE_F64:
+      return 8;
+   default:
+      rb_raise( rb_eArgError, "invalid SSE vector type" );
+   }
+
+   return 0;
+}
+
+static double round_scalar( double value, int rounding )
+{
+   switch ( rounding )
+   {
+   case ROUND_TRUNCATE:
+      return trunc( value );
+   case ROUND_FLOOR:
+      return floor( value );
+   case ROUND_CEIL:
+      return ceil( value );
+   default:
+      return nearbyint( value );
+   }
+}
+
+// Float to int64 always saturates (NaN becomes zero) since an out of range
+// conversion is undefined in C.
+static int64_t round_to_s64( double value, int rounding )
+{
+   if ( value != value )
+   {
+      return 0;
+   }
+
+   value = round_scalar( value, rounding );
+
+   if ( value >= 9223372036854775808.0 )
+   {
+      return INT64_MAX;
+   }
+   if ( value < -9223372036854775808.0 )
+   {
+      return INT64_MIN;
+   }
+
+   return (int64_t)value;
+}
+
+static inline __m128i round_ps_epi32( const __m128 value, int rounding )
+{
+   __m128i truncated;
+
+   switch ( rounding )
+   {
+   case ROUND_TRUNCATE:
+      return _mm_cvttps_epi32( value );
+   case ROUND_FLOOR:
+      // Truncation rounds negative values up; step back where that happened.
+      truncated = _mm_cvttps_epi32( value );
+      return _mm_add_epi32( truncated, _mm_castps_si128(
+         _mm_cmpgt_ps( _mm_cvtepi32_ps( truncated ), value ) ) );
+   case ROUND_CEIL:
+      truncated = _mm_cvttps_epi32( value );
+      return _mm_sub_epi32( truncated, _mm_castps_si128(
+         _mm_cmplt_ps( _mm_cvtepi32_ps( truncated ), value ) ) );
+   default:
+      return _mm_cvtps_epi32( value );
+   }
+}
+
+// Two doubles to two int32 values in the low half of the result.
+static inline __m128i round_pd_epi32( const __m128d value, int rounding )
+{
+   __m128i truncated;
+   __m128i adjust;
+
+   switch ( rounding )
+   {
+   case ROUND_TRUNCATE:
+      return _mm_cvttpd_epi32( value );
+   case ROUND_FLOOR:
+      truncated = _mm_cvttpd_epi32( value );
+      adjust = _mm_castpd_si128( _mm_cmpgt_pd( _mm_cvtepi32_pd( truncated ), value ) );
+      return _mm_add_epi32( truncated, _mm_shuffle_epi32( adjust, _MM_SHUFFLE( 3, 3, 2, 0 ) ) );
+   case ROUND_CEIL:
+      truncated = _mm_cvttpd_epi32( value );
+      adjust = _mm_castpd_si128( _mm_cmplt_pd( _mm_cvtepi32_pd( truncated ), value ) );
+      return _mm_sub_epi32( truncated, _mm_shuffle_epi32( adjust, _MM_SHUFFLE( 3, 3, 2, 0 ) ) );
+   default:
+      return _mm_cvtpd_epi32( value );
+   }
+}
+
+static inline __m128 saturate_ps_s32( __m128 value )
+{
+   value = _mm_and_ps( value, _mm_cmpord_ps( value, value ) );
+   return _mm_min_ps( _mm_max_ps( value, _mm_set1_ps( -2147483648.0f ) ), _mm_set1_ps( S32_MAX_AS_F32 ) );
+}
+
+static inline __m128d saturate_pd_s32( __m128d value )
+{
+   value = _mm_and_pd( value, _mm_cmpord_pd( value, value ) );
+   return _mm_min_pd( _mm_max_pd( value, _mm_set1_pd( -2147483648.0 ) ), _mm_set1_pd( 2147483647.0 ) );
+}
+
+// Each kernel converts exactly four elements.
+static inline void kernel_s32_s64( const int32_t* input, int64_t* output, int rounding, int saturate )
+{
+   __m128i value_vec = _mm_loadu_si128( (const __m128i *)input );
+   __m128i sign_vec  = _mm_srai_epi32( value_vec, 31 );
+
+   _mm_storeu_si128( (__m128i *)output, _mm_unpacklo_epi32( value_vec, sign_vec ) );
+   _mm_storeu_si128( (__m128i *)( output + 2 ), _mm_unpackhi_epi32( value_vec, sign_vec ) );
+}
+
+static inline void kernel_s32_f32( const int32_t* input, float* output, int rounding, int saturate )
+{
+   _mm_storeu_ps( output, _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i *)input ) ) );
+}
+
+static inline void kernel_s32_f64( const int32_t* input, double* output, int rounding, int saturate )
+{
+   __m128i value_vec = _mm_loadu_si128( (const __m128i *)input );
+
+   _mm_storeu_pd( output, _mm_cvtepi32_pd( value_vec ) );
+   _mm_storeu_pd( output + 2, _mm_cvtepi32_pd( _mm_srli_si128( value_vec, 8 ) ) );
+}
+
+static inline void kernel_s64_s32( const int64_t* input, int32_t* output, int rounding, int saturate )
+{
+   uint32_t pos = 0;
+
+   // SSE has no 64-bit to 32-bit narrowing, so this one is scalar.
+   for ( pos = 0; pos < 4; ++pos )
+   {
+      if ( saturate )
+      {
+         output[ pos ] = ( input[ pos ] > INT32_MAX ) ? INT32_MAX :
+            ( ( input[ pos ] < INT32_MIN ) ? INT32_MIN : (int32_t)input[ pos ] );
+      }
+      else
+      {
+         output[ pos ] = (int32_t)(uint32_t)input[ pos ];
+      }
+   }
+}
+
+static inline void kernel_s64_f32( const int64_t* input, float* output, int rounding, int saturate )
+{
+   uint32_t pos = 0;
+
+   for ( pos = 0; pos < 4; ++pos )
+   {
+      output[ pos ] = (float)input[ pos ];
+   }
+}
+
+static inline void kernel_s64_f64( const int64_t* input, double* output, int rounding, int saturate )
+{
+   uint32_t pos = 0;
+
+   for ( pos = 0; pos < 4; ++pos )
+   {
+      output[ pos ] = (double)input[ pos ];
+   }
+}
+
+static inline void kernel_f32_s32( const float* input, int32_t* output, int rounding, int saturate )
+{
+   __m128 value_vec = _mm_loadu_ps( input );
+
+   if ( saturate )
+   {
+      value_vec = saturate_ps_s32( value_vec );
+   }
+
+   _mm_storeu_si128( (__m128i *)output, round_ps_epi32( value_vec, rounding ) );
+}
+
+static inline void kernel_f32_s64( const float* input, int64_t* output, int rounding, int saturate )
+{
+   uint32_t pos = 0;
+
+   for ( pos = 0; pos < 4; ++pos )
+   {
+      output[ pos ] = round_to_s64( input[ pos ], rounding );
+   }
+}
+
+static inline void kernel_f32_f64( const float* input, double* output, int rounding, int saturate )
+{
+   __m128 value_vec = _mm_loadu_ps( input );
+
+   _mm_storeu_pd( output, _mm_cvtps_pd( value_vec ) );
+   _mm_storeu_pd( output + 2, _mm_cvtps_pd( _mm_movehl_ps( value_vec, value_vec ) ) );
+}
+
+static inline void kernel_f64_s32( const double* input, int32_t* output, int rounding, int saturate )
+{
+   __m128d low_vec  = _mm_loadu_pd( input );
+   __m128d high_vec = _mm_loadu_pd( input + 2 );
+
+   if ( saturate )
+   {
+      low_vec  = saturate_pd_s32( low_vec );
+      high_vec = saturate_pd_s32( high_vec );
+   }
+
+   _mm_storeu_si128( (__m128i *)output, _mm_unpacklo_epi64(
+      round_pd_epi32( low_vec, rounding ), round_pd_epi32( high_vec, rounding ) ) );
+}
+
+static inline void kernel_f64_s64( const double* input, int64_t* output, int rounding, int saturate )
+{
+   uint32_t pos = 0;
+
+   for ( pos = 0; pos < 4; ++pos )
+   {
+      output[ pos ] = round_to_s64( input[ pos ], rounding );
+   }
+}
+
+static inline void kernel_f64_f32( const double* input, float* output, int rounding, int saturate )
+{
+   _mm_storeu_ps( output, _mm_movelh_ps(
+      _mm_cvtpd_ps( _mm_loadu_pd( input ) ), _mm_cvtpd_ps( _mm_loadu_pd( input + 2 ) ) ) );
+}
+
+
+#define  TEMPLATE_CONVERT( FUNC_NAME, IN_TYPE, OUT_TYPE, KERNEL ) \
+static void FUNC_NAME( const IN_TYPE* input, OUT_TYPE* output, uint32_t length, int rounding, int saturate ) \
+{ \
+   uint32_t offset = 0; \
+\
+   IN_TYPE  input_segment[ 4 ]; \
+   OUT_TYPE output_segment[ 4 ]; \
+\
+   for ( offset = 0; offset + 4 <= length; offset += 4 ) \
+   { \
+      KERNEL( input + offset, output + offset, rounding, saturate ); \
+   } \
+\
+   if ( offset < length ) \
+   { \
+      memset( input_segment, 0, sizeof( input_segment ) ); \
+      memcpy( input_segment, input + offset, ( length - offset ) * sizeof( IN_TYPE ) ); \
+      KERNEL( input_segment, output_segment, rounding, saturate ); \
+      memcpy( output + offset, output_segment, ( length - offset ) * sizeof( OUT_TYPE ) ); \
+   } \
+}
+
+TEMPLATE_CONVERT( convert_s32_s64, int32_t, int64_t, kernel_s32_s64 );
+TEMPLATE_CONVERT( convert_s32_f32, int32_t, float, kernel_s32_f32 );
+TEMPLATE_CONVERT( convert_s32_f64, int32_t, double, kernel_s32_f64 );
+TEMPLATE_CONVERT( convert_s64_s32, int64_t, int32_t, kernel_s64_s32 );
+TEMPLATE_CONVERT( convert_s64_f32, int64_t, float, kernel_s64_f32 );
+TEMPLATE_CONVERT( convert_s64_f64, int64_t, double, kernel_s64_f64 );
+TEMPLATE_CONVERT( convert_f32_s32, float, int32_t, kernel_f32_s32 );
+TEMPLATE_CONVERT( convert_f32_s64, float, int64_t, kernel_f32_s64 );
+TEMPLATE_CONVERT( convert_f32_f64, float, double, kernel_f32_f64 );
+TEMPLATE_CONVERT( convert_f64_s32, double, int32_t, kernel_f64_s32 );
+TEMPLATE_CONVERT( convert_f64_s64, double, int64_t, kernel_f64_s64 );
+TEMPLATE_CONVERT( convert_f64_f32, double, float, kernel_f64_f32 );
+
+
+VALUE method_convert( VALUE self, VALUE data, VALUE from_type_rb, VALUE to_type_rb, VALUE rounding_rb, VALUE saturate_rb )
+{
+   uint32_t pos = 0;
+   uint32_t length = 0;
+
+   int from_type = NUM2INT( from_type_rb );
+   int to_type   = NUM2INT( to_type_rb );
+   int rounding  = NUM2INT( rounding_rb );
+   int saturate  = RTEST( saturate_rb );
+
+   uint32_t from_size = vector_type_size( from_type );
+   uint32_t to_size   = vector_type_size( to_type );
+
+   void* input_native  = NULL;
+   void* output_native = NULL;
+
+   VALUE result = Qnil;
+
+   Check_Type( data, T_ARRAY );
+
+   if ( ( rounding < ROUND_NEAREST ) || ( rounding > ROUND_CEIL ) )
+   {
+      rb_raise( rb_eArgError, "invalid rounding mode" );
+   }
+
+   length = RARRAY_LEN( data );
+   result = rb_ary_new2( length );
+
+   if ( length == 0 )
+   {
+      return result;
+   }
+
+   input_native  = malloc( length * from_size );
+   output_native = malloc( length * to_size );
+
+   for ( pos = 0; pos < length; ++pos )
+   {
+      VALUE entry = rb_ary_entry( data, pos );
+
+      switch ( from_type )
+      {
+      case VECTOR_TYPE_S32: ( (int32_t*)input_native )[ pos ] = NUM2INT( entry ); break;
+      case VECTOR_TYPE_S64: ( (int64_t*)input_native )[ pos ] = NUM2LL( entry ); break;
+      case VECTOR_TYPE_F32: ( (float*)input_native )[ pos ] = NUM2DBL( entry ); break;
+      default:              ( (double*)input_native )[ pos ] = NUM2DBL( entry ); break;
+      }
+   }
+
+   switch ( CONVERSION( from_type, to_type ) )
+   {
+   case CONVERSION( VECTOR_TYPE_S32, VECTOR_TYPE_S64 ): convert_s32_s64( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_S32, VECTOR_TYPE_F32 ): convert_s32_f32( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_S32, VECTOR_TYPE_F64 ): convert_s32_f64( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_S64, VECTOR_TYPE_S32 ): convert_s64_s32( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_S64, VECTOR_TYPE_F32 ): convert_s64_f32( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_S64, VECTOR_TYPE_F64 ): convert_s64_f64( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_F32, VECTOR_TYPE_S32 ): convert_f32_s32( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_F32, VECTOR_TYPE_S64 ): convert_f32_s64( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_F32, VECTOR_TYPE_F64 ): convert_f32_f64( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_F64, VECTOR_TYPE_S32 ): convert_f64_s32( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_F64, VECTOR_TYPE_S64 ): convert_f64_s64( input_native, output_native, length, rounding, saturate ); break;
+   case CONVERSION( VECTOR_TYPE_F64, VECTOR_TYPE_F32 ): convert_f64_f32( input_native, output_native, length, rounding, saturate ); break;
+   default:
+      memcpy( output_native, input_native, length * to_size );
+      break;
+   }
+
+   for ( pos = 0; pos < length; ++pos )
+   {
+      switch ( to_type )
+      {
+      case VECTOR_TYPE_S32: rb_ary_push( result, INT2NUM( ( (int32_t*)output_native )[ pos ] ) ); break;
+      case VECTOR_TYPE_S64: rb_ary_push( result, LL2NUM( ( (int64_t*)output_native )[ pos ] ) ); break;
+      case VECTOR_TYPE_F32: rb_ary_push( result, DBL2NUM( ( (float*)output_native )[ pos ] ) ); break;
+      default:              rb_ary_push( result, DBL2NUM( ( (double*)output_native )[ pos ] ) ); break;
+      }
+   }
+
+   free( input_native );
+   free( output_native );
+
+   return result;
+}
@@ -0,0 +1,324 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "vector_sse_convolve.h"
+#include "vector_sse_gemm.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_tuning.h"
+
+// Kernels with at most this many taps (5x5) are applied directly: each
+// vector of outputs accumulates one broadcast tap times a sliding window
+// of the input per tap. Larger 2D kernels are lowered to a GEMM by copying
+// the input windows into columns (im2col), which blocks for cache.
+#define  CONVOLVE_DIRECT_TAPS       (25)
+
+// Elements of im2col scratch each thread fills before running a GEMM.
+#define  CONVOLVE_IM2COL_ELEMENTS   (1 << 16)
+
+// Output extent and first padded input offset along one axis.
+struct convolve_axis {
+   uint32_t in;
+   uint32_t taps;
+   uint32_t out;
+   uint32_t start;
+};
+
+static struct convolve_axis convolve_axis( uint32_t in, uint32_t taps, int mode )
+{
+   struct convolve_axis axis;
+
+   axis.in = in;
+   axis.taps = taps;
+
+   // The input is padded by taps - 1 on both sides, as for full mode.
+   switch ( mode )
+   {
+   case CONVOLVE_MODE_FULL:
+      axis.out = in + taps - 1;
+      axis.start = 0;
+      break;
+   case CONVOLVE_MODE_SAME:
+      axis.out = in;
+      axis.start = ( taps - 1 ) / 2;
+      break;
+   case CONVOLVE_MODE_VALID:
+      axis.out = ( in >= taps ) ? in - taps + 1 : 0;
+      axis.start = taps - 1;
+      break;
+   default:
+      rb_raise( rb_eArgError, "invalid convolution mode" );
+   }
+
+   return axis;
+}
+
+
+#define  TEMPLATE_CORRELATE( SUFFIX, TYPE, EL_PER_VEC, VTYPE, LOADU, STOREU, SETZERO, SET1, ADD, MUL, GEMM ) \
+struct correlate_context_##SUFFIX { \
+   struct convolve_axis rows; \
+   struct convolve_axis cols; \
+   const TYPE* padded; \
+   uint32_t padded_cols; \
+   const TYPE* kernel; \
+   TYPE* out; \
+   int split_cols; \
+}; \
+\
+/* Outputs [col, col_end) of one row. The tap count is a parameter of an */ \
+/* inlined function so the common 3 and 5 wide kernels get unrolled loops. */ \
+static inline __attribute__(( always_inline )) void correlate_span_##SUFFIX( \
+   const struct correlate_context_##SUFFIX* ctx, uint32_t row, uint32_t col, uint32_t col_end, uint32_t kcols ) \
+{ \
+   const TYPE* window = NULL; \
+   const TYPE* taps = NULL; \
+   TYPE* out = ctx->out + (uint64_t)row * ctx->cols.out; \
+   uint32_t krow = 0; \
+   uint32_t tap = 0; \
+   TYPE sum = 0; \
+   VTYPE acc; \
+\
+   for ( ; col + EL_PER_VEC <= col_end; col += EL_PER_VEC ) \
+   { \
+      acc = SETZERO(); \
+      for ( krow = 0; krow < ctx->rows.taps; ++krow ) \
+      { \
+         window = ctx->padded + (uint64_t)( row + ctx->rows.start + krow ) * ctx->padded_cols + ctx->cols.start + col; \
+         taps = ctx->kernel + krow * kcols; \
+         for ( tap = 0; tap < kcols; ++tap ) \
+         { \
+            acc = ADD( acc, MUL( LOADU( window + tap ), SET1( taps[ tap ] ) ) ); \
+         } \
+      } \
+      STOREU( out + col, acc ); \
+   } \
+\
+   for ( ; col < col_end; ++col ) \
+   { \
+      sum = 0; \
+      for ( krow = 0; krow < ctx->rows.taps; ++krow ) \
+      { \
+         window = ctx->padded + (uint64_t)( row + ctx->rows.start + krow ) * ctx->padded_cols + ctx->cols.start + col; \
+         taps = ctx->kernel + krow * kcols; \
+         for ( tap = 0; tap < kcols; ++tap ) \
+         { \
+            sum += window[ tap ] * taps[ tap ]; \
+         } \
+      } \
+      out[ col ] = sum; \
+   } \
+} \
+\
+static void correlate_direct_##SUFFIX( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct correlate_context_##SUFFIX* ctx = (const struct correlate_context_##SUFFIX*)context; \
+   uint32_t row_begin = ctx->split_cols ? 0 : begin; \
+   uint32_t row_end = ctx->split_cols ? ctx->rows.out : end; \
+   uint32_t col_begin = ctx->split_cols ? begin : 0; \
+   uint32_t col_end = ctx->split_cols ? end : ctx->cols.out; \
+   uint32_t row = 0; \
+\
+   for ( row = row_begin; row < row_end; ++row ) \
+   { \
+      switch ( ctx->cols.taps ) \
+      { \
+      case 3: \
+         correlate_span_##SUFFIX( ctx, row, col_begin, col_end, 3 ); \
+         break; \
+      case 5: \
+         correlate_span_##SUFFIX( ctx, row, col_begin, col_end, 5 ); \
+         break; \
+      default: \
+         correlate_span_##SUFFIX( ctx, row, col_begin, col_end, ctx->cols.taps ); \
+         break; \
+      } \
+   } \
+} \
+\
+/* Copies the windows of a band of output rows into a taps x pixels */ \
+/* matrix, one row per kernel element, and multiplies it by the kernel */ \
+/* as a 1 x taps row vector. */ \
+static void correlate_im2col_##SUFFIX( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct correlate_context_##SUFFIX* ctx = (const struct correlate_context_##SUFFIX*)context; \
+   uint32_t taps = ctx->rows.taps * ctx->cols.taps; \
+   uint32_t band = CONVOLVE_IM2COL_ELEMENTS / ( taps * ctx->cols.out ); \
+   uint32_t band_end = 0; \
+   uint32_t pixels = 0; \
+   uint32_t row = 0; \
+   uint32_t krow = 0; \
+   uint32_t kcol = 0; \
+   TYPE* columns = NULL; \
+   TYPE* target = NULL; \
+\
+   band = ( band > 0 ) ? band : 1; \
+   columns = (TYPE*)malloc( (uint64_t)taps * band * ctx->cols.out * sizeof( TYPE ) ); \
+\
+   for ( ; begin < end; begin = band_end ) \
+   { \
+      band_end = ( end - begin > band ) ? begin + band : end; \
+      pixels = ( band_end - begin ) * ctx->cols.out; \
+\
+      for ( krow = 0; krow < ctx->rows.taps; ++krow ) \
+      { \
+         for ( kcol = 0; kcol < ctx->cols.taps; ++kcol ) \
+         { \
+            target = columns + (uint64_t)( krow * ctx->cols.taps + kcol ) * pixels; \
+            for ( row = begin; row < band_end; ++row ) \
+            { \
+               memcpy( target + (uint64_t)( row - begin ) * ctx->cols.out, \
+                  ctx->padded + (uint64_t)( row + ctx->rows.start + krow ) * ctx->padded_cols + ctx->cols.start + kcol, \
+                  ctx->cols.out * sizeof( TYPE ) ); \
+            } \
+         } \
+      } \
+\
+      GEMM( 1, pixels, taps, 1, ctx->kernel, taps, columns, pixels, \
+         ctx->out + (uint64_t)begin * ctx->cols.out, pixels ); \
+   } \
+\
+   free( columns ); \
+} \
+\
+VALUE method_correlate_##SUFFIX( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, \
+   VALUE kernel, VALUE krows_rb, VALUE kcols_rb, VALUE mode_rb ) \
+{ \
+   struct correlate_context_##SUFFIX ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t rows = NUM2UINT( rows_rb ); \
+   uint32_t cols = NUM2UINT( cols_rb ); \
+   uint32_t krows = NUM2UINT( krows_rb ); \
+   uint32_t kcols = NUM2UINT( kcols_rb ); \
+   int mode = NUM2INT( mode_rb ); \
+   uint64_t length = 0; \
+   uint64_t work = 0; \
+   uint32_t units = 0; \
+   uint32_t chunks = 0; \
+   uint32_t chunk = 0; \
+   uint32_t row = 0; \
+   uint32_t col = 0; \
+   uint64_t pos = 0; \
+   TYPE* padded = NULL; \
+   TYPE* kernel_native = NULL; \
+   parallel_task task = correlate_direct_##SUFFIX; \
+   VALUE result; \
+\
+   Check_Type( data, T_ARRAY ); \
+   Check_Type( kernel, T_ARRAY ); \
+\
+   if ( ( (uint64_t)rows * cols != (uint64_t)RARRAY_LEN( data ) ) || \
+        ( (uint64_t)krows * kcols != (uint64_t)RARRAY_LEN( kernel ) ) || \
+        ( krows == 0 ) || ( kcols == 0 ) ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   ctx.rows = convolve_axis( rows, krows, mode ); \
+   ctx.cols = convolve_axis( cols, kcols, mode ); \
+   ctx.padded_cols = cols + 2 * ( kcols - 1 ); \
+   length = (uint64_t)ctx.rows.out * ctx.cols.out; \
+\
+   kernel_native = (TYPE*)malloc( (uint64_t)krows * kcols * sizeof( TYPE ) ); \
+   for ( pos = 0; pos < (uint64_t)krows * kcols; ++pos ) \
+   { \
+      kernel_native[ pos ] = NUM2DBL( rb_ary_entry( kernel, pos ) ); \
+   } \
+\
+   padded = (TYPE*)calloc( (uint64_t)( rows + 2 * ( krows - 1 ) ) * ctx.padded_cols, sizeof( TYPE ) ); \
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      for ( col = 0; col < cols; ++col ) \
+      { \
+         padded[ (uint64_t)( row + krows - 1 ) * ctx.padded_cols + col + kcols - 1 ] = \
+            NUM2DBL( rb_ary_entry( data, (long)row * cols + col ) ); \
+      } \
+   } \
+\
+   ctx.padded = padded; \
+   ctx.kernel = kernel_native; \
+   ctx.out = (TYPE*)calloc( length + 1, sizeof( TYPE ) ); \
+\
+   if ( ( krows > 1 ) && ( (uint64_t)krows * kcols > CONVOLVE_DIRECT_TAPS ) ) \
+   { \
+      task = correlate_im2col_##SUFFIX; \
+   } \
+\
+   /* Threads split the output rows, or the columns of a single row when */ \
+   /* applying the kernel directly. */ \
+   ctx.split_cols = ( ctx.rows.out == 1 ) && ( task == correlate_direct_##SUFFIX ); \
+   units = ctx.split_cols ? ( ctx.cols.out + EL_PER_VEC - 1 ) / EL_PER_VEC : ctx.rows.out; \
+\
+   work = length * krows * kcols / vector_sse_tuning.gemm_work_per_thread; \
+   chunks = parallel_thread_count(); \
+   if ( work < chunks ) \
+   { \
+      chunks = ( work > 0 ) ? (uint32_t)work : 1; \
+   } \
+   if ( chunks > units ) \
+   { \
+      chunks = ( units > 0 ) ? units : 1; \
+   } \
+\
+   for ( chunk = 0; chunk <= chunks; ++chunk ) \
+   { \
+      bounds[ chunk ] = (uint32_t)( (uint64_t)units * chunk / chunks ); \
+      if ( ctx.split_cols ) \
+      { \
+         bounds[ chunk ] = ( bounds[ chunk ] * EL_PER_VEC < ctx.cols.out ) ? \
+            bounds[ chunk ] * EL_PER_VEC : ctx.cols.out; \
+      } \
+   } \
+\
+   if ( length > 0 ) \
+   { \
+      parallel_run( task, &ctx, bounds, chunks ); \
+   } \
+\
+   result = rb_ary_new2( length ); \
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( ctx.out[ pos ] ) ); \
+   } \
+\
+   free( ctx.out ); \
+   free( padded ); \
+   free( kernel_native ); \
+\
+   return rb_ary_new3( 3, result, UINT2NUM( ctx.rows.out ), UINT2NUM( ctx.cols.out ) ); \
+}
+
+TEMPLATE_CORRELATE( f32, float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps,
+   _mm_setzero_ps, _mm_set1_ps, _mm_add_ps, _mm_mul_ps, gemm_f32_serial );
+TEMPLATE_CORRELATE( f64, double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd,
+   _mm_setzero_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd, gemm_f64_serial );
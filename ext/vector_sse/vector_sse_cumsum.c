@@ -0,0 +1,423 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <string.h>
+#include <emmintrin.h>
+#include "vector_sse_cumsum.h"
+#include "vector_sse_common.h"
+#include "vector_sse_parallel.h"
+
+// Minimum number of elements each thread scans.
+#define  CUMULATIVE_WORK_PER_THREAD   (1 << 18)
+
+// Shift VEC left by BYTES and fill the vacated low lanes from IDENT (the
+// identity element of the scan operator, broadcast to every lane).
+#define  SHIFT_IN( VEC, BYTES, IDENT ) \
+   _mm_or_si128( _mm_slli_si128( VEC, BYTES ), _mm_srli_si128( IDENT, 16 - (BYTES) ) )
+
+#define  SPLAT_LAST_32  _MM_SHUFFLE( 3, 3, 3, 3 )
+#define  SPLAT_LAST_64  _MM_SHUFFLE( 3, 2, 3, 2 )
+
+// In-register inclusive scan: log2(EL_PER_VEC) shift-and-combine steps.
+#define  TEMPLATE_SCAN_4( FUNC_NAME, OP ) \
+static inline __m128i FUNC_NAME( __m128i vec, const __m128i identity ) \
+{ \
+   vec = OP( vec, SHIFT_IN( vec, 4, identity ) ); \
+   return OP( vec, SHIFT_IN( vec, 8, identity ) ); \
+}
+
+#define  TEMPLATE_SCAN_2( FUNC_NAME, OP ) \
+static inline __m128i FUNC_NAME( __m128i vec, const __m128i identity ) \
+{ \
+   return OP( vec, SHIFT_IN( vec, 8, identity ) ); \
+}
+
+TEMPLATE_SCAN_4( scan_add_s32, _mm_add_epi32 );
+TEMPLATE_SCAN_2( scan_add_s64, _mm_add_epi64 );
+TEMPLATE_SCAN_4( scan_add_f32, add_f32 );
+TEMPLATE_SCAN_2( scan_add_f64, add_f64 );
+
+TEMPLATE_SCAN_4( scan_mul_s32, mul_lo_s32 );
+TEMPLATE_SCAN_2( scan_mul_s64, mul_lo_s64 );
+TEMPLATE_SCAN_4( scan_mul_f32, mul_f32 );
+TEMPLATE_SCAN_2( scan_mul_f64, mul_f64 );
+
+
+#define  TEMPLATE_CUMULATIVE_S( FUNC_NAME, TYPE, CONV_IN, CONV_OUT, EL_PER_VEC, IDENTITY, OP, SCAN, SPLAT_LAST ) \
+static inline __m128i FUNC_NAME##_load( const TYPE* input, uint32_t count ) \
+{ \
+   uint32_t vector_pos = 0; \
+   TYPE segment[ EL_PER_VEC ]; \
+\
+   if ( count >= EL_PER_VEC ) \
+   { \
+      return _mm_loadu_si128( (const __m128i *)input ); \
+   } \
+\
+   for ( vector_pos = 0; vector_pos < EL_PER_VEC; ++vector_pos ) \
+   { \
+      segment[ vector_pos ] = ( vector_pos < count ) ? input[ vector_pos ] : IDENTITY; \
+   } \
+\
+   return _mm_loadu_si128( (const __m128i *)segment ); \
+} \
+\
+static inline void FUNC_NAME##_store( TYPE* output, const __m128i vec, uint32_t count ) \
+{ \
+   TYPE segment[ EL_PER_VEC ]; \
+\
+   if ( count >= EL_PER_VEC ) \
+   { \
+      _mm_storeu_si128( (__m128i *)output, vec ); \
+   } \
+   else \
+   { \
+      _mm_storeu_si128( (__m128i *)segment, vec ); \
+      memcpy( output, segment, count * sizeof( TYPE ) ); \
+   } \
+} \
+\
+static inline TYPE FUNC_NAME##_combine( TYPE left, TYPE right ) \
+{ \
+   TYPE result; \
+   FUNC_NAME##_store( &result, OP( FUNC_NAME##_load( &left, 1 ), FUNC_NAME##_load( &right, 1 ) ), 1 ); \
+   return result; \
+} \
+\
+static void FUNC_NAME##_scan_row( const TYPE* input, TYPE* output, uint32_t count, int exclusive ) \
+{ \
+   uint32_t offset = 0; \
+\
+   const __m128i identity_vec = FUNC_NAME##_load( NULL, 0 ); \
+\
+   __m128i carry_vec = identity_vec; \
+   __m128i scan_vec; \
+   __m128i inclusive_vec; \
+   __m128i result_vec; \
+\
+   for ( offset = 0; offset < count; offset += EL_PER_VEC ) \
+   { \
+      scan_vec = SCAN( FUNC_NAME##_load( input + offset, count - offset ), identity_vec ); \
+      inclusive_vec = OP( carry_vec, scan_vec ); \
+\
+      if ( exclusive ) \
+      { \
+         result_vec = OP( carry_vec, SHIFT_IN( scan_vec, sizeof( TYPE ), identity_vec ) ); \
+      } \
+      else \
+      { \
+         result_vec = inclusive_vec; \
+      } \
+\
+      carry_vec = _mm_shuffle_epi32( inclusive_vec, SPLAT_LAST ); \
+\
+      FUNC_NAME##_store( output + offset, result_vec, count - offset ); \
+   } \
+} \
+\
+/* Combines 'carry' into every element of output[ begin, end ). */ \
+static void FUNC_NAME##_apply_carry( TYPE* output, uint32_t begin, uint32_t end, TYPE carry ) \
+{ \
+   uint32_t offset = 0; \
+   TYPE segment[ EL_PER_VEC ]; \
+   __m128i carry_vec; \
+\
+   for ( offset = 0; offset < EL_PER_VEC; ++offset ) \
+   { \
+      segment[ offset ] = carry; \
+   } \
+   carry_vec = FUNC_NAME##_load( segment, EL_PER_VEC ); \
+\
+   for ( offset = begin; offset < end; offset += EL_PER_VEC ) \
+   { \
+      FUNC_NAME##_store( output + offset, \
+         OP( carry_vec, FUNC_NAME##_load( output + offset, end - offset ) ), end - offset ); \
+   } \
+} \
+\
+/* Scans columns [ begin, end ) of every row down the rows. */ \
+static void FUNC_NAME##_down_cols( const TYPE* input, TYPE* output, uint32_t rows, uint32_t cols, \
+   uint32_t begin, uint32_t end, int exclusive ) \
+{ \
+   uint32_t row    = 0; \
+   uint32_t offset = 0; \
+\
+   const __m128i identity_vec = FUNC_NAME##_load( NULL, 0 ); \
+\
+   __m128i carry_vec; \
+   __m128i input_vec; \
+\
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      for ( offset = begin; offset < end; offset += EL_PER_VEC ) \
+      { \
+         if ( row == 0 ) \
+         { \
+            carry_vec = identity_vec; \
+         } \
+         else \
+         { \
+            carry_vec = FUNC_NAME##_load( output + (uint64_t)( row - 1 ) * cols + offset, end - offset ); \
+         } \
+\
+         if ( !exclusive ) \
+         { \
+            input_vec = FUNC_NAME##_load( input + (uint64_t)row * cols + offset, end - offset ); \
+         } \
+         else if ( row > 0 ) \
+         { \
+            input_vec = FUNC_NAME##_load( input + (uint64_t)( row - 1 ) * cols + offset, end - offset ); \
+         } \
+         else \
+         { \
+            input_vec = identity_vec; \
+         } \
+\
+         FUNC_NAME##_store( output + (uint64_t)row * cols + offset, OP( carry_vec, input_vec ), end - offset ); \
+      } \
+   } \
+} \
+\
+struct FUNC_NAME##_context { \
+   const TYPE* input; \
+   TYPE*       output; \
+   uint32_t    rows; \
+   uint32_t    cols; \
+   int         exclusive; \
+   /* Two-pass scans of a single row: chunk boundaries and the carry \
+      into each chunk. */ \
+   const uint32_t* bounds; \
+   TYPE            carries[ PARALLEL_MAX_THREADS ]; \
+}; \
+\
+static void FUNC_NAME##_rows_task( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct FUNC_NAME##_context* ctx = (const struct FUNC_NAME##_context*)context; \
+   uint32_t row = 0; \
+\
+   for ( row = begin; row < end; ++row ) \
+   { \
+      FUNC_NAME##_scan_row( ctx->input + (uint64_t)row * ctx->cols, \
+         ctx->output + (uint64_t)row * ctx->cols, ctx->cols, ctx->exclusive ); \
+   } \
+} \
+\
+static void FUNC_NAME##_cols_task( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct FUNC_NAME##_context* ctx = (const struct FUNC_NAME##_context*)context; \
+   FUNC_NAME##_down_cols( ctx->input, ctx->output, ctx->rows, ctx->cols, begin, end, ctx->exclusive ); \
+} \
+\
+static void FUNC_NAME##_chunk_scan_task( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct FUNC_NAME##_context* ctx = (const struct FUNC_NAME##_context*)context; \
+   FUNC_NAME##_scan_row( ctx->input + begin, ctx->output + begin, end - begin, ctx->exclusive ); \
+} \
+\
+static void FUNC_NAME##_chunk_carry_task( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct FUNC_NAME##_context* ctx = (const struct FUNC_NAME##_context*)context; \
+   uint32_t chunk = 0; \
+\
+   while ( ctx->bounds[ chunk ] != begin ) \
+   { \
+      ++chunk; \
+   } \
+   if ( chunk > 0 ) \
+   { \
+      FUNC_NAME##_apply_carry( ctx->output, begin, end, ctx->carries[ chunk ] ); \
+   } \
+} \
+\
+/* Splits 'count' items into up to 'limit' equal chunks of at least \
+   CUMULATIVE_WORK_PER_THREAD elements, each 'weight' elements per item, \
+   and returns the number of chunks. */ \
+static uint32_t FUNC_NAME##_partition( uint32_t count, uint64_t weight, uint32_t limit, uint32_t* bounds ) \
+{ \
+   uint64_t chunks = (uint64_t)count * weight / CUMULATIVE_WORK_PER_THREAD; \
+   uint32_t threads = parallel_thread_count(); \
+   uint32_t chunk = 0; \
+\
+   chunks = ( chunks > threads ) ? threads : chunks; \
+   chunks = ( chunks > limit ) ? limit : chunks; \
+   chunks = ( chunks < 1 ) ? 1 : chunks; \
+\
+   for ( chunk = 0; chunk <= chunks; ++chunk ) \
+   { \
+      bounds[ chunk ] = (uint32_t)( (uint64_t)count * chunk / chunks ); \
+   } \
+\
+   return (uint32_t)chunks; \
+} \
+\
+/* Rows are scanned in parallel when there are enough of them. A long row \
+   is scanned in two passes instead: each chunk is scanned on its own, the \
+   carry into each chunk is found from the chunk totals, and a second \
+   parallel pass combines the carries in. */ \
+static void FUNC_NAME##_along_rows( const TYPE* input, TYPE* output, uint32_t rows, uint32_t cols, int exclusive ) \
+{ \
+   struct FUNC_NAME##_context ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t chunks = FUNC_NAME##_partition( rows, cols, rows, bounds ); \
+   uint32_t chunk = 0; \
+   uint32_t row = 0; \
+   uint32_t last = 0; \
+   TYPE total; \
+\
+   ctx.input = input; \
+   ctx.output = output; \
+   ctx.rows = rows; \
+   ctx.cols = cols; \
+   ctx.exclusive = exclusive; \
+   ctx.bounds = bounds; \
+\
+   if ( chunks > 1 ) \
+   { \
+      parallel_run( FUNC_NAME##_rows_task, &ctx, bounds, chunks ); \
+      return; \
+   } \
+\
+   chunks = FUNC_NAME##_partition( cols, 1, cols, bounds ); \
+\
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      ctx.input = input + (uint64_t)row * cols; \
+      ctx.output = output + (uint64_t)row * cols; \
+\
+      parallel_run( FUNC_NAME##_chunk_scan_task, &ctx, bounds, chunks ); \
+\
+      for ( chunk = 1; chunk < chunks; ++chunk ) \
+      { \
+         last = bounds[ chunk ] - 1; \
+         total = exclusive ? FUNC_NAME##_combine( ctx.output[ last ], ctx.input[ last ] ) : ctx.output[ last ]; \
+         ctx.carries[ chunk ] = ( chunk > 1 ) ? FUNC_NAME##_combine( ctx.carries[ chunk - 1 ], total ) : total; \
+      } \
+\
+      if ( chunks > 1 ) \
+      { \
+         parallel_run( FUNC_NAME##_chunk_carry_task, &ctx, bounds, chunks ); \
+      } \
+   } \
+} \
+\
+/* Columns are independent, so they are split across threads in whole \
+   vectors. */ \
+static void FUNC_NAME##_along_cols( const TYPE* input, TYPE* output, uint32_t rows, uint32_t cols, int exclusive ) \
+{ \
+   struct FUNC_NAME##_context ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t vectors = ( cols + EL_PER_VEC - 1 ) / EL_PER_VEC; \
+   uint32_t chunks = FUNC_NAME##_partition( vectors, (uint64_t)rows * EL_PER_VEC, vectors, bounds ); \
+   uint32_t chunk = 0; \
+\
+   for ( chunk = 0; chunk <= chunks; ++chunk ) \
+   { \
+      bounds[ chunk ] = ( bounds[ chunk ] * EL_PER_VEC < cols ) ? bounds[ chunk ] * EL_PER_VEC : cols; \
+   } \
+\
+   ctx.input = input; \
+   ctx.output = output; \
+   ctx.rows = rows; \
+   ctx.cols = cols; \
+   ctx.exclusive = exclusive; \
+\
+   parallel_run( FUNC_NAME##_cols_task, &ctx, bounds, chunks ); \
+} \
+\
+VALUE FUNC_NAME( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive ) \
+{ \
+   uint32_t pos = 0; \
+\
+   uint32_t rows = NUM2UINT( rows_rb ); \
+   uint32_t cols = NUM2UINT( cols_rb ); \
+   int32_t  axis = NUM2INT( axis_rb ); \
+   uint32_t length = rows * cols; \
+\
+   TYPE* input_native  = NULL; \
+   TYPE* output_native = NULL; \
+\
+   VALUE result = Qnil; \
+\
+   Check_Type( data, T_ARRAY ); \
+\
+   if ( RARRAY_LEN( data ) != length ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   if ( ( axis != 0 ) && ( axis != 1 ) ) \
+   { \
+      rb_raise( rb_eArgError, "axis must be 0 or 1" ); \
+   } \
+\
+   result = rb_ary_new2( length ); \
+\
+   if ( length > 0 ) \
+   { \
+      input_native  = (TYPE*) malloc( length * sizeof( TYPE ) ); \
+      output_native = (TYPE*) malloc( length * sizeof( TYPE ) ); \
+\
+      for ( pos = 0; pos < length; ++pos ) \
+      { \
+         input_native[ pos ] = CONV_IN( rb_ary_entry( data, pos ) ); \
+      } \
+\
+      if ( axis == 0 ) \
+      { \
+         FUNC_NAME##_along_cols( input_native, output_native, rows, cols, RTEST( exclusive ) ); \
+      } \
+      else \
+      { \
+         FUNC_NAME##_along_rows( input_native, output_native, rows, cols, RTEST( exclusive ) ); \
+      } \
+\
+      for ( pos = 0; pos < length; ++pos ) \
+      { \
+         rb_ary_push( result, CONV_OUT( output_native[ pos ] ) ); \
+      } \
+\
+      free( input_native ); \
+      free( output_native ); \
+   } \
+\
+   return result; \
+}
+
+TEMPLATE_CUMULATIVE_S( method_cumsum_s32, int32_t, NUM2INT, INT2NUM, 4, 0, _mm_add_epi32, scan_add_s32, SPLAT_LAST_32 );
+TEMPLATE_CUMULATIVE_S( method_cumsum_s64, int64_t, NUM2LL, LL2NUM, 2, 0, _mm_add_epi64, scan_add_s64, SPLAT_LAST_64 );
+TEMPLATE_CUMULATIVE_S( method_cumsum_f32, float, NUM2DBL, DBL2NUM, 4, 0, add_f32, scan_add_f32, SPLAT_LAST_32 );
+TEMPLATE_CUMULATIVE_S( method_cumsum_f64, double, NUM2DBL, DBL2NUM, 2, 0, add_f64, scan_add_f64, SPLAT_LAST_64 );
+
+TEMPLATE_CUMULATIVE_S( method_cumprod_s32, int32_t, NUM2INT, INT2NUM, 4, 1, mul_lo_s32, scan_mul_s32, SPLAT_LAST_32 );
+TEMPLATE_CUMULATIVE_S( method_cumprod_s64, int64_t, NUM2LL, LL2NUM, 2, 1, mul_lo_s64, scan_mul_s64, SPLAT_LAST_64 );
+TEMPLATE_CUMULATIVE_S( method_cumprod_f32, float, NUM2DBL, DBL2NUM, 4, 1, mul_f32, scan_mul_f32, SPLAT_LAST_32 );
+TEMPLATE_CUMULATIVE_S( method_cumprod_f64, double, NUM2DBL, DBL2NUM, 2, 1, mul_f64, scan_mul_f64, SPLAT_LAST_64 );
@@ -0,0 +1,48 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_CUMSUM_H
+#define  VECTOR_SSE_CUMSUM_H
+
+#include "ruby.h"
+
+VALUE method_cumsum_s32( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+VALUE method_cumsum_s64( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+VALUE method_cumsum_f32( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+VALUE method_cumsum_f64( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+
+VALUE method_cumprod_s32( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+VALUE method_cumprod_s64( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+VALUE method_cumprod_f32( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+VALUE method_cumprod_f64( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE axis_rb, VALUE exclusive );
+
+#endif // VECTOR_SSE_CUMSUM_H
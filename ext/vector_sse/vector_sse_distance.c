@@ -0,0 +1,549 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <emmintrin.h>
+#include "vector_sse_distance.h"
+#include "vector_sse_gemm.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_tuning.h"
+
+// Dot products are computed a tile at a time, QUERY_BLOCK left (query) rows
+// by CATALOGUE_BLOCK right (catalogue) rows, by a GEMM against a transposed
+// copy of the right operand. Each tile is turned into scores while it is
+// still in cache, so knn never holds more than one tile per thread.
+#define  QUERY_BLOCK        (32)
+#define  CATALOGUE_BLOCK    (256)
+
+
+// Split 'rows' left rows evenly across threads, by the GEMM work threshold.
+static uint32_t distance_partition( uint32_t rows, uint64_t work, uint32_t* bounds )
+{
+   uint64_t chunks = work / vector_sse_tuning.gemm_work_per_thread;
+   uint32_t threads = parallel_thread_count();
+   uint32_t chunk = 0;
+
+   if ( chunks > threads )
+   {
+      chunks = threads;
+   }
+   if ( chunks > rows )
+   {
+      chunks = rows;
+   }
+   if ( chunks == 0 )
+   {
+      chunks = 1;
+   }
+
+   for ( chunk = 0; chunk <= chunks; ++chunk )
+   {
+      bounds[ chunk ] = (uint32_t)( (uint64_t)rows * chunk / chunks );
+   }
+
+   return (uint32_t)chunks;
+}
+
+
+#define  TEMPLATE_DISTANCE_S( PAIRWISE_NAME, KNN_NAME, TYPE, EL_PER_VEC, VTYPE, LOADU, SET1, CMPLT, MOVEMASK, GEMM ) \
+struct PAIRWISE_NAME##_context { \
+   const TYPE* left; \
+   const TYPE* right_t; \
+   const TYPE* left_norms; \
+   const TYPE* right_norms; \
+   uint32_t    cols; \
+   uint32_t    right_rows; \
+   int         metric; \
+   TYPE*       out; \
+   uint32_t    k; \
+   TYPE*       heap_scores; \
+   int32_t*    heap_indices; \
+}; \
+\
+/* Scores are ordered so that smaller is closer for every metric. */ \
+static inline TYPE PAIRWISE_NAME##_score( TYPE dot, TYPE left_norm, TYPE right_norm, int metric ) \
+{ \
+   switch ( metric ) \
+   { \
+   case DISTANCE_METRIC_L2: \
+      return left_norm + right_norm - 2 * dot; \
+   case DISTANCE_METRIC_COSINE: \
+      if ( ( left_norm > 0 ) && ( right_norm > 0 ) ) \
+      { \
+         return 1 - dot / sqrt( left_norm * right_norm ); \
+      } \
+      return 1; \
+   default: \
+      return -dot; \
+   } \
+} \
+\
+static inline TYPE PAIRWISE_NAME##_finish( TYPE score, int metric ) \
+{ \
+   switch ( metric ) \
+   { \
+   case DISTANCE_METRIC_L2: \
+      /* Rounding can leave a tiny negative score; NaN stays NaN. */ \
+      return ( score > 0 ) ? sqrt( score ) : isnan( score ) ? score : 0; \
+   case DISTANCE_METRIC_COSINE: \
+      return score; \
+   default: \
+      return -score; \
+   } \
+} \
+\
+static TYPE* PAIRWISE_NAME##_native( VALUE data, uint32_t length ) \
+{ \
+   uint32_t pos = 0; \
+   TYPE* native = (TYPE*) malloc( ( length > 0 ? length : 1 ) * sizeof( TYPE ) ); \
+\
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      native[ pos ] = NUM2DBL( rb_ary_entry( data, pos ) ); \
+   } \
+\
+   return native; \
+} \
+\
+/* Squared row norms go through the same GEMM as the dot products, so a */ \
+/* row scored against itself cancels exactly. */ \
+static TYPE* PAIRWISE_NAME##_norms( const TYPE* data, uint32_t rows, uint32_t cols ) \
+{ \
+   uint32_t row = 0; \
+   TYPE* norms = (TYPE*) calloc( rows > 0 ? rows : 1, sizeof( TYPE ) ); \
+\
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      GEMM( 1, 1, cols, 1, data + (uint64_t)row * cols, cols, data + (uint64_t)row * cols, 1, norms + row, 1 ); \
+   } \
+\
+   return norms; \
+} \
+\
+/* The rows x cols matrix 'data' as a cols x rows matrix. */ \
+static TYPE* PAIRWISE_NAME##_transpose( const TYPE* data, uint32_t rows, uint32_t cols ) \
+{ \
+   uint32_t row = 0; \
+   uint32_t col = 0; \
+   TYPE* transposed = (TYPE*) malloc( ( (uint64_t)rows * cols > 0 ? (uint64_t)rows * cols : 1 ) * sizeof( TYPE ) ); \
+\
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      for ( col = 0; col < cols; ++col ) \
+      { \
+         transposed[ (uint64_t)col * rows + row ] = data[ (uint64_t)row * cols + col ]; \
+      } \
+   } \
+\
+   return transposed; \
+} \
+\
+static void PAIRWISE_NAME##_check( VALUE left, uint32_t left_rows, uint32_t left_cols, VALUE right, uint32_t right_rows, uint32_t right_cols, int metric ) \
+{ \
+   Check_Type( left, T_ARRAY ); \
+   Check_Type( right, T_ARRAY ); \
+\
+   if ( left_cols != right_cols ) \
+   { \
+      rb_raise( rb_eRuntimeError, "invalid matrix dimensions" ); \
+   } \
+\
+   if ( ( RARRAY_LEN( left ) != left_rows * left_cols ) || \
+        ( RARRAY_LEN( right ) != right_rows * right_cols ) ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   if ( ( metric < DISTANCE_METRIC_L2 ) || ( metric > DISTANCE_METRIC_DOT ) ) \
+   { \
+      rb_raise( rb_eArgError, "invalid distance metric" ); \
+   } \
+} \
+\
+/* Loads both operands, their norms and the transposed right operand. */ \
+static void PAIRWISE_NAME##_context_init( struct PAIRWISE_NAME##_context* ctx, \
+   VALUE left, uint32_t left_rows, VALUE right, uint32_t right_rows, uint32_t cols, int metric ) \
+{ \
+   TYPE* right_native = PAIRWISE_NAME##_native( right, right_rows * cols ); \
+\
+   ctx->left        = PAIRWISE_NAME##_native( left, left_rows * cols ); \
+   ctx->left_norms  = PAIRWISE_NAME##_norms( ctx->left, left_rows, cols ); \
+   ctx->right_norms = PAIRWISE_NAME##_norms( right_native, right_rows, cols ); \
+   ctx->right_t     = PAIRWISE_NAME##_transpose( right_native, right_rows, cols ); \
+   ctx->cols        = cols; \
+   ctx->right_rows  = right_rows; \
+   ctx->metric      = metric; \
+\
+   free( right_native ); \
+} \
+\
+static void PAIRWISE_NAME##_context_free( struct PAIRWISE_NAME##_context* ctx ) \
+{ \
+   free( (TYPE*)ctx->left ); \
+   free( (TYPE*)ctx->right_t ); \
+   free( (TYPE*)ctx->left_norms ); \
+   free( (TYPE*)ctx->right_norms ); \
+} \
+\
+/* Scores of left rows [row, row_end) against right rows [col, col_end), */ \
+/* written to 'scores' with a row stride of 'ld'. */ \
+static void PAIRWISE_NAME##_tile( const struct PAIRWISE_NAME##_context* ctx, \
+   uint32_t row, uint32_t row_end, uint32_t col, uint32_t col_end, TYPE* scores, uint32_t ld ) \
+{ \
+   uint32_t pos = 0; \
+   uint32_t offset = 0; \
+   TYPE* target = NULL; \
+\
+   for ( pos = row; pos < row_end; ++pos ) \
+   { \
+      memset( scores + (uint64_t)( pos - row ) * ld, 0, ( col_end - col ) * sizeof( TYPE ) ); \
+   } \
+\
+   GEMM( row_end - row, col_end - col, ctx->cols, 1, \
+      ctx->left + (uint64_t)row * ctx->cols, ctx->cols, \
+      ctx->right_t + col, ctx->right_rows, scores, ld ); \
+\
+   for ( pos = row; pos < row_end; ++pos ) \
+   { \
+      target = scores + (uint64_t)( pos - row ) * ld; \
+      for ( offset = 0; offset < col_end - col; ++offset ) \
+      { \
+         target[ offset ] = PAIRWISE_NAME##_score( target[ offset ], \
+            ctx->left_norms[ pos ], ctx->right_norms[ col + offset ], ctx->metric ); \
+      } \
+   } \
+} \
+\
+static void PAIRWISE_NAME##_rows( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct PAIRWISE_NAME##_context* ctx = (const struct PAIRWISE_NAME##_context*)context; \
+   uint32_t row = 0; \
+   uint32_t row_end = 0; \
+   uint32_t col = 0; \
+   uint32_t col_end = 0; \
+   uint32_t pos = 0; \
+   uint32_t offset = 0; \
+   TYPE* target = NULL; \
+\
+   for ( row = begin; row < end; row = row_end ) \
+   { \
+      row_end = ( end - row > QUERY_BLOCK ) ? row + QUERY_BLOCK : end; \
+\
+      for ( col = 0; col < ctx->right_rows; col = col_end ) \
+      { \
+         col_end = ( ctx->right_rows - col > CATALOGUE_BLOCK ) ? col + CATALOGUE_BLOCK : ctx->right_rows; \
+         PAIRWISE_NAME##_tile( ctx, row, row_end, col, col_end, \
+            ctx->out + (uint64_t)row * ctx->right_rows + col, ctx->right_rows ); \
+\
+         for ( pos = row; pos < row_end; ++pos ) \
+         { \
+            target = ctx->out + (uint64_t)pos * ctx->right_rows + col; \
+            for ( offset = 0; offset < col_end - col; ++offset ) \
+            { \
+               target[ offset ] = PAIRWISE_NAME##_finish( target[ offset ], ctx->metric ); \
+            } \
+         } \
+      } \
+   } \
+} \
+\
+VALUE PAIRWISE_NAME( VALUE self, VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE right, VALUE right_rows_rb, VALUE right_cols_rb, VALUE metric_rb ) \
+{ \
+   struct PAIRWISE_NAME##_context ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t chunks = 0; \
+   uint64_t pos = 0; \
+\
+   uint32_t left_rows  = NUM2UINT( left_rows_rb ); \
+   uint32_t left_cols  = NUM2UINT( left_cols_rb ); \
+   uint32_t right_rows = NUM2UINT( right_rows_rb ); \
+   uint32_t right_cols = NUM2UINT( right_cols_rb ); \
+   int      metric     = NUM2INT( metric_rb ); \
+\
+   uint64_t result_length = (uint64_t)left_rows * right_rows; \
+\
+   VALUE result = Qnil; \
+\
+   PAIRWISE_NAME##_check( left, left_rows, left_cols, right, right_rows, right_cols, metric ); \
+\
+   PAIRWISE_NAME##_context_init( &ctx, left, left_rows, right, right_rows, left_cols, metric ); \
+   ctx.out = (TYPE*) malloc( ( result_length > 0 ? result_length : 1 ) * sizeof( TYPE ) ); \
+\
+   chunks = distance_partition( left_rows, result_length * left_cols, bounds ); \
+   parallel_run( PAIRWISE_NAME##_rows, &ctx, bounds, chunks ); \
+\
+   result = rb_ary_new2( result_length ); \
+   for ( pos = 0; pos < result_length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( ctx.out[ pos ] ) ); \
+   } \
+\
+   PAIRWISE_NAME##_context_free( &ctx ); \
+   free( ctx.out ); \
+\
+   return result; \
+} \
+\
+/* Heap order: NaN scores rank after every other score, +inf included, */ \
+/* the same way sort and top_k put NaN last. */ \
+static inline int KNN_NAME##_worse( TYPE left, TYPE right ) \
+{ \
+   return ( left > right ) || ( isnan( left ) && !isnan( right ) ); \
+} \
+\
+/* Replace the root (worst entry) of a max-heap and restore heap order. */ \
+static void KNN_NAME##_replace_top( TYPE* heap_scores, int32_t* heap_indices, uint32_t k, TYPE score, int32_t index ) \
+{ \
+   uint32_t parent = 0; \
+   uint32_t child  = 0; \
+\
+   while ( ( child = 2 * parent + 1 ) < k ) \
+   { \
+      if ( ( child + 1 < k ) && KNN_NAME##_worse( heap_scores[ child + 1 ], heap_scores[ child ] ) ) \
+      { \
+         ++child; \
+      } \
+\
+      if ( !KNN_NAME##_worse( heap_scores[ child ], score ) ) \
+      { \
+         break; \
+      } \
+\
+      heap_scores[ parent ]  = heap_scores[ child ]; \
+      heap_indices[ parent ] = heap_indices[ child ]; \
+      parent = child; \
+   } \
+\
+   heap_scores[ parent ]  = score; \
+   heap_indices[ parent ] = index; \
+} \
+\
+/* Add an entry to a max-heap of 'count' entries that has room for it. */ \
+static void KNN_NAME##_push( TYPE* heap_scores, int32_t* heap_indices, uint32_t count, TYPE score, int32_t index ) \
+{ \
+   uint32_t child = count; \
+   uint32_t parent = 0; \
+\
+   while ( child > 0 ) \
+   { \
+      parent = ( child - 1 ) / 2; \
+      if ( !KNN_NAME##_worse( score, heap_scores[ parent ] ) ) \
+      { \
+         break; \
+      } \
+\
+      heap_scores[ child ]  = heap_scores[ parent ]; \
+      heap_indices[ child ] = heap_indices[ parent ]; \
+      child = parent; \
+   } \
+\
+   heap_scores[ child ]  = score; \
+   heap_indices[ child ] = index; \
+} \
+\
+/* Fold a block of scores into a top-k heap holding '*filled' entries. */ \
+/* The first k catalogue rows always enter, so every slot ends up holding */ \
+/* a real row whatever its score. After that, a SIMD compare against the */ \
+/* current worst score rejects most candidates without touching the heap. */ \
+static void KNN_NAME##_select( const TYPE* scores, uint32_t count, int32_t first_index, TYPE* heap_scores, int32_t* heap_indices, uint32_t k, uint32_t* filled ) \
+{ \
+   uint32_t offset = 0; \
+   uint32_t vector_pos = 0; \
+   int mask = 0; \
+   VTYPE threshold_vec; \
+\
+   for ( ; ( offset < count ) && ( *filled < k ); ++offset ) \
+   { \
+      KNN_NAME##_push( heap_scores, heap_indices, ( *filled )++, scores[ offset ], first_index + offset ); \
+   } \
+\
+   /* With a NaN at the root every non-NaN score is better, which the */ \
+   /* ordered compare below cannot express, so such blocks are scanned */ \
+   /* one score at a time. */ \
+   threshold_vec = SET1( heap_scores[ 0 ] ); \
+   for ( ; ( offset + EL_PER_VEC <= count ) && !isnan( heap_scores[ 0 ] ); offset += EL_PER_VEC ) \
+   { \
+      mask = MOVEMASK( CMPLT( LOADU( scores + offset ), threshold_vec ) ); \
+\
+      if ( mask ) \
+      { \
+         for ( vector_pos = 0; vector_pos < EL_PER_VEC; ++vector_pos ) \
+         { \
+            if ( ( mask & ( 1 << vector_pos ) ) && ( scores[ offset + vector_pos ] < heap_scores[ 0 ] ) ) \
+            { \
+               KNN_NAME##_replace_top( heap_scores, heap_indices, k, \
+                  scores[ offset + vector_pos ], first_index + offset + vector_pos ); \
+            } \
+         } \
+\
+         threshold_vec = SET1( heap_scores[ 0 ] ); \
+      } \
+   } \
+\
+   for ( ; offset < count; ++offset ) \
+   { \
+      if ( KNN_NAME##_worse( heap_scores[ 0 ], scores[ offset ] ) ) \
+      { \
+         KNN_NAME##_replace_top( heap_scores, heap_indices, k, scores[ offset ], first_index + offset ); \
+      } \
+   } \
+} \
+\
+/* Heap sort a full max-heap in place into ascending scores, then turn */ \
+/* the scores into distances. */ \
+static void KNN_NAME##_sort( TYPE* heap_scores, int32_t* heap_indices, uint32_t k, int metric ) \
+{ \
+   uint32_t last = 0; \
+   uint32_t pos = 0; \
+   TYPE swap_score = 0; \
+   int32_t swap_index = 0; \
+\
+   for ( last = k - 1; last > 0; --last ) \
+   { \
+      swap_score = heap_scores[ last ]; \
+      swap_index = heap_indices[ last ]; \
+      heap_scores[ last ]  = heap_scores[ 0 ]; \
+      heap_indices[ last ] = heap_indices[ 0 ]; \
+      KNN_NAME##_replace_top( heap_scores, heap_indices, last, swap_score, swap_index ); \
+   } \
+\
+   for ( pos = 0; pos < k; ++pos ) \
+   { \
+      heap_scores[ pos ] = PAIRWISE_NAME##_finish( heap_scores[ pos ], metric ); \
+   } \
+} \
+\
+/* Each block of query rows keeps one top-k heap per row and walks the */ \
+/* catalogue a tile at a time. */ \
+static void KNN_NAME##_rows( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct PAIRWISE_NAME##_context* ctx = (const struct PAIRWISE_NAME##_context*)context; \
+   uint32_t row = 0; \
+   uint32_t row_end = 0; \
+   uint32_t col = 0; \
+   uint32_t col_end = 0; \
+   uint32_t pos = 0; \
+   uint32_t filled[ QUERY_BLOCK ]; \
+   TYPE* scores = (TYPE*) malloc( QUERY_BLOCK * CATALOGUE_BLOCK * sizeof( TYPE ) ); \
+\
+   for ( row = begin; row < end; row = row_end ) \
+   { \
+      row_end = ( end - row > QUERY_BLOCK ) ? row + QUERY_BLOCK : end; \
+      memset( filled, 0, sizeof( filled ) ); \
+\
+      for ( col = 0; col < ctx->right_rows; col = col_end ) \
+      { \
+         col_end = ( ctx->right_rows - col > CATALOGUE_BLOCK ) ? col + CATALOGUE_BLOCK : ctx->right_rows; \
+         PAIRWISE_NAME##_tile( ctx, row, row_end, col, col_end, scores, CATALOGUE_BLOCK ); \
+\
+         for ( pos = row; pos < row_end; ++pos ) \
+         { \
+            KNN_NAME##_select( scores + ( pos - row ) * CATALOGUE_BLOCK, col_end - col, col, \
+               ctx->heap_scores + (uint64_t)pos * ctx->k, ctx->heap_indices + (uint64_t)pos * ctx->k, \
+               ctx->k, filled + ( pos - row ) ); \
+         } \
+      } \
+\
+      for ( pos = row; pos < row_end; ++pos ) \
+      { \
+         KNN_NAME##_sort( ctx->heap_scores + (uint64_t)pos * ctx->k, \
+            ctx->heap_indices + (uint64_t)pos * ctx->k, ctx->k, ctx->metric ); \
+      } \
+   } \
+\
+   free( scores ); \
+} \
+\
+VALUE KNN_NAME( VALUE self, VALUE query, VALUE query_rows_rb, VALUE query_cols_rb, VALUE catalogue, VALUE catalogue_rows_rb, VALUE catalogue_cols_rb, VALUE k_rb, VALUE metric_rb ) \
+{ \
+   struct PAIRWISE_NAME##_context ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t chunks = 0; \
+   uint64_t pos = 0; \
+\
+   uint32_t query_rows     = NUM2UINT( query_rows_rb ); \
+   uint32_t query_cols     = NUM2UINT( query_cols_rb ); \
+   uint32_t catalogue_rows = NUM2UINT( catalogue_rows_rb ); \
+   uint32_t catalogue_cols = NUM2UINT( catalogue_cols_rb ); \
+   uint32_t k              = NUM2UINT( k_rb ); \
+   int      metric         = NUM2INT( metric_rb ); \
+\
+   uint64_t result_length = (uint64_t)query_rows * k; \
+\
+   VALUE indices   = Qnil; \
+   VALUE distances = Qnil; \
+\
+   PAIRWISE_NAME##_check( query, query_rows, query_cols, catalogue, catalogue_rows, catalogue_cols, metric ); \
+\
+   if ( ( k == 0 ) || ( k > catalogue_rows ) ) \
+   { \
+      rb_raise( rb_eArgError, "k must be between 1 and the number of catalogue rows" ); \
+   } \
+\
+   PAIRWISE_NAME##_context_init( &ctx, query, query_rows, catalogue, catalogue_rows, query_cols, metric ); \
+   ctx.out          = NULL; \
+   ctx.k            = k; \
+   ctx.heap_scores  = (TYPE*) malloc( ( result_length > 0 ? result_length : 1 ) * sizeof( TYPE ) ); \
+   ctx.heap_indices = (int32_t*) malloc( ( result_length > 0 ? result_length : 1 ) * sizeof( int32_t ) ); \
+\
+   chunks = distance_partition( query_rows, (uint64_t)query_rows * catalogue_rows * query_cols, bounds ); \
+   parallel_run( KNN_NAME##_rows, &ctx, bounds, chunks ); \
+\
+   indices   = rb_ary_new2( result_length ); \
+   distances = rb_ary_new2( result_length ); \
+   for ( pos = 0; pos < result_length; ++pos ) \
+   { \
+      rb_ary_push( indices, INT2NUM( ctx.heap_indices[ pos ] ) ); \
+      rb_ary_push( distances, DBL2NUM( ctx.heap_scores[ pos ] ) ); \
+   } \
+\
+   PAIRWISE_NAME##_context_free( &ctx ); \
+   free( ctx.heap_scores ); \
+   free( ctx.heap_indices ); \
+\
+   return rb_ary_new3( 2, indices, distances ); \
+}
+
+TEMPLATE_DISTANCE_S(
+   method_pairwise_f32, method_knn_f32,
+   float, 4, __m128,
+   _mm_loadu_ps, _mm_set1_ps,
+   _mm_cmplt_ps, _mm_movemask_ps,
+   gemm_f32_serial );
+TEMPLATE_DISTANCE_S(
+   method_pairwise_f64, method_knn_f64,
+   double, 2, __m128d,
+   _mm_loadu_pd, _mm_set1_pd,
+   _mm_cmplt_pd, _mm_movemask_pd,
+   gemm_f64_serial );
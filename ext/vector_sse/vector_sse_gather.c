@@ -0,0 +1,235 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <emmintrin.h>
+#include "vector_sse_gather.h"
+#include "vector_sse_common.h"
+
+// Rows are prefetched this many indices ahead of the one being copied.
+#define  PREFETCH_DISTANCE   (8)
+
+#define  ROW_OF( DATA, INDICES, POS, WIDTH ) \
+   ( RARRAY_CONST_PTR( DATA ) + (INDICES)[ POS ] * (WIDTH) )
+
+// Native copy of an index array, with negative indices resolved and every
+// index checked against the number of rows.
+static long* native_indices( VALUE indices, long rows )
+{
+   long count = 0;
+   long pos = 0;
+   long index = 0;
+   long* native = NULL;
+
+   Check_Type( indices, T_ARRAY );
+   count = RARRAY_LEN( indices );
+   native = (long*)malloc( ( count + 1 ) * sizeof( long ) );
+
+   for ( pos = 0; pos < count; ++pos )
+   {
+      index = NUM2LONG( rb_ary_entry( indices, pos ) );
+      if ( index < 0 )
+      {
+         index += rows;
+      }
+      if ( ( index < 0 ) || ( index >= rows ) )
+      {
+         free( native );
+         rb_raise( rb_eIndexError, "index %ld out of bounds",
+            NUM2LONG( rb_ary_entry( indices, pos ) ) );
+      }
+      native[ pos ] = index;
+   }
+
+   return native;
+}
+
+static long row_width( VALUE data, VALUE width_rb )
+{
+   long width = NUM2LONG( width_rb );
+
+   Check_Type( data, T_ARRAY );
+
+   if ( ( width < 1 ) || ( RARRAY_LEN( data ) % width != 0 ) )
+   {
+      rb_raise( rb_eArgError, "invalid row width" );
+   }
+
+   return width;
+}
+
+VALUE method_take( VALUE self, VALUE data, VALUE width_rb, VALUE indices )
+{
+   long width = row_width( data, width_rb );
+   long* index_native = native_indices( indices, RARRAY_LEN( data ) / width );
+   long count = RARRAY_LEN( indices );
+   long pos = 0;
+
+   VALUE result = rb_ary_new2( count * width );
+
+   for ( pos = 0; pos < count; ++pos )
+   {
+      if ( pos + PREFETCH_DISTANCE < count )
+      {
+         __builtin_prefetch( ROW_OF( data, index_native, pos + PREFETCH_DISTANCE, width ) );
+      }
+
+      // Rows are contiguous, so each one is appended as a single block.
+      rb_ary_cat( result, ROW_OF( data, index_native, pos, width ), width );
+   }
+
+   free( index_native );
+
+   return result;
+}
+
+VALUE method_put( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values )
+{
+   long width = row_width( data, width_rb );
+   long* index_native = NULL;
+   long count = 0;
+   long pos = 0;
+   long col = 0;
+   VALUE value;
+
+   rb_check_frozen( data );
+   Check_Type( values, T_ARRAY );
+
+   if ( RARRAY_LEN( values ) != RARRAY_LEN( indices ) * width )
+   {
+      rb_raise( rb_eArgError, "value count does not match index count" );
+   }
+
+   for ( pos = 0; pos < RARRAY_LEN( values ); ++pos )
+   {
+      value = rb_ary_entry( values, pos );
+      if ( !RB_INTEGER_TYPE_P( value ) && !RB_FLOAT_TYPE_P( value ) )
+      {
+         rb_raise( rb_eArgError, "expected values of type Integer or Float" );
+      }
+   }
+
+   index_native = native_indices( indices, RARRAY_LEN( data ) / width );
+   count = RARRAY_LEN( indices );
+
+   for ( pos = 0; pos < count; ++pos )
+   {
+      for ( col = 0; col < width; ++col )
+      {
+         rb_ary_store( data, index_native[ pos ] * width + col, rb_ary_entry( values, pos * width + col ) );
+      }
+   }
+
+   free( index_native );
+
+   return data;
+}
+
+
+#define  TEMPLATE_INDEX_ADD( FUNC_NAME, TYPE, CONV_IN, CONV_OUT, EL_PER_VEC, ADD ) \
+VALUE FUNC_NAME( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values ) \
+{ \
+   long width = row_width( data, width_rb ); \
+   long* index_native = NULL; \
+   long count = 0; \
+   long pos = 0; \
+   long col = 0; \
+   long offset = 0; \
+\
+   TYPE* target = NULL; \
+   TYPE* source = NULL; \
+   __m128i result_vec; \
+\
+   rb_check_frozen( data ); \
+   Check_Type( values, T_ARRAY ); \
+\
+   if ( RARRAY_LEN( values ) != RARRAY_LEN( indices ) * width ) \
+   { \
+      rb_raise( rb_eArgError, "value count does not match index count" ); \
+   } \
+\
+   index_native = native_indices( indices, RARRAY_LEN( data ) / width ); \
+   count = RARRAY_LEN( indices ); \
+\
+   target = (TYPE*)malloc( ( width + EL_PER_VEC ) * sizeof( TYPE ) ); \
+   source = (TYPE*)malloc( ( width + EL_PER_VEC ) * sizeof( TYPE ) ); \
+\
+   /* Repeated indices accumulate, since each row is read back from data */ \
+   /* after any earlier update to it. */ \
+   for ( pos = 0; pos < count; ++pos ) \
+   { \
+      offset = index_native[ pos ] * width; \
+\
+      for ( col = 0; col < width; ++col ) \
+      { \
+         target[ col ] = CONV_IN( rb_ary_entry( data, offset + col ) ); \
+         source[ col ] = CONV_IN( rb_ary_entry( values, pos * width + col ) ); \
+      } \
+\
+      for ( col = 0; col + EL_PER_VEC <= width; col += EL_PER_VEC ) \
+      { \
+         result_vec = ADD( _mm_loadu_si128( (__m128i*)( target + col ) ), \
+                           _mm_loadu_si128( (__m128i*)( source + col ) ) ); \
+         _mm_storeu_si128( (__m128i*)( target + col ), result_vec ); \
+      } \
+      for ( ; col < width; ++col ) \
+      { \
+         target[ col ] += source[ col ]; \
+      } \
+\
+      for ( col = 0; col < width; ++col ) \
+      { \
+         rb_ary_store( data, offset + col, CONV_OUT( target[ col ] ) ); \
+      } \
+   } \
+\
+   free( index_native ); \
+   free( target ); \
+   free( source ); \
+\
+   return data; \
+}
+
+static inline __m128i add_s32( const __m128i left, const __m128i right )
+{
+   return _mm_add_epi32( left, right );
+}
+
+static inline __m128i add_s64( const __m128i left, const __m128i right )
+{
+   return _mm_add_epi64( left, right );
+}
+
+TEMPLATE_INDEX_ADD( method_index_add_s32, int32_t, NUM2INT, INT2NUM, 4, add_s32 );
+TEMPLATE_INDEX_ADD( method_index_add_s64, int64_t, NUM2LL, LL2NUM, 2, add_s64 );
+TEMPLATE_INDEX_ADD( method_index_add_f32, float, NUM2DBL, DBL2NUM, 4, add_f32 );
+TEMPLATE_INDEX_ADD( method_index_add_f64, double, NUM2DBL, DBL2NUM, 2, add_f64 );
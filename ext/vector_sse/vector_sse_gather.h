@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_GATHER_H
+#define  VECTOR_SSE_GATHER_H
+
+#include "ruby.h"
+
+// Gather and scatter operate on 'width'-element rows of a flat array:
+// width 1 addresses single elements, and the column count addresses the
+// rows of a matrix. Negative indices count back from the end.
+
+VALUE method_take( VALUE self, VALUE data, VALUE width_rb, VALUE indices );
+VALUE method_put( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values );
+
+VALUE method_index_add_s32( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values );
+VALUE method_index_add_s64( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values );
+VALUE method_index_add_f32( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values );
+VALUE method_index_add_f64( VALUE self, VALUE data, VALUE width_rb, VALUE indices, VALUE values );
+
+#endif // VECTOR_SSE_GATHER_H
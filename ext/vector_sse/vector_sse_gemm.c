@@ -0,0 +1,251 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <emmintrin.h>
+#include "vector_sse_gemm.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_tuning.h"
+
+// Rows of C computed together by the micro-kernel.
+#define  GEMM_KERNEL_ROWS    (4)
+
+
+#define  TEMPLATE_GEMM( NAME, TYPE, EL_PER_VEC, VTYPE, LOADU, STOREU, SETZERO, SET1, ADD, MUL ) \
+struct NAME##_context { \
+   uint32_t    n; \
+   uint32_t    k; \
+   TYPE        alpha; \
+   const TYPE* a; \
+   uint32_t    lda; \
+   const TYPE* b; \
+   uint32_t    ldb; \
+   TYPE*       c; \
+   uint32_t    ldc; \
+}; \
+\
+/* C[0:4, 0:2V] += alpha * A[0:4, 0:k] * B[0:k, 0:2V]. Each B vector is */ \
+/* loaded once per step of k and reused for all four rows. */ \
+static void NAME##_kernel_4( uint32_t k, const TYPE* a, uint32_t lda, const TYPE* b, uint32_t ldb, TYPE* c, uint32_t ldc, VTYPE alpha_vec ) \
+{ \
+   uint32_t common = 0; \
+\
+   VTYPE b0_vec, b1_vec, a_vec; \
+   VTYPE acc00 = SETZERO(), acc01 = SETZERO(); \
+   VTYPE acc10 = SETZERO(), acc11 = SETZERO(); \
+   VTYPE acc20 = SETZERO(), acc21 = SETZERO(); \
+   VTYPE acc30 = SETZERO(), acc31 = SETZERO(); \
+\
+   for ( common = 0; common < k; ++common ) \
+   { \
+      b0_vec = LOADU( b + (uint64_t)common * ldb ); \
+      b1_vec = LOADU( b + (uint64_t)common * ldb + EL_PER_VEC ); \
+\
+      a_vec = SET1( a[ common ] ); \
+      acc00 = ADD( acc00, MUL( a_vec, b0_vec ) ); \
+      acc01 = ADD( acc01, MUL( a_vec, b1_vec ) ); \
+      a_vec = SET1( a[ lda + common ] ); \
+      acc10 = ADD( acc10, MUL( a_vec, b0_vec ) ); \
+      acc11 = ADD( acc11, MUL( a_vec, b1_vec ) ); \
+      a_vec = SET1( a[ 2 * lda + common ] ); \
+      acc20 = ADD( acc20, MUL( a_vec, b0_vec ) ); \
+      acc21 = ADD( acc21, MUL( a_vec, b1_vec ) ); \
+      a_vec = SET1( a[ 3 * lda + common ] ); \
+      acc30 = ADD( acc30, MUL( a_vec, b0_vec ) ); \
+      acc31 = ADD( acc31, MUL( a_vec, b1_vec ) ); \
+   } \
+\
+   STOREU( c, ADD( LOADU( c ), MUL( alpha_vec, acc00 ) ) ); \
+   STOREU( c + EL_PER_VEC, ADD( LOADU( c + EL_PER_VEC ), MUL( alpha_vec, acc01 ) ) ); \
+   c += ldc; \
+   STOREU( c, ADD( LOADU( c ), MUL( alpha_vec, acc10 ) ) ); \
+   STOREU( c + EL_PER_VEC, ADD( LOADU( c + EL_PER_VEC ), MUL( alpha_vec, acc11 ) ) ); \
+   c += ldc; \
+   STOREU( c, ADD( LOADU( c ), MUL( alpha_vec, acc20 ) ) ); \
+   STOREU( c + EL_PER_VEC, ADD( LOADU( c + EL_PER_VEC ), MUL( alpha_vec, acc21 ) ) ); \
+   c += ldc; \
+   STOREU( c, ADD( LOADU( c ), MUL( alpha_vec, acc30 ) ) ); \
+   STOREU( c + EL_PER_VEC, ADD( LOADU( c + EL_PER_VEC ), MUL( alpha_vec, acc31 ) ) ); \
+} \
+\
+/* Single row version of the micro-kernel for the last m % 4 rows. */ \
+static void NAME##_kernel_1( uint32_t k, const TYPE* a, const TYPE* b, uint32_t ldb, TYPE* c, VTYPE alpha_vec ) \
+{ \
+   uint32_t common = 0; \
+\
+   VTYPE a_vec; \
+   VTYPE acc0 = SETZERO(), acc1 = SETZERO(); \
+\
+   for ( common = 0; common < k; ++common ) \
+   { \
+      a_vec = SET1( a[ common ] ); \
+      acc0 = ADD( acc0, MUL( a_vec, LOADU( b + (uint64_t)common * ldb ) ) ); \
+      acc1 = ADD( acc1, MUL( a_vec, LOADU( b + (uint64_t)common * ldb + EL_PER_VEC ) ) ); \
+   } \
+\
+   STOREU( c, ADD( LOADU( c ), MUL( alpha_vec, acc0 ) ) ); \
+   STOREU( c + EL_PER_VEC, ADD( LOADU( c + EL_PER_VEC ), MUL( alpha_vec, acc1 ) ) ); \
+} \
+\
+static void NAME##_rows( void* arg, uint32_t begin, uint32_t end ) \
+{ \
+   struct NAME##_context* ctx = (struct NAME##_context*)arg; \
+   VTYPE alpha_vec = SET1( ctx->alpha ); \
+   /* The common dimension and the columns of B are processed in blocks */ \
+   /* so that the active part of B stays in cache. */ \
+   uint32_t block_k = vector_sse_tuning.NAME##_block_k; \
+   uint32_t block_n = vector_sse_tuning.NAME##_block_n; \
+   uint32_t k0 = 0, kb = 0; \
+   uint32_t n0 = 0, nb = 0; \
+   uint32_t row = 0, col = 0, common = 0; \
+   uint32_t vec_cols = 0; \
+   const TYPE* a = NULL; \
+   const TYPE* b = NULL; \
+   TYPE* c = NULL; \
+   TYPE sum = 0; \
+\
+   for ( k0 = 0; k0 < ctx->k; k0 += block_k ) \
+   { \
+      kb = ( ctx->k - k0 < block_k ) ? ctx->k - k0 : block_k; \
+\
+      for ( n0 = 0; n0 < ctx->n; n0 += block_n ) \
+      { \
+         nb = ( ctx->n - n0 < block_n ) ? ctx->n - n0 : block_n; \
+         vec_cols = nb - nb % ( 2 * EL_PER_VEC ); \
+         b = ctx->b + (uint64_t)k0 * ctx->ldb + n0; \
+\
+         for ( row = begin; row < end; ) \
+         { \
+            a = ctx->a + (uint64_t)row * ctx->lda + k0; \
+            c = ctx->c + (uint64_t)row * ctx->ldc + n0; \
+\
+            if ( row + GEMM_KERNEL_ROWS <= end ) \
+            { \
+               for ( col = 0; col < vec_cols; col += 2 * EL_PER_VEC ) \
+               { \
+                  NAME##_kernel_4( kb, a, ctx->lda, b + col, ctx->ldb, c + col, ctx->ldc, alpha_vec ); \
+               } \
+               row += GEMM_KERNEL_ROWS; \
+            } \
+            else \
+            { \
+               for ( col = 0; col < vec_cols; col += 2 * EL_PER_VEC ) \
+               { \
+                  NAME##_kernel_1( kb, a, b + col, ctx->ldb, c + col, alpha_vec ); \
+               } \
+               row += 1; \
+            } \
+         } \
+\
+         /* Columns that do not fill a pair of vectors. */ \
+         for ( row = begin; row < end; ++row ) \
+         { \
+            a = ctx->a + (uint64_t)row * ctx->lda + k0; \
+            c = ctx->c + (uint64_t)row * ctx->ldc + n0; \
+\
+            for ( col = vec_cols; col < nb; ++col ) \
+            { \
+               sum = 0; \
+               for ( common = 0; common < kb; ++common ) \
+               { \
+                  sum += a[ common ] * b[ (uint64_t)common * ctx->ldb + col ]; \
+               } \
+               c[ col ] += ctx->alpha * sum; \
+            } \
+         } \
+      } \
+   } \
+} \
+\
+static void NAME##_context_init( struct NAME##_context* ctx, uint32_t n, uint32_t k, TYPE alpha, \
+   const TYPE* a, uint32_t lda, const TYPE* b, uint32_t ldb, TYPE* c, uint32_t ldc ) \
+{ \
+   ctx->n = n; ctx->k = k; ctx->alpha = alpha; \
+   ctx->a = a; ctx->lda = lda; \
+   ctx->b = b; ctx->ldb = ldb; \
+   ctx->c = c; ctx->ldc = ldc; \
+} \
+\
+void NAME##_serial( uint32_t m, uint32_t n, uint32_t k, TYPE alpha, \
+   const TYPE* a, uint32_t lda, const TYPE* b, uint32_t ldb, TYPE* c, uint32_t ldc ) \
+{ \
+   struct NAME##_context ctx; \
+\
+   if ( ( m == 0 ) || ( n == 0 ) || ( k == 0 ) ) \
+   { \
+      return; \
+   } \
+\
+   NAME##_context_init( &ctx, n, k, alpha, a, lda, b, ldb, c, ldc ); \
+   NAME##_rows( &ctx, 0, m ); \
+} \
+\
+void NAME( uint32_t m, uint32_t n, uint32_t k, TYPE alpha, \
+   const TYPE* a, uint32_t lda, const TYPE* b, uint32_t ldb, TYPE* c, uint32_t ldc ) \
+{ \
+   struct NAME##_context ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint64_t work = (uint64_t)m * n * k; \
+   uint64_t work_per_thread = vector_sse_tuning.gemm_work_per_thread; \
+   uint32_t chunks = parallel_thread_count(); \
+   uint32_t chunk = 0; \
+   uint32_t blocks = ( m + GEMM_KERNEL_ROWS - 1 ) / GEMM_KERNEL_ROWS; \
+\
+   if ( ( m == 0 ) || ( n == 0 ) || ( k == 0 ) ) \
+   { \
+      return; \
+   } \
+\
+   NAME##_context_init( &ctx, n, k, alpha, a, lda, b, ldb, c, ldc ); \
+\
+   /* Split the rows of C evenly, in whole micro-kernel blocks. */ \
+   if ( work / work_per_thread < chunks ) \
+   { \
+      chunks = ( work / work_per_thread > 0 ) ? (uint32_t)( work / work_per_thread ) : 1; \
+   } \
+   if ( chunks > blocks ) \
+   { \
+      chunks = blocks; \
+   } \
+\
+   for ( chunk = 0; chunk < chunks; ++chunk ) \
+   { \
+      bounds[ chunk ] = (uint32_t)( ( (uint64_t)blocks * chunk / chunks ) * GEMM_KERNEL_ROWS ); \
+   } \
+   bounds[ chunks ] = m; \
+\
+   parallel_run( NAME##_rows, &ctx, bounds, chunks ); \
+}
+
+TEMPLATE_GEMM( gemm_f32, float, 4, __m128,
+   _mm_loadu_ps, _mm_storeu_ps, _mm_setzero_ps, _mm_set1_ps, _mm_add_ps, _mm_mul_ps );
+TEMPLATE_GEMM( gemm_f64, double, 2, __m128d,
+   _mm_loadu_pd, _mm_storeu_pd, _mm_setzero_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd );
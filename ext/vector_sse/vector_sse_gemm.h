@@ -0,0 +1,53 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_GEMM_H
+#define  VECTOR_SSE_GEMM_H
+
+#include <stdint.h>
+
+// C += alpha * A * B on native row-major matrices, where A is m x k, B is
+// k x n and C is m x n. Each matrix has its own row stride so that the
+// operands may be blocks of larger matrices. C must not overlap A or B.
+void gemm_f32( uint32_t m, uint32_t n, uint32_t k, float alpha,
+   const float* a, uint32_t lda, const float* b, uint32_t ldb, float* c, uint32_t ldc );
+void gemm_f64( uint32_t m, uint32_t n, uint32_t k, double alpha,
+   const double* a, uint32_t lda, const double* b, uint32_t ldb, double* c, uint32_t ldc );
+
+// As above, but always on the calling thread, for kernels that split their
+// own work across threads and call the GEMM from each of them.
+void gemm_f32_serial( uint32_t m, uint32_t n, uint32_t k, float alpha,
+   const float* a, uint32_t lda, const float* b, uint32_t ldb, float* c, uint32_t ldc );
+void gemm_f64_serial( uint32_t m, uint32_t n, uint32_t k, double alpha,
+   const double* a, uint32_t lda, const double* b, uint32_t ldb, double* c, uint32_t ldc );
+
+#endif // VECTOR_SSE_GEMM_H
@@ -0,0 +1,474 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <math.h>
+#include <smmintrin.h>
+#include "vector_sse_histogram.h"
+#include "vector_sse_parallel.h"
+
+// Minimum number of values each thread bins.
+#define  HISTOGRAM_WORK_PER_THREAD   (1 << 16)
+
+// Each of the four SIMD lanes counts into its own sub-histogram, so that
+// neighbouring values landing in the same bin do not serialize on one
+// counter. Beyond this many bins the copies cost more cache than they
+// save, and all lanes share one histogram.
+#define  HISTOGRAM_LANES             (4)
+#define  HISTOGRAM_LANE_BINS         (1 << 12)
+
+struct histogram_context {
+   const double*   values;
+   uint32_t        count;
+   const uint32_t* bounds;
+   uint32_t        chunks;
+   uint32_t        bins;
+   uint32_t        lanes;
+
+   // Private sub-histograms: chunks x lanes x bins counters.
+   uint64_t*       counts;
+
+   // Uniform bins.
+   double          low;
+   double          high;
+   double          scale;
+
+   // Explicit edges, padded with NaN to twice the largest search step.
+   const double*   edges;
+   uint32_t        edge_count;
+   uint32_t        search_step;
+
+   // Digitize output.
+   uint32_t*       positions;
+};
+
+// Native copy of the values as doubles. 'release' is freed before raising,
+// for callers that already hold another buffer.
+static double* native_values( VALUE data, void* release )
+{
+   long count = 0;
+   long pos = 0;
+   VALUE value;
+   double* native = NULL;
+
+   Check_Type( data, T_ARRAY );
+   count = RARRAY_LEN( data );
+
+   if ( count > UINT32_MAX )
+   {
+      free( release );
+      rb_raise( rb_eArgError, "array is too large to bin" );
+   }
+
+   native = (double*)malloc( ( count + 1 ) * sizeof( double ) );
+
+   for ( pos = 0; pos < count; ++pos )
+   {
+      value = rb_ary_entry( data, pos );
+      if ( !RB_INTEGER_TYPE_P( value ) && !RB_FLOAT_TYPE_P( value ) )
+      {
+         free( native );
+         free( release );
+         rb_raise( rb_eArgError, "expected values of type Integer or Float" );
+      }
+      native[ pos ] = NUM2DBL( value );
+   }
+
+   return native;
+}
+
+// Native copy of the bin edges, padded with NaN so the branchless search
+// below never needs a bounds check: NaN compares false against any value.
+static double* native_edges( VALUE edges, uint32_t* edge_count, uint32_t* search_step )
+{
+   long count = 0;
+   long pos = 0;
+   uint32_t step = 1;
+   double* native = NULL;
+
+   Check_Type( edges, T_ARRAY );
+   count = RARRAY_LEN( edges );
+
+   if ( ( count < 1 ) || ( count > INT32_MAX ) )
+   {
+      rb_raise( rb_eArgError, "invalid number of bin edges" );
+   }
+
+   while ( step * 2 <= count )
+   {
+      step *= 2;
+   }
+
+   native = native_values( edges, NULL );
+   native = (double*)realloc( native, 2 * step * sizeof( double ) );
+
+   for ( pos = 1; pos < count; ++pos )
+   {
+      // Written so that NaN edges also fail.
+      if ( !( native[ pos - 1 ] <= native[ pos ] ) )
+      {
+         free( native );
+         rb_raise( rb_eArgError, "bin edges must be non-decreasing" );
+      }
+   }
+   for ( pos = count; pos < 2 * step; ++pos )
+   {
+      native[ pos ] = NAN;
+   }
+
+   *edge_count = (uint32_t)count;
+   *search_step = step;
+
+   return native;
+}
+
+// Loads four values starting at 'pos', padding past 'end' with NaN.
+static inline void load_values4( const double* values, uint32_t pos, uint32_t end, __m128d* low, __m128d* high )
+{
+   double padded[ 4 ] = { NAN, NAN, NAN, NAN };
+   uint32_t lane = 0;
+
+   if ( pos + 4 <= end )
+   {
+      *low = _mm_loadu_pd( values + pos );
+      *high = _mm_loadu_pd( values + pos + 2 );
+      return;
+   }
+
+   for ( lane = 0; pos + lane < end; ++lane )
+   {
+      padded[ lane ] = values[ pos + lane ];
+   }
+
+   *low = _mm_loadu_pd( padded );
+   *high = _mm_loadu_pd( padded + 2 );
+}
+
+// Bin index of four values by multiply-and-convert. Sets bit i of 'valid'
+// when value i lies within [low, high].
+static inline __m128i uniform_bin4( const struct histogram_context* ctx, __m128d values_lo, __m128d values_hi, int* valid )
+{
+   __m128d low = _mm_set1_pd( ctx->low );
+   __m128d high = _mm_set1_pd( ctx->high );
+   __m128d scale = _mm_set1_pd( ctx->scale );
+   __m128d in_lo = _mm_and_pd( _mm_cmpge_pd( values_lo, low ), _mm_cmple_pd( values_lo, high ) );
+   __m128d in_hi = _mm_and_pd( _mm_cmpge_pd( values_hi, low ), _mm_cmple_pd( values_hi, high ) );
+   __m128i bin_lo = _mm_cvttpd_epi32( _mm_mul_pd( _mm_sub_pd( values_lo, low ), scale ) );
+   __m128i bin_hi = _mm_cvttpd_epi32( _mm_mul_pd( _mm_sub_pd( values_hi, low ), scale ) );
+
+   *valid = _mm_movemask_pd( in_lo ) | ( _mm_movemask_pd( in_hi ) << 2 );
+
+   // The right edge, and rounding just below it, land in the last bin.
+   return _mm_min_epi32( _mm_unpacklo_epi64( bin_lo, bin_hi ),
+                         _mm_set1_epi32( ctx->bins - 1 ) );
+}
+
+// Number of edges less than or equal to each of four values: a binary
+// search run on all four lanes at once, one gathered edge per lane a step.
+static inline __m128i edge_search4( const struct histogram_context* ctx, __m128d values_lo, __m128d values_hi )
+{
+   const double* edges = ctx->edges;
+   uint32_t step = ctx->search_step;
+   uint32_t lane[ 4 ];
+   __m128i pos = _mm_setzero_si128();
+   __m128d edge_lo;
+   __m128d edge_hi;
+   __m128 take;
+
+   for ( ; step > 0; step >>= 1 )
+   {
+      _mm_storeu_si128( (__m128i*)lane, pos );
+
+      edge_lo = _mm_set_pd( edges[ lane[ 1 ] + step - 1 ], edges[ lane[ 0 ] + step - 1 ] );
+      edge_hi = _mm_set_pd( edges[ lane[ 3 ] + step - 1 ], edges[ lane[ 2 ] + step - 1 ] );
+
+      // Narrow the two 64-bit lane masks to four 32-bit ones.
+      take = _mm_shuffle_ps( _mm_castpd_ps( _mm_cmple_pd( edge_lo, values_lo ) ),
+                             _mm_castpd_ps( _mm_cmple_pd( edge_hi, values_hi ) ),
+                             _MM_SHUFFLE( 2, 0, 2, 0 ) );
+
+      pos = _mm_add_epi32( pos, _mm_and_si128( _mm_castps_si128( take ), _mm_set1_epi32( step ) ) );
+   }
+
+   return pos;
+}
+
+// The private sub-histograms of the chunk starting at 'begin', with
+// the offset of each lane's copy written to 'lane_offset'.
+static uint64_t* chunk_counts( const struct histogram_context* ctx, uint32_t begin, uint32_t* lane_offset )
+{
+   uint32_t chunk = 0;
+   uint32_t lane = 0;
+
+   while ( ctx->bounds[ chunk ] != begin )
+   {
+      ++chunk;
+   }
+
+   for ( lane = 0; lane < HISTOGRAM_LANES; ++lane )
+   {
+      lane_offset[ lane ] = ( ctx->lanes == HISTOGRAM_LANES ) ? lane * ctx->bins : 0;
+   }
+
+   return ctx->counts + (uint64_t)chunk * ctx->lanes * ctx->bins;
+}
+
+static void histogram_uniform_rows( void* context, uint32_t begin, uint32_t end )
+{
+   const struct histogram_context* ctx = (const struct histogram_context*)context;
+   uint32_t lane_offset[ HISTOGRAM_LANES ];
+   uint64_t* counts = chunk_counts( ctx, begin, lane_offset );
+   uint32_t bin[ 4 ];
+   uint32_t pos = 0;
+   uint32_t lane = 0;
+   int valid = 0;
+   __m128d values_lo;
+   __m128d values_hi;
+
+   for ( pos = begin; pos < end; pos += 4 )
+   {
+      load_values4( ctx->values, pos, end, &values_lo, &values_hi );
+      _mm_storeu_si128( (__m128i*)bin, uniform_bin4( ctx, values_lo, values_hi, &valid ) );
+
+      for ( lane = 0; lane < 4; ++lane )
+      {
+         if ( valid & ( 1 << lane ) )
+         {
+            counts[ lane_offset[ lane ] + bin[ lane ] ]++;
+         }
+      }
+   }
+}
+
+static void histogram_edges_rows( void* context, uint32_t begin, uint32_t end )
+{
+   const struct histogram_context* ctx = (const struct histogram_context*)context;
+   uint32_t lane_offset[ HISTOGRAM_LANES ];
+   uint64_t* counts = chunk_counts( ctx, begin, lane_offset );
+   uint32_t last = ctx->edge_count - 1;
+   uint32_t found[ 4 ];
+   double value[ 4 ];
+   uint32_t pos = 0;
+   uint32_t lane = 0;
+   __m128d values_lo;
+   __m128d values_hi;
+
+   for ( pos = begin; pos < end; pos += 4 )
+   {
+      load_values4( ctx->values, pos, end, &values_lo, &values_hi );
+      _mm_storeu_si128( (__m128i*)found, edge_search4( ctx, values_lo, values_hi ) );
+      _mm_storeu_pd( value, values_lo );
+      _mm_storeu_pd( value + 2, values_hi );
+
+      for ( lane = 0; lane < 4; ++lane )
+      {
+         if ( ( found[ lane ] >= 1 ) && ( found[ lane ] <= last ) )
+         {
+            counts[ lane_offset[ lane ] + found[ lane ] - 1 ]++;
+         }
+         else if ( ( found[ lane ] > last ) && ( value[ lane ] == ctx->edges[ last ] ) )
+         {
+            counts[ lane_offset[ lane ] + last - 1 ]++;
+         }
+      }
+   }
+}
+
+static void digitize_rows( void* context, uint32_t begin, uint32_t end )
+{
+   const struct histogram_context* ctx = (const struct histogram_context*)context;
+   uint32_t found[ 4 ];
+   uint32_t pos = 0;
+   uint32_t lane = 0;
+   __m128d values_lo;
+   __m128d values_hi;
+
+   for ( pos = begin; pos < end; pos += 4 )
+   {
+      load_values4( ctx->values, pos, end, &values_lo, &values_hi );
+      _mm_storeu_si128( (__m128i*)found, edge_search4( ctx, values_lo, values_hi ) );
+
+      for ( lane = 0; ( lane < 4 ) && ( pos + lane < end ); ++lane )
+      {
+         ctx->positions[ pos + lane ] = found[ lane ];
+      }
+   }
+}
+
+// Splits the values into equal chunks. Each chunk owns 'private_bins'
+// counters, so small inputs with many bins stay on one thread rather than
+// spending more time clearing and merging counters than binning.
+static void partition_values( struct histogram_context* ctx, uint32_t* bounds, uint64_t private_bins )
+{
+   uint64_t per_thread = ( private_bins > HISTOGRAM_WORK_PER_THREAD ) ? private_bins : HISTOGRAM_WORK_PER_THREAD;
+   uint64_t chunks = ctx->count / per_thread;
+   uint32_t threads = parallel_thread_count();
+   uint32_t chunk = 0;
+
+   if ( chunks < 1 )
+   {
+      chunks = 1;
+   }
+   if ( chunks > threads )
+   {
+      chunks = threads;
+   }
+
+   ctx->chunks = (uint32_t)chunks;
+   ctx->bounds = bounds;
+
+   for ( chunk = 0; chunk <= ctx->chunks; ++chunk )
+   {
+      bounds[ chunk ] = (uint32_t)( (uint64_t)ctx->count * chunk / ctx->chunks );
+   }
+}
+
+// Bins the values with 'task' into private sub-histograms and returns
+// their sum.
+static VALUE histogram_run( struct histogram_context* ctx, parallel_task task )
+{
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ];
+   uint64_t copies = 0;
+   uint64_t total = 0;
+   uint32_t bin = 0;
+   uint64_t copy = 0;
+   VALUE result;
+
+   ctx->lanes = ( ctx->bins <= HISTOGRAM_LANE_BINS ) ? HISTOGRAM_LANES : 1;
+   partition_values( ctx, bounds, (uint64_t)ctx->lanes * ctx->bins );
+
+   copies = (uint64_t)ctx->chunks * ctx->lanes;
+   ctx->counts = (uint64_t*)calloc( copies * ctx->bins, sizeof( uint64_t ) );
+
+   parallel_run( task, ctx, bounds, ctx->chunks );
+
+   result = rb_ary_new2( ctx->bins );
+
+   for ( bin = 0; bin < ctx->bins; ++bin )
+   {
+      total = 0;
+      for ( copy = 0; copy < copies; ++copy )
+      {
+         total += ctx->counts[ copy * ctx->bins + bin ];
+      }
+      rb_ary_push( result, ULL2NUM( total ) );
+   }
+
+   free( ctx->counts );
+
+   return result;
+}
+
+VALUE method_histogram( VALUE self, VALUE data, VALUE bins_rb, VALUE low_rb, VALUE high_rb )
+{
+   struct histogram_context ctx;
+   long bins = NUM2LONG( bins_rb );
+   VALUE result;
+
+   ctx.low = NUM2DBL( low_rb );
+   ctx.high = NUM2DBL( high_rb );
+
+   if ( ( bins < 1 ) || ( bins > INT32_MAX ) )
+   {
+      rb_raise( rb_eArgError, "invalid bin count" );
+   }
+   if ( !isfinite( ctx.low ) || !isfinite( ctx.high ) || !( ctx.low < ctx.high ) )
+   {
+      rb_raise( rb_eArgError, "invalid histogram range" );
+   }
+
+   ctx.bins = (uint32_t)bins;
+   ctx.scale = bins / ( ctx.high - ctx.low );
+   ctx.values = native_values( data, NULL );
+   ctx.count = (uint32_t)RARRAY_LEN( data );
+
+   result = histogram_run( &ctx, histogram_uniform_rows );
+
+   free( (double*)ctx.values );
+
+   return result;
+}
+
+VALUE method_histogram_edges( VALUE self, VALUE data, VALUE edges )
+{
+   struct histogram_context ctx;
+   double* edges_native = native_edges( edges, &ctx.edge_count, &ctx.search_step );
+   VALUE result;
+
+   if ( ctx.edge_count < 2 )
+   {
+      free( edges_native );
+      rb_raise( rb_eArgError, "invalid number of bin edges" );
+   }
+
+   ctx.edges = edges_native;
+   ctx.bins = ctx.edge_count - 1;
+   ctx.values = native_values( data, edges_native );
+   ctx.count = (uint32_t)RARRAY_LEN( data );
+
+   result = histogram_run( &ctx, histogram_edges_rows );
+
+   free( (double*)ctx.values );
+   free( edges_native );
+
+   return result;
+}
+
+VALUE method_digitize( VALUE self, VALUE data, VALUE edges )
+{
+   struct histogram_context ctx;
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ];
+   double* edges_native = native_edges( edges, &ctx.edge_count, &ctx.search_step );
+   uint32_t pos = 0;
+   VALUE result;
+
+   ctx.edges = edges_native;
+   ctx.values = native_values( data, edges_native );
+   ctx.count = (uint32_t)RARRAY_LEN( data );
+   ctx.positions = (uint32_t*)malloc( ( ctx.count + 1 ) * sizeof( uint32_t ) );
+
+   partition_values( &ctx, bounds, 0 );
+   parallel_run( digitize_rows, &ctx, bounds, ctx.chunks );
+
+   result = rb_ary_new2( ctx.count );
+
+   for ( pos = 0; pos < ctx.count; ++pos )
+   {
+      rb_ary_push( result, UINT2NUM( ctx.positions[ pos ] ) );
+   }
+
+   free( ctx.positions );
+   free( (double*)ctx.values );
+   free( edges_native );
+
+   return result;
+}
@@ -0,0 +1,452 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <emmintrin.h>
+#include "vector_sse_linalg.h"
+#include "vector_sse_gemm.h"
+
+// Columns factored per panel. Everything to the right of and below a panel
+// is updated with a single GEMM call.
+#define  LINALG_BLOCK    (64)
+
+
+#define  TEMPLATE_LINALG_S( SUFFIX, TYPE, EL_PER_VEC, VTYPE, LOADU, STOREU, SETZERO, SET1, ADD, SUB, MUL, GEMM ) \
+/* y -= scale * x */ \
+static inline void row_update_##SUFFIX( TYPE* y, const TYPE* x, TYPE scale, uint32_t length ) \
+{ \
+   uint32_t pos = 0; \
+   VTYPE scale_vec = SET1( scale ); \
+\
+   for ( pos = 0; pos + EL_PER_VEC <= length; pos += EL_PER_VEC ) \
+   { \
+      STOREU( y + pos, SUB( LOADU( y + pos ), MUL( scale_vec, LOADU( x + pos ) ) ) ); \
+   } \
+   for ( ; pos < length; ++pos ) \
+   { \
+      y[ pos ] -= scale * x[ pos ]; \
+   } \
+} \
+\
+static inline void row_scale_##SUFFIX( TYPE* y, TYPE scale, uint32_t length ) \
+{ \
+   uint32_t pos = 0; \
+   VTYPE scale_vec = SET1( scale ); \
+\
+   for ( pos = 0; pos + EL_PER_VEC <= length; pos += EL_PER_VEC ) \
+   { \
+      STOREU( y + pos, MUL( scale_vec, LOADU( y + pos ) ) ); \
+   } \
+   for ( ; pos < length; ++pos ) \
+   { \
+      y[ pos ] *= scale; \
+   } \
+} \
+\
+static inline TYPE dot_##SUFFIX( const TYPE* left, const TYPE* right, uint32_t length ) \
+{ \
+   uint32_t pos = 0; \
+   TYPE lanes[ EL_PER_VEC ]; \
+   TYPE sum = 0; \
+   VTYPE acc_vec = SETZERO(); \
+\
+   for ( pos = 0; pos + EL_PER_VEC <= length; pos += EL_PER_VEC ) \
+   { \
+      acc_vec = ADD( acc_vec, MUL( LOADU( left + pos ), LOADU( right + pos ) ) ); \
+   } \
+\
+   STOREU( lanes, acc_vec ); \
+   for ( pos = 0; pos < EL_PER_VEC; ++pos ) \
+   { \
+      sum += lanes[ pos ]; \
+   } \
+   for ( pos = length - length % EL_PER_VEC; pos < length; ++pos ) \
+   { \
+      sum += left[ pos ] * right[ pos ]; \
+   } \
+\
+   return sum; \
+} \
+\
+static TYPE* native_##SUFFIX( VALUE data, uint64_t length ) \
+{ \
+   uint64_t pos = 0; \
+   TYPE* native = NULL; \
+\
+   Check_Type( data, T_ARRAY ); \
+   if ( (uint64_t)RARRAY_LEN( data ) != length ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   native = (TYPE*)malloc( ( length + 1 ) * sizeof( TYPE ) ); \
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      native[ pos ] = (TYPE)NUM2DBL( rb_ary_entry( data, pos ) ); \
+   } \
+\
+   return native; \
+} \
+\
+static VALUE ruby_##SUFFIX( const TYPE* native, uint64_t length ) \
+{ \
+   uint64_t pos = 0; \
+   VALUE result = rb_ary_new2( length ); \
+\
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( native[ pos ] ) ); \
+   } \
+\
+   return result; \
+} \
+\
+/* Blocked right-looking LU with partial pivoting, in place. Returns the */ \
+/* permutation parity, or 0 if a pivot is exactly zero. */ \
+static int lu_factor_##SUFFIX( TYPE* a, uint32_t n, uint32_t* permutation ) \
+{ \
+   uint32_t k0 = 0, kend = 0; \
+   uint32_t row = 0, col = 0, pivot = 0; \
+   uint32_t swap = 0; \
+   int sign = 1; \
+   int singular = 0; \
+   TYPE largest = 0; \
+   TYPE* scratch = (TYPE*)malloc( n * sizeof( TYPE ) ); \
+\
+   for ( row = 0; row < n; ++row ) \
+   { \
+      permutation[ row ] = row; \
+   } \
+\
+   for ( k0 = 0; k0 < n; k0 += LINALG_BLOCK ) \
+   { \
+      kend = ( n - k0 < LINALG_BLOCK ) ? n : k0 + LINALG_BLOCK; \
+\
+      /* Factor the panel of columns [k0, kend) below the diagonal. */ \
+      for ( col = k0; col < kend; ++col ) \
+      { \
+         pivot = col; \
+         largest = fabs( a[ (uint64_t)col * n + col ] ); \
+         for ( row = col + 1; row < n; ++row ) \
+         { \
+            if ( fabs( a[ (uint64_t)row * n + col ] ) > largest ) \
+            { \
+               largest = fabs( a[ (uint64_t)row * n + col ] ); \
+               pivot = row; \
+            } \
+         } \
+\
+         if ( pivot != col ) \
+         { \
+            memcpy( scratch, a + (uint64_t)col * n, n * sizeof( TYPE ) ); \
+            memcpy( a + (uint64_t)col * n, a + (uint64_t)pivot * n, n * sizeof( TYPE ) ); \
+            memcpy( a + (uint64_t)pivot * n, scratch, n * sizeof( TYPE ) ); \
+            swap = permutation[ col ]; \
+            permutation[ col ] = permutation[ pivot ]; \
+            permutation[ pivot ] = swap; \
+            sign = -sign; \
+         } \
+\
+         if ( a[ (uint64_t)col * n + col ] == 0 ) \
+         { \
+            singular = 1; \
+            continue; \
+         } \
+\
+         for ( row = col + 1; row < n; ++row ) \
+         { \
+            a[ (uint64_t)row * n + col ] /= a[ (uint64_t)col * n + col ]; \
+            row_update_##SUFFIX( a + (uint64_t)row * n + col + 1, a + (uint64_t)col * n + col + 1, \
+               a[ (uint64_t)row * n + col ], kend - col - 1 ); \
+         } \
+      } \
+\
+      /* U12 = L11^-1 * A12 */ \
+      for ( col = k0; col < kend; ++col ) \
+      { \
+         for ( row = col + 1; row < kend; ++row ) \
+         { \
+            row_update_##SUFFIX( a + (uint64_t)row * n + kend, a + (uint64_t)col * n + kend, \
+               a[ (uint64_t)row * n + col ], n - kend ); \
+         } \
+      } \
+\
+      /* A22 -= L21 * U12 */ \
+      GEMM( n - kend, n - kend, kend - k0, -1, \
+         a + (uint64_t)kend * n + k0, n, a + (uint64_t)k0 * n + kend, n, a + (uint64_t)kend * n + kend, n ); \
+   } \
+\
+   free( scratch ); \
+\
+   return singular ? 0 : sign; \
+} \
+\
+/* Solves L*U*X = B in place for the n x nrhs matrix X (initially B), */ \
+/* with both triangular solves blocked around GEMM updates. */ \
+static void lu_substitute_##SUFFIX( const TYPE* lu, uint32_t n, TYPE* x, uint32_t nrhs ) \
+{ \
+   uint32_t k0 = 0, kend = 0; \
+   uint32_t row = 0, col = 0; \
+\
+   for ( k0 = 0; k0 < n; k0 += LINALG_BLOCK ) \
+   { \
+      kend = ( n - k0 < LINALG_BLOCK ) ? n : k0 + LINALG_BLOCK; \
+\
+      for ( col = k0; col < kend; ++col ) \
+      { \
+         for ( row = col + 1; row < kend; ++row ) \
+         { \
+            row_update_##SUFFIX( x + (uint64_t)row * nrhs, x + (uint64_t)col * nrhs, \
+               lu[ (uint64_t)row * n + col ], nrhs ); \
+         } \
+      } \
+\
+      GEMM( n - kend, nrhs, kend - k0, -1, \
+         lu + (uint64_t)kend * n + k0, n, x + (uint64_t)k0 * nrhs, nrhs, x + (uint64_t)kend * nrhs, nrhs ); \
+   } \
+\
+   for ( kend = n; kend > 0; kend = k0 ) \
+   { \
+      k0 = ( ( kend - 1 ) / LINALG_BLOCK ) * LINALG_BLOCK; \
+\
+      for ( col = kend; col-- > k0; ) \
+      { \
+         row_scale_##SUFFIX( x + (uint64_t)col * nrhs, 1 / lu[ (uint64_t)col * n + col ], nrhs ); \
+         for ( row = k0; row < col; ++row ) \
+         { \
+            row_update_##SUFFIX( x + (uint64_t)row * nrhs, x + (uint64_t)col * nrhs, \
+               lu[ (uint64_t)row * n + col ], nrhs ); \
+         } \
+      } \
+\
+      GEMM( k0, nrhs, kend - k0, -1, \
+         lu + k0, n, x + (uint64_t)k0 * nrhs, nrhs, x, nrhs ); \
+   } \
+} \
+\
+VALUE method_lu_##SUFFIX( VALUE self, VALUE data, VALUE n_rb ) \
+{ \
+   uint32_t n = NUM2UINT( n_rb ); \
+   uint32_t row = 0; \
+   int sign = 0; \
+\
+   TYPE* a = native_##SUFFIX( data, (uint64_t)n * n ); \
+   uint32_t* permutation = (uint32_t*)malloc( ( n + 1 ) * sizeof( uint32_t ) ); \
+   VALUE factors = Qnil; \
+   VALUE rows = Qnil; \
+\
+   sign = lu_factor_##SUFFIX( a, n, permutation ); \
+\
+   factors = ruby_##SUFFIX( a, (uint64_t)n * n ); \
+   rows = rb_ary_new2( n ); \
+   for ( row = 0; row < n; ++row ) \
+   { \
+      rb_ary_push( rows, UINT2NUM( permutation[ row ] ) ); \
+   } \
+\
+   /* A singular matrix still has an LU factorization; its parity only */ \
+   /* matters for the determinant, which is zero either way. */ \
+   if ( sign == 0 ) \
+   { \
+      sign = 1; \
+   } \
+\
+   free( a ); \
+   free( permutation ); \
+\
+   return rb_ary_new3( 3, factors, rows, INT2NUM( sign ) ); \
+} \
+\
+/* Factors A and solves for the n x nrhs right-hand side 'b', which is */ \
+/* consumed. Returns the solution or raises if A is singular. */ \
+static VALUE solve_native_##SUFFIX( TYPE* a, uint32_t n, TYPE* b, uint32_t nrhs ) \
+{ \
+   uint32_t row = 0; \
+   int sign = 0; \
+\
+   uint32_t* permutation = (uint32_t*)malloc( ( n + 1 ) * sizeof( uint32_t ) ); \
+   TYPE* x = (TYPE*)malloc( ( (uint64_t)n * nrhs + 1 ) * sizeof( TYPE ) ); \
+   VALUE result = Qnil; \
+\
+   sign = lu_factor_##SUFFIX( a, n, permutation ); \
+\
+   if ( sign != 0 ) \
+   { \
+      for ( row = 0; row < n; ++row ) \
+      { \
+         memcpy( x + (uint64_t)row * nrhs, b + (uint64_t)permutation[ row ] * nrhs, nrhs * sizeof( TYPE ) ); \
+      } \
+      lu_substitute_##SUFFIX( a, n, x, nrhs ); \
+      result = ruby_##SUFFIX( x, (uint64_t)n * nrhs ); \
+   } \
+\
+   free( a ); \
+   free( b ); \
+   free( x ); \
+   free( permutation ); \
+\
+   if ( sign == 0 ) \
+   { \
+      rb_raise( rb_eRuntimeError, "matrix is singular" ); \
+   } \
+\
+   return result; \
+} \
+\
+VALUE method_solve_##SUFFIX( VALUE self, VALUE data, VALUE n_rb, VALUE rhs, VALUE nrhs_rb ) \
+{ \
+   uint32_t n = NUM2UINT( n_rb ); \
+   uint32_t nrhs = NUM2UINT( nrhs_rb ); \
+   TYPE* b = native_##SUFFIX( rhs, (uint64_t)n * nrhs ); \
+   TYPE* a = NULL; \
+\
+   if ( (uint64_t)RARRAY_LEN( data ) != (uint64_t)n * n ) \
+   { \
+      free( b ); \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+   a = native_##SUFFIX( data, (uint64_t)n * n ); \
+\
+   return solve_native_##SUFFIX( a, n, b, nrhs ); \
+} \
+\
+VALUE method_inverse_##SUFFIX( VALUE self, VALUE data, VALUE n_rb ) \
+{ \
+   uint32_t n = NUM2UINT( n_rb ); \
+   uint32_t row = 0; \
+   TYPE* a = native_##SUFFIX( data, (uint64_t)n * n ); \
+   TYPE* identity = (TYPE*)calloc( (uint64_t)n * n + 1, sizeof( TYPE ) ); \
+\
+   for ( row = 0; row < n; ++row ) \
+   { \
+      identity[ (uint64_t)row * n + row ] = 1; \
+   } \
+\
+   return solve_native_##SUFFIX( a, n, identity, n ); \
+} \
+\
+/* Blocked right-looking Cholesky. Each panel is factored column by column */ \
+/* with dot products along contiguous row segments, and the lower triangle */ \
+/* of the trailing matrix is then updated with GEMM, one block row at a */ \
+/* time. */ \
+VALUE method_cholesky_##SUFFIX( VALUE self, VALUE data, VALUE n_rb ) \
+{ \
+   uint32_t n = NUM2UINT( n_rb ); \
+   uint32_t k0 = 0, kend = 0, kb = 0; \
+   uint32_t i0 = 0, iend = 0; \
+   uint32_t row = 0, col = 0; \
+   TYPE value = 0; \
+   int definite = 1; \
+\
+   TYPE* a = native_##SUFFIX( data, (uint64_t)n * n ); \
+   TYPE* panel = (TYPE*)malloc( ( (uint64_t)LINALG_BLOCK * n + 1 ) * sizeof( TYPE ) ); \
+   VALUE result = Qnil; \
+\
+   for ( k0 = 0; ( k0 < n ) && definite; k0 += LINALG_BLOCK ) \
+   { \
+      kend = ( n - k0 < LINALG_BLOCK ) ? n : k0 + LINALG_BLOCK; \
+      kb = kend - k0; \
+\
+      for ( col = k0; ( col < kend ) && definite; ++col ) \
+      { \
+         for ( row = col; row < n; ++row ) \
+         { \
+            value = a[ (uint64_t)row * n + col ] - \
+               dot_##SUFFIX( a + (uint64_t)row * n + k0, a + (uint64_t)col * n + k0, col - k0 ); \
+\
+            if ( row == col ) \
+            { \
+               if ( !( value > 0 ) ) \
+               { \
+                  definite = 0; \
+                  break; \
+               } \
+               a[ (uint64_t)col * n + col ] = sqrt( value ); \
+            } \
+            else \
+            { \
+               a[ (uint64_t)row * n + col ] = value / a[ (uint64_t)col * n + col ]; \
+            } \
+         } \
+      } \
+\
+      if ( !definite || ( kend == n ) ) \
+      { \
+         continue; \
+      } \
+\
+      /* L21^T, so that the update reads both operands along rows. */ \
+      for ( row = kend; row < n; ++row ) \
+      { \
+         for ( col = k0; col < kend; ++col ) \
+         { \
+            panel[ (uint64_t)( col - k0 ) * ( n - kend ) + ( row - kend ) ] = a[ (uint64_t)row * n + col ]; \
+         } \
+      } \
+\
+      /* A22 -= L21 * L21^T, on and below the diagonal blocks only. */ \
+      for ( i0 = kend; i0 < n; i0 = iend ) \
+      { \
+         iend = ( n - i0 < LINALG_BLOCK ) ? n : i0 + LINALG_BLOCK; \
+         GEMM( iend - i0, iend - kend, kb, -1, \
+            a + (uint64_t)i0 * n + k0, n, panel, n - kend, a + (uint64_t)i0 * n + kend, n ); \
+      } \
+   } \
+\
+   if ( definite ) \
+   { \
+      for ( row = 0; row < n; ++row ) \
+      { \
+         memset( a + (uint64_t)row * n + row + 1, 0, ( n - row - 1 ) * sizeof( TYPE ) ); \
+      } \
+      result = ruby_##SUFFIX( a, (uint64_t)n * n ); \
+   } \
+\
+   free( a ); \
+   free( panel ); \
+\
+   if ( !definite ) \
+   { \
+      rb_raise( rb_eRuntimeError, "matrix is not positive definite" ); \
+   } \
+\
+   return result; \
+}
+
+TEMPLATE_LINALG_S( f32, float, 4, __m128,
+   _mm_loadu_ps, _mm_storeu_ps, _mm_setzero_ps, _mm_set1_ps,
+   _mm_add_ps, _mm_sub_ps, _mm_mul_ps, gemm_f32 );
+TEMPLATE_LINALG_S( f64, double, 2, __m128d,
+   _mm_loadu_pd, _mm_storeu_pd, _mm_setzero_pd, _mm_set1_pd,
+   _mm_add_pd, _mm_sub_pd, _mm_mul_pd, gemm_f64 );
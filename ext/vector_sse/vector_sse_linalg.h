@@ -0,0 +1,56 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_LINALG_H
+#define  VECTOR_SSE_LINALG_H
+
+#include "ruby.h"
+
+// Returns [ factors, permutation, sign ] for the LU factorization P*A = L*U
+// of an n x n matrix. 'factors' holds U on and above the diagonal and the
+// unit lower triangular L below it; row i of P*A is row permutation[i] of
+// A, and sign is the parity of the permutation.
+VALUE method_lu_f32( VALUE self, VALUE data, VALUE n_rb );
+VALUE method_lu_f64( VALUE self, VALUE data, VALUE n_rb );
+
+// Solves A*X = B for an n x n matrix A and n x nrhs matrix B.
+VALUE method_solve_f32( VALUE self, VALUE data, VALUE n_rb, VALUE rhs, VALUE nrhs_rb );
+VALUE method_solve_f64( VALUE self, VALUE data, VALUE n_rb, VALUE rhs, VALUE nrhs_rb );
+
+VALUE method_inverse_f32( VALUE self, VALUE data, VALUE n_rb );
+VALUE method_inverse_f64( VALUE self, VALUE data, VALUE n_rb );
+
+// Lower triangular L with A = L*L^T. Only the lower triangle of A is read.
+VALUE method_cholesky_f32( VALUE self, VALUE data, VALUE n_rb );
+VALUE method_cholesky_f64( VALUE self, VALUE data, VALUE n_rb );
+
+#endif // VECTOR_SSE_LINALG_H
@@ -33,6 +33,7 @@
 #include <emmintrin.h>
 #include "vector_sse_mul.h"
 #include "vector_sse_common.h"
+#include "vector_sse_gemm.h"
 
 #define  SSE_VECTOR_WIDTH    (4)
 
@@ -219,112 +220,54 @@ VALUE method_mat_mul_s64( VALUE self, VALUE left, VALUE left_rows_rb, VALUE left
    return result;
 }
 
-VALUE method_mat_mul_f32( VALUE self, VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE right, VALUE right_rows_rb, VALUE right_cols_rb )
-{
-   uint32_t left_row = 0;
-   uint32_t right_col = 0;
-   uint32_t common = 0;
-   uint32_t input_index = 0;
-   uint32_t pos = 0;
-
-   float left_segment[ SSE_VECTOR_WIDTH ];
-   float right_segment[ SSE_VECTOR_WIDTH ];
-   float result_segment[ SSE_VECTOR_WIDTH ];
-
-   __m128i* left_vec = NULL;
-   __m128i* right_vec = NULL;
-   __m128i result_vec;
-
-   VALUE result = Qnil;
-
-   float* result_native = NULL;
-
-   uint32_t left_rows = NUM2UINT( left_rows_rb );
-   uint32_t left_cols = NUM2UINT( left_cols_rb );
-   uint32_t right_rows = NUM2UINT( right_rows_rb );
-   uint32_t right_cols = NUM2UINT( right_cols_rb );
-
-   uint32_t left_length = left_rows * left_cols;
-   uint32_t right_length = right_rows * right_cols;
-   uint32_t result_length = left_rows * right_cols;
-
-   float* left_native = NULL;
-   float* right_native = NULL;
-   float* partial_native = NULL;
-   float* temp = NULL;
-
-   left_native  = (float*) malloc( left_length * sizeof(float) );
-   right_native = (float*) malloc( right_length * sizeof(float) );
-   result_native = (float*) malloc( result_length * sizeof(float) );
-   partial_native = (float*) malloc( left_cols * sizeof(float) );
-
-   memset( partial_native, 0, left_cols * sizeof(float) );
-
-   for ( pos = 0; pos < left_length; ++pos )
-   {
-      left_native[ pos ] = NUM2DBL( rb_ary_entry( left, pos ) );
-   }
-   for ( pos = 0; pos < right_length; ++pos )
-   {
-      right_native[ pos ] = NUM2DBL( rb_ary_entry( right, pos ) );
-   }
-
-   for ( left_row = 0; left_row < left_rows; ++left_row )
-   {
-      for ( right_col = 0; right_col < right_cols; ++right_col )
-      {
-         for ( common = 0; common < left_cols; common += SSE_VECTOR_WIDTH )
-         {
-            for ( pos = 0; pos < SSE_VECTOR_WIDTH; ++pos )
-            {
-               input_index = common + pos;
-
-               if ( input_index < left_cols )
-               {
-                  left_segment[ pos ]  = left_native[ left_row * left_cols + input_index ];
-                  right_segment[ pos ] = right_native[ input_index * right_cols + right_col ];
-               }
-               else
-               {
-                  left_segment[ pos ]  = 0;
-                  right_segment[ pos ] = 0;
-               }
-            }
-
-            left_vec   = ( __m128i *)left_segment;
-            right_vec  = ( __m128i *)right_segment;
-            result_vec = mul_f32( *left_vec, *right_vec );
-
-            _mm_store_si128( (__m128i*)result_segment, result_vec );
-            for ( pos = 0; pos < SSE_VECTOR_WIDTH; ++pos )
-            {
-               if ( (common + pos) < left_cols )
-               {
-                  partial_native[ common + pos ] = result_segment[ pos ];
-               }
-            }
-         }
-
-         result_native[ left_row * right_cols + right_col ] = 0;
-         temp = &result_native[ left_row * right_cols + right_col ];
-         for ( common = 0; common < left_cols; ++common )
-         {
-            (*temp) += partial_native[ common ];
-         }
-      }
-   }
-
-   result = rb_ary_new2( result_length );
-   for ( pos = 0; pos < result_length; ++pos )
-   {
-      rb_ary_push( result, DBL2NUM( result_native[ pos ] ) );
-   }
-
-   free( left_native );
-   free( right_native );
-   free( result_native );
-   free( partial_native );
-
-   return result;
+#define  TEMPLATE_MAT_MUL_F( FUNC_NAME, TYPE, GEMM ) \
+VALUE FUNC_NAME( VALUE self, VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE right, VALUE right_rows_rb, VALUE right_cols_rb ) \
+{ \
+   uint32_t pos = 0; \
+\
+   VALUE result = Qnil; \
+\
+   uint32_t left_rows = NUM2UINT( left_rows_rb ); \
+   uint32_t left_cols = NUM2UINT( left_cols_rb ); \
+   uint32_t right_rows = NUM2UINT( right_rows_rb ); \
+   uint32_t right_cols = NUM2UINT( right_cols_rb ); \
+\
+   uint32_t left_length = left_rows * left_cols; \
+   uint32_t right_length = right_rows * right_cols; \
+   uint32_t result_length = left_rows * right_cols; \
+\
+   TYPE* left_native = NULL; \
+   TYPE* right_native = NULL; \
+   TYPE* result_native = NULL; \
+\
+   left_native  = (TYPE*) malloc( left_length * sizeof(TYPE) ); \
+   right_native = (TYPE*) malloc( right_length * sizeof(TYPE) ); \
+   result_native = (TYPE*) calloc( result_length, sizeof(TYPE) ); \
+\
+   for ( pos = 0; pos < left_length; ++pos ) \
+   { \
+      left_native[ pos ] = NUM2DBL( rb_ary_entry( left, pos ) ); \
+   } \
+   for ( pos = 0; pos < right_length; ++pos ) \
+   { \
+      right_native[ pos ] = NUM2DBL( rb_ary_entry( right, pos ) ); \
+   } \
+\
+   GEMM( left_rows, right_cols, left_cols, 1, \
+      left_native, left_cols, right_native, right_cols, result_native, right_cols ); \
+\
+   result = rb_ary_new2( result_length ); \
+   for ( pos = 0; pos < result_length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( result_native[ pos ] ) ); \
+   } \
+\
+   free( left_native ); \
+   free( right_native ); \
+   free( result_native ); \
+\
+   return result; \
 }
 
+TEMPLATE_MAT_MUL_F( method_mat_mul_f32, float, gemm_f32 );
+TEMPLATE_MAT_MUL_F( method_mat_mul_f64, double, gemm_f64 );
@@ -0,0 +1,601 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <string.h>
+#include <math.h>
+#include <emmintrin.h>
+#include "vector_sse_packed.h"
+#include "vector_sse_common.h"
+#include "vector_sse_gemm.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_tuning.h"
+
+#define  F32_PER_VEC    (4)
+#define  S16_PER_VEC    (8)
+#define  S8_PER_VEC     (16)
+
+// _mm_madd_epi16 steps an int32 lane can take with S8 differences.
+#define  DOT_S16_FLUSH_STEPS   (16384)
+
+// Left rows widened together by packed multiplication. The common dimension
+// and the right columns are widened in panels of the GEMM's own cache
+// blocks, so no operand is ever widened in full.
+#define  PACKED_PANEL_ROWS     (64)
+
+static uint32_t packed_type_size( int type )
+{
+   switch ( type )
+   {
+   case PACKED_TYPE_S8:
+      return sizeof( int8_t );
+   case PACKED_TYPE_S16:
+   case PACKED_TYPE_F16:
+   case PACKED_TYPE_BF16:
+      return sizeof( int16_t );
+   default:
+      rb_raise( rb_eArgError, "invalid packed type" );
+   }
+
+   return 0;
+}
+
+// Round-to-nearest-even float to IEEE half conversion. Overflow saturates
+// to infinity and NaN stays NaN.
+static uint16_t float_to_half( float value )
+{
+   const uint32_t F32_INFINITY = 255u << 23;
+   const uint32_t F16_MAX      = ( 127u + 16 ) << 23;
+   const uint32_t DENORM_MAGIC = ( ( 127u - 15 ) + ( 23 - 10 ) + 1 ) << 23;
+
+   uint32_t bits = 0;
+   uint32_t sign = 0;
+   uint32_t mantissa_odd = 0;
+   uint16_t half = 0;
+   float magic = 0;
+
+   memcpy( &bits, &value, sizeof( bits ) );
+   sign = bits & 0x80000000u;
+   bits ^= sign;
+
+   if ( bits >= F16_MAX )
+   {
+      half = ( bits > F32_INFINITY ) ? 0x7E00 : 0x7C00;
+   }
+   else if ( bits < ( 113u << 23 ) )
+   {
+      // Subnormal or zero: let the FPU round by adding a magic constant.
+      memcpy( &value, &bits, sizeof( value ) );
+      memcpy( &magic, &DENORM_MAGIC, sizeof( magic ) );
+      value += magic;
+      memcpy( &bits, &value, sizeof( bits ) );
+      half = (uint16_t)( bits - DENORM_MAGIC );
+   }
+   else
+   {
+      mantissa_odd = ( bits >> 13 ) & 1;
+      bits += ( (uint32_t)( 15 - 127 ) << 23 ) + 0xFFF;
+      bits += mantissa_odd;
+      half = (uint16_t)( bits >> 13 );
+   }
+
+   return half | (uint16_t)( sign >> 16 );
+}
+
+// Round-to-nearest-even float to bfloat16 conversion.
+static uint16_t float_to_bfloat16( float value )
+{
+   uint32_t bits = 0;
+
+   memcpy( &bits, &value, sizeof( bits ) );
+
+   if ( ( bits & 0x7FFFFFFFu ) > 0x7F800000u )
+   {
+      return (uint16_t)( ( bits >> 16 ) | 0x40 );
+   }
+
+   bits += 0x7FFF + ( ( bits >> 16 ) & 1 );
+   return (uint16_t)( bits >> 16 );
+}
+
+// Four halves, one in the low 16 bits of each 32-bit lane, to four floats.
+// Rescaling by a power of two handles subnormals without branches.
+static inline __m128 half_to_float_vec( const __m128i half )
+{
+   const __m128i mask_no_sign = _mm_set1_epi32( 0x7FFF );
+   const __m128  magic        = _mm_castsi128_ps( _mm_set1_epi32( ( 254 - 15 ) << 23 ) );
+   const __m128i was_inf_nan  = _mm_set1_epi32( 0x7BFF );
+   const __m128  exp_inf_nan  = _mm_castsi128_ps( _mm_set1_epi32( 255 << 23 ) );
+
+   __m128i exp_mantissa = _mm_and_si128( mask_no_sign, half );
+   __m128i just_sign    = _mm_xor_si128( half, exp_mantissa );
+   __m128  scaled       = _mm_mul_ps( _mm_castsi128_ps( _mm_slli_epi32( exp_mantissa, 13 ) ), magic );
+   __m128i is_inf_nan   = _mm_cmpgt_epi32( exp_mantissa, was_inf_nan );
+   __m128  sign_inf_nan = _mm_or_ps(
+      _mm_castsi128_ps( _mm_slli_epi32( just_sign, 16 ) ),
+      _mm_and_ps( _mm_castsi128_ps( is_inf_nan ), exp_inf_nan ) );
+
+   return _mm_or_ps( scaled, sign_inf_nan );
+}
+
+// Widen 'count' packed elements to f32. Integer types are dequantized as
+// ( q - zero_point ) * scale.
+static void widen_f32( int type, const uint8_t* input, float* output, uint32_t count, float scale, float zero_point )
+{
+   uint32_t offset = 0;
+   uint32_t valid  = 0;
+   uint32_t type_size = packed_type_size( type );
+
+   uint8_t input_segment[ 16 ];
+   float   output_segment[ F32_PER_VEC ];
+
+   const __m128i zero_vec       = _mm_setzero_si128();
+   const __m128  scale_vec      = _mm_set1_ps( scale );
+   const __m128  zero_point_vec = _mm_set1_ps( zero_point );
+
+   __m128i packed_vec;
+   __m128i wide_vec;
+   __m128  result_vec;
+
+   for ( offset = 0; offset < count; offset += F32_PER_VEC )
+   {
+      valid = ( count - offset < F32_PER_VEC ) ? ( count - offset ) : F32_PER_VEC;
+
+      memset( input_segment, 0, sizeof( input_segment ) );
+      memcpy( input_segment, input + offset * type_size, valid * type_size );
+      packed_vec = _mm_loadu_si128( (const __m128i *)input_segment );
+
+      switch ( type )
+      {
+      case PACKED_TYPE_S8:
+         wide_vec   = _mm_srai_epi16( _mm_unpacklo_epi8( packed_vec, packed_vec ), 8 );
+         wide_vec   = _mm_srai_epi32( _mm_unpacklo_epi16( wide_vec, wide_vec ), 16 );
+         result_vec = _mm_mul_ps( _mm_sub_ps( _mm_cvtepi32_ps( wide_vec ), zero_point_vec ), scale_vec );
+         break;
+      case PACKED_TYPE_S16:
+         wide_vec   = _mm_srai_epi32( _mm_unpacklo_epi16( packed_vec, packed_vec ), 16 );
+         result_vec = _mm_mul_ps( _mm_sub_ps( _mm_cvtepi32_ps( wide_vec ), zero_point_vec ), scale_vec );
+         break;
+      case PACKED_TYPE_F16:
+         result_vec = half_to_float_vec( _mm_unpacklo_epi16( packed_vec, zero_vec ) );
+         break;
+      default:
+         result_vec = _mm_castsi128_ps( _mm_unpacklo_epi16( zero_vec, packed_vec ) );
+         break;
+      }
+
+      if ( valid == F32_PER_VEC )
+      {
+         _mm_storeu_ps( output + offset, result_vec );
+      }
+      else
+      {
+         _mm_storeu_ps( output_segment, result_vec );
+         memcpy( output + offset, output_segment, valid * sizeof( float ) );
+      }
+   }
+}
+
+// Sign-extend int8 to int16 and subtract the zero point, sixteen at a time.
+// Zero points are within the S8 range, so the differences lie in
+// [ -255, 255 ] and fit in int16.
+static void widen_s8_to_s16( const int8_t* input, int16_t* output, uint32_t count, int16_t zero_point )
+{
+   uint32_t offset = 0;
+
+   const __m128i zero_point_vec = _mm_set1_epi16( zero_point );
+   __m128i packed_vec;
+
+   for ( offset = 0; offset + S8_PER_VEC <= count; offset += S8_PER_VEC )
+   {
+      packed_vec = _mm_loadu_si128( (const __m128i *)( input + offset ) );
+
+      _mm_storeu_si128( (__m128i *)( output + offset ), _mm_sub_epi16(
+         _mm_srai_epi16( _mm_unpacklo_epi8( packed_vec, packed_vec ), 8 ), zero_point_vec ) );
+      _mm_storeu_si128( (__m128i *)( output + offset + S16_PER_VEC ), _mm_sub_epi16(
+         _mm_srai_epi16( _mm_unpackhi_epi8( packed_vec, packed_vec ), 8 ), zero_point_vec ) );
+   }
+
+   for ( ; offset < count; ++offset )
+   {
+      output[ offset ] = (int16_t)( input[ offset ] - zero_point );
+   }
+}
+
+// int16 x int16 dot product; _mm_madd_epi16 multiplies pairs and sums each
+// pair into an int32 lane. A step adds at most 2 * 255 * 255 to a lane, so
+// the lanes are widened into int64 totals every DOT_S16_FLUSH_STEPS steps,
+// before they can overflow, keeping the result exact for any length.
+static int64_t dot_s16( const int16_t* left, const int16_t* right, uint32_t count )
+{
+   uint32_t offset = 0;
+   uint32_t steps = 0;
+   int32_t lanes[ 4 ];
+   int64_t sum = 0;
+
+   __m128i acc_vec = _mm_setzero_si128();
+
+   for ( offset = 0; offset + S16_PER_VEC <= count; offset += S16_PER_VEC )
+   {
+      acc_vec = _mm_add_epi32( acc_vec, _mm_madd_epi16(
+         _mm_loadu_si128( (const __m128i *)( left + offset ) ),
+         _mm_loadu_si128( (const __m128i *)( right + offset ) ) ) );
+
+      if ( ++steps == DOT_S16_FLUSH_STEPS )
+      {
+         _mm_storeu_si128( (__m128i *)lanes, acc_vec );
+         sum += (int64_t)lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+         acc_vec = _mm_setzero_si128();
+         steps = 0;
+      }
+   }
+
+   _mm_storeu_si128( (__m128i *)lanes, acc_vec );
+   sum += (int64_t)lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+
+   for ( ; offset < count; ++offset )
+   {
+      sum += (int32_t)left[ offset ] * right[ offset ];
+   }
+
+   return sum;
+}
+
+VALUE method_pack( VALUE self, VALUE data, VALUE type_rb, VALUE scale_rb, VALUE zero_point_rb )
+{
+   uint32_t pos = 0;
+   uint32_t length = 0;
+
+   int      type       = NUM2INT( type_rb );
+   uint32_t type_size  = packed_type_size( type );
+   double   scale      = NUM2DBL( scale_rb );
+   double   zero_point = NUM2DBL( zero_point_rb );
+   double   low        = ( type == PACKED_TYPE_S8 ) ? INT8_MIN : INT16_MIN;
+   double   high       = ( type == PACKED_TYPE_S8 ) ? INT8_MAX : INT16_MAX;
+
+   double   value     = 0;
+   int8_t   value_s8  = 0;
+   int16_t  value_s16 = 0;
+   uint16_t value_u16 = 0;
+
+   uint8_t* output = NULL;
+   VALUE result = Qnil;
+
+   Check_Type( data, T_ARRAY );
+
+   if ( scale == 0 )
+   {
+      rb_raise( rb_eArgError, "scale must be non-zero" );
+   }
+
+   length = RARRAY_LEN( data );
+   result = rb_str_new( NULL, length * type_size );
+
+   for ( pos = 0; pos < length; ++pos )
+   {
+      value = NUM2DBL( rb_ary_entry( data, pos ) );
+
+      // Re-fetch the pointer each time since NUM2DBL may allocate.
+      output = (uint8_t*)RSTRING_PTR( result ) + pos * type_size;
+
+      switch ( type )
+      {
+      case PACKED_TYPE_S8:
+      case PACKED_TYPE_S16:
+         value = nearbyint( value / scale ) + zero_point;
+         if ( value != value )
+         {
+            value = zero_point;
+         }
+         value = ( value < low ) ? low : ( ( value > high ) ? high : value );
+
+         if ( type == PACKED_TYPE_S8 )
+         {
+            value_s8 = (int8_t)value;
+            memcpy( output, &value_s8, sizeof( value_s8 ) );
+         }
+         else
+         {
+            value_s16 = (int16_t)value;
+            memcpy( output, &value_s16, sizeof( value_s16 ) );
+         }
+         break;
+      case PACKED_TYPE_F16:
+         value_u16 = float_to_half( (float)value );
+         memcpy( output, &value_u16, sizeof( value_u16 ) );
+         break;
+      default:
+         value_u16 = float_to_bfloat16( (float)value );
+         memcpy( output, &value_u16, sizeof( value_u16 ) );
+         break;
+      }
+   }
+
+   return result;
+}
+
+VALUE method_unpack( VALUE self, VALUE bytes, VALUE type_rb, VALUE scale_rb, VALUE zero_point_rb )
+{
+   uint32_t pos = 0;
+   uint32_t length = 0;
+
+   int      type       = NUM2INT( type_rb );
+   uint32_t type_size  = packed_type_size( type );
+   float    scale      = NUM2DBL( scale_rb );
+   float    zero_point = NUM2DBL( zero_point_rb );
+
+   float* output_native = NULL;
+   VALUE result = Qnil;
+
+   Check_Type( bytes, T_STRING );
+
+   length = RSTRING_LEN( bytes ) / type_size;
+   result = rb_ary_new2( length );
+
+   if ( length > 0 )
+   {
+      output_native = (float*) malloc( length * sizeof( float ) );
+
+      widen_f32( type, (const uint8_t*)RSTRING_PTR( bytes ), output_native, length, scale, zero_point );
+
+      for ( pos = 0; pos < length; ++pos )
+      {
+         rb_ary_push( result, DBL2NUM( output_native[ pos ] ) );
+      }
+
+      free( output_native );
+   }
+
+   return result;
+}
+
+struct packed_mul_context {
+   int            type;
+   uint32_t       type_size;
+   const uint8_t* left;
+   const uint8_t* right;
+   uint32_t       rows;
+   uint32_t       common;
+   uint32_t       cols;
+   float          left_scale;
+   float          left_zero_point;
+   float          right_scale;
+   float          right_zero_point;
+   uint32_t       block_k;
+   uint32_t       block_n;
+   float*         out;
+};
+
+// Output rows [begin, end) of a float packed product. Each panel of both
+// operands is widened to f32 in scratch and accumulated by the GEMM.
+static void mul_packed_f32_rows( void* context, uint32_t begin, uint32_t end )
+{
+   const struct packed_mul_context* ctx = (const struct packed_mul_context*)context;
+   uint32_t row = 0, row_end = 0;
+   uint32_t k0 = 0, kb = 0;
+   uint32_t n0 = 0, nb = 0;
+   uint32_t pos = 0;
+
+   float* left_panel  = (float*) malloc( (uint64_t)PACKED_PANEL_ROWS * ctx->block_k * sizeof( float ) );
+   float* right_panel = (float*) malloc( (uint64_t)ctx->block_k * ctx->block_n * sizeof( float ) );
+
+   for ( row = begin; row < end; row = row_end )
+   {
+      row_end = ( end - row > PACKED_PANEL_ROWS ) ? row + PACKED_PANEL_ROWS : end;
+
+      for ( k0 = 0; k0 < ctx->common; k0 += kb )
+      {
+         kb = ( ctx->common - k0 < ctx->block_k ) ? ctx->common - k0 : ctx->block_k;
+
+         for ( pos = row; pos < row_end; ++pos )
+         {
+            widen_f32( ctx->type, ctx->left + ( (uint64_t)pos * ctx->common + k0 ) * ctx->type_size,
+               left_panel + (uint64_t)( pos - row ) * kb, kb, ctx->left_scale, ctx->left_zero_point );
+         }
+
+         for ( n0 = 0; n0 < ctx->cols; n0 += nb )
+         {
+            nb = ( ctx->cols - n0 < ctx->block_n ) ? ctx->cols - n0 : ctx->block_n;
+
+            for ( pos = k0; pos < k0 + kb; ++pos )
+            {
+               widen_f32( ctx->type, ctx->right + ( (uint64_t)pos * ctx->cols + n0 ) * ctx->type_size,
+                  right_panel + (uint64_t)( pos - k0 ) * nb, nb, ctx->right_scale, ctx->right_zero_point );
+            }
+
+            gemm_f32_serial( row_end - row, nb, kb, 1, left_panel, kb, right_panel, nb,
+               ctx->out + (uint64_t)row * ctx->cols + n0, ctx->cols );
+         }
+      }
+   }
+
+   free( left_panel );
+   free( right_panel );
+}
+
+// Output rows [begin, end) of an S8 packed product. Panels are widened to
+// int16 differences, the right one transposed, and multiplied by dot_s16
+// into int64 sums, which keeps the product exact.
+static void mul_packed_s8_rows( void* context, uint32_t begin, uint32_t end )
+{
+   const struct packed_mul_context* ctx = (const struct packed_mul_context*)context;
+   const int8_t* left  = (const int8_t*)ctx->left;
+   const int8_t* right = (const int8_t*)ctx->right;
+   int16_t left_zero_point  = (int16_t)ctx->left_zero_point;
+   int16_t right_zero_point = (int16_t)ctx->right_zero_point;
+   float scale = ctx->left_scale * ctx->right_scale;
+   uint32_t row = 0, row_end = 0;
+   uint32_t k0 = 0, kb = 0;
+   uint32_t n0 = 0, nb = 0;
+   uint32_t pos = 0;
+   uint32_t col = 0;
+
+   int16_t* left_panel  = (int16_t*) malloc( (uint64_t)PACKED_PANEL_ROWS * ctx->block_k * sizeof( int16_t ) );
+   int16_t* right_panel = (int16_t*) malloc( (uint64_t)ctx->block_n * ctx->block_k * sizeof( int16_t ) );
+   int64_t* sums        = (int64_t*) malloc( (uint64_t)PACKED_PANEL_ROWS * ctx->block_n * sizeof( int64_t ) );
+
+   for ( row = begin; row < end; row = row_end )
+   {
+      row_end = ( end - row > PACKED_PANEL_ROWS ) ? row + PACKED_PANEL_ROWS : end;
+
+      for ( n0 = 0; n0 < ctx->cols; n0 += nb )
+      {
+         nb = ( ctx->cols - n0 < ctx->block_n ) ? ctx->cols - n0 : ctx->block_n;
+         memset( sums, 0, (uint64_t)( row_end - row ) * nb * sizeof( int64_t ) );
+
+         for ( k0 = 0; k0 < ctx->common; k0 += kb )
+         {
+            kb = ( ctx->common - k0 < ctx->block_k ) ? ctx->common - k0 : ctx->block_k;
+
+            for ( pos = row; pos < row_end; ++pos )
+            {
+               widen_s8_to_s16( left + (uint64_t)pos * ctx->common + k0,
+                  left_panel + (uint64_t)( pos - row ) * kb, kb, left_zero_point );
+            }
+
+            for ( pos = k0; pos < k0 + kb; ++pos )
+            {
+               for ( col = 0; col < nb; ++col )
+               {
+                  right_panel[ (uint64_t)col * kb + pos - k0 ] =
+                     (int16_t)( right[ (uint64_t)pos * ctx->cols + n0 + col ] - right_zero_point );
+               }
+            }
+
+            for ( pos = row; pos < row_end; ++pos )
+            {
+               for ( col = 0; col < nb; ++col )
+               {
+                  sums[ (uint64_t)( pos - row ) * nb + col ] += dot_s16(
+                     left_panel + (uint64_t)( pos - row ) * kb, right_panel + (uint64_t)col * kb, kb );
+               }
+            }
+         }
+
+         for ( pos = row; pos < row_end; ++pos )
+         {
+            for ( col = 0; col < nb; ++col )
+            {
+               ctx->out[ (uint64_t)pos * ctx->cols + n0 + col ] = scale * sums[ (uint64_t)( pos - row ) * nb + col ];
+            }
+         }
+      }
+   }
+
+   free( left_panel );
+   free( right_panel );
+   free( sums );
+}
+
+VALUE method_mul_packed( VALUE self, VALUE type_rb,
+   VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE left_scale_rb, VALUE left_zero_point_rb,
+   VALUE right, VALUE right_rows_rb, VALUE right_cols_rb, VALUE right_scale_rb, VALUE right_zero_point_rb )
+{
+   struct packed_mul_context ctx;
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ];
+   uint64_t chunks = 0;
+   uint32_t chunk = 0;
+   uint32_t threads = parallel_thread_count();
+   uint64_t pos = 0;
+
+   int      type       = NUM2INT( type_rb );
+   uint32_t type_size  = packed_type_size( type );
+   uint32_t left_rows  = NUM2UINT( left_rows_rb );
+   uint32_t left_cols  = NUM2UINT( left_cols_rb );
+   uint32_t right_rows = NUM2UINT( right_rows_rb );
+   uint32_t right_cols = NUM2UINT( right_cols_rb );
+
+   uint64_t result_length = (uint64_t)left_rows * right_cols;
+
+   VALUE result = Qnil;
+
+   Check_Type( left, T_STRING );
+   Check_Type( right, T_STRING );
+
+   if ( left_cols != right_rows )
+   {
+      rb_raise( rb_eRuntimeError, "invalid matrix dimensions" );
+   }
+
+   if ( ( (uint64_t)RSTRING_LEN( left ) != (uint64_t)left_rows * left_cols * type_size ) ||
+        ( (uint64_t)RSTRING_LEN( right ) != (uint64_t)right_rows * right_cols * type_size ) )
+   {
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" );
+   }
+
+   ctx.type             = type;
+   ctx.type_size        = type_size;
+   ctx.left             = (const uint8_t*)RSTRING_PTR( left );
+   ctx.right            = (const uint8_t*)RSTRING_PTR( right );
+   ctx.rows             = left_rows;
+   ctx.common           = left_cols;
+   ctx.cols             = right_cols;
+   ctx.left_scale       = NUM2DBL( left_scale_rb );
+   ctx.left_zero_point  = NUM2DBL( left_zero_point_rb );
+   ctx.right_scale      = NUM2DBL( right_scale_rb );
+   ctx.right_zero_point = NUM2DBL( right_zero_point_rb );
+   ctx.block_k          = vector_sse_tuning.gemm_f32_block_k;
+   ctx.block_n          = vector_sse_tuning.gemm_f32_block_n;
+   ctx.out              = (float*) calloc( result_length > 0 ? result_length : 1, sizeof( float ) );
+
+   // Threads split the output rows.
+   chunks = result_length * left_cols / vector_sse_tuning.gemm_work_per_thread;
+   if ( chunks > threads )
+   {
+      chunks = threads;
+   }
+   if ( chunks > left_rows )
+   {
+      chunks = left_rows;
+   }
+   if ( chunks == 0 )
+   {
+      chunks = 1;
+   }
+
+   for ( chunk = 0; chunk <= chunks; ++chunk )
+   {
+      bounds[ chunk ] = (uint32_t)( (uint64_t)left_rows * chunk / chunks );
+   }
+
+   parallel_run( ( type == PACKED_TYPE_S8 ) ? mul_packed_s8_rows : mul_packed_f32_rows,
+      &ctx, bounds, (uint32_t)chunks );
+
+   result = rb_ary_new2( result_length );
+   for ( pos = 0; pos < result_length; ++pos )
+   {
+      rb_ary_push( result, DBL2NUM( ctx.out[ pos ] ) );
+   }
+
+   free( ctx.out );
+
+   return result;
+}
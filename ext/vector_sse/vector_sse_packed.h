@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_PACKED_H
+#define  VECTOR_SSE_PACKED_H
+
+#include "ruby.h"
+
+// Reduced-precision storage types. The values match VectorSSE::Type.
+#define  PACKED_TYPE_S8     (2)
+#define  PACKED_TYPE_S16    (3)
+#define  PACKED_TYPE_F16    (6)
+#define  PACKED_TYPE_BF16   (7)
+
+VALUE method_pack( VALUE self, VALUE data, VALUE type_rb, VALUE scale_rb, VALUE zero_point_rb );
+VALUE method_unpack( VALUE self, VALUE bytes, VALUE type_rb, VALUE scale_rb, VALUE zero_point_rb );
+
+VALUE method_mul_packed( VALUE self, VALUE type_rb,
+   VALUE left, VALUE left_rows_rb, VALUE left_cols_rb, VALUE left_scale_rb, VALUE left_zero_point_rb,
+   VALUE right, VALUE right_rows_rb, VALUE right_cols_rb, VALUE right_scale_rb, VALUE right_zero_point_rb );
+
+#endif // VECTOR_SSE_PACKED_H
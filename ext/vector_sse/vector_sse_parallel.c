@@ -0,0 +1,224 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <pthread.h>
+#include <unistd.h>
+#include "vector_sse_parallel.h"
+#include "ruby/thread.h"
+
+// Zero selects the number of online processors. Kernels in any Ractor read
+// it while the main Ractor may set it, so it is accessed atomically.
+static uint32_t thread_count = 0;
+
+// Set on threads that Ruby does not know about and that never hold the GVL.
+static __thread int native_thread = 0;
+
+struct parallel_chunk {
+   parallel_task task;
+   void*         context;
+   uint32_t      begin;
+   uint32_t      end;
+};
+
+struct parallel_job {
+   parallel_task   task;
+   void*           context;
+   const uint32_t* bounds;
+   uint32_t        chunks;
+};
+
+uint32_t parallel_thread_count( void )
+{
+   long online = 0;
+   uint32_t count = __atomic_load_n( &thread_count, __ATOMIC_RELAXED );
+
+   if ( count > 0 )
+   {
+      return count;
+   }
+
+   online = sysconf( _SC_NPROCESSORS_ONLN );
+   if ( online < 1 )
+   {
+      return 1;
+   }
+
+   return ( online > PARALLEL_MAX_THREADS ) ? PARALLEL_MAX_THREADS : (uint32_t)online;
+}
+
+uint32_t parallel_partition( const uint32_t* prefix, uint32_t count, uint32_t chunks, uint32_t* bounds )
+{
+   uint32_t chunk = 0;
+   uint32_t used  = 0;
+   uint32_t low   = 0;
+   uint32_t high  = 0;
+   uint32_t mid   = 0;
+   uint64_t total = prefix[ count ] - prefix[ 0 ];
+   uint64_t target = 0;
+
+   if ( chunks > count )
+   {
+      chunks = ( count > 0 ) ? count : 1;
+   }
+
+   bounds[ 0 ] = 0;
+
+   for ( chunk = 1; chunk < chunks; ++chunk )
+   {
+      // First item whose starting weight reaches chunk/chunks of the total.
+      target = prefix[ 0 ] + ( total * chunk ) / chunks;
+      low  = bounds[ used ];
+      high = count;
+
+      while ( low < high )
+      {
+         mid = low + ( high - low ) / 2;
+         if ( prefix[ mid ] < target )
+         {
+            low = mid + 1;
+         }
+         else
+         {
+            high = mid;
+         }
+      }
+
+      if ( low > bounds[ used ] && low < count )
+      {
+         bounds[ ++used ] = low;
+      }
+   }
+
+   bounds[ ++used ] = count;
+
+   return used;
+}
+
+static void* parallel_chunk_main( void* arg )
+{
+   struct parallel_chunk* chunk = (struct parallel_chunk*)arg;
+
+   chunk->task( chunk->context, chunk->begin, chunk->end );
+
+   return NULL;
+}
+
+static void* parallel_job_main( void* arg )
+{
+   struct parallel_job* job = (struct parallel_job*)arg;
+
+   pthread_t threads[ PARALLEL_MAX_THREADS ];
+   int started[ PARALLEL_MAX_THREADS ];
+   struct parallel_chunk chunks[ PARALLEL_MAX_THREADS ];
+   uint32_t index = 0;
+
+   for ( index = 0; index < job->chunks; ++index )
+   {
+      chunks[ index ].task    = job->task;
+      chunks[ index ].context = job->context;
+      chunks[ index ].begin   = job->bounds[ index ];
+      chunks[ index ].end     = job->bounds[ index + 1 ];
+      started[ index ] = 0;
+   }
+
+   // The calling thread takes the first chunk. If a thread cannot be
+   // started its chunk runs here as well.
+   for ( index = 1; index < job->chunks; ++index )
+   {
+      started[ index ] = ( pthread_create( &threads[ index ], NULL, parallel_chunk_main, &chunks[ index ] ) == 0 );
+   }
+
+   parallel_chunk_main( &chunks[ 0 ] );
+
+   for ( index = 1; index < job->chunks; ++index )
+   {
+      if ( started[ index ] )
+      {
+         pthread_join( threads[ index ], NULL );
+      }
+      else
+      {
+         parallel_chunk_main( &chunks[ index ] );
+      }
+   }
+
+   return NULL;
+}
+
+void parallel_run( parallel_task task, void* context, const uint32_t* bounds, uint32_t chunks )
+{
+   struct parallel_job job;
+
+   if ( chunks <= 1 )
+   {
+      task( context, bounds[ 0 ], bounds[ chunks ] );
+      return;
+   }
+
+   job.task    = task;
+   job.context = context;
+   job.bounds  = bounds;
+   job.chunks  = chunks;
+
+   if ( native_thread )
+   {
+      parallel_job_main( &job );
+   }
+   else
+   {
+      rb_thread_call_without_gvl( parallel_job_main, &job, NULL, NULL );
+   }
+}
+
+void parallel_enter_native_thread( void )
+{
+   native_thread = 1;
+}
+
+VALUE method_get_thread_count( VALUE self )
+{
+   return UINT2NUM( parallel_thread_count() );
+}
+
+VALUE method_set_thread_count( VALUE self, VALUE count_rb )
+{
+   int count = NUM2INT( count_rb );
+
+   if ( ( count < 0 ) || ( count > PARALLEL_MAX_THREADS ) )
+   {
+      rb_raise( rb_eArgError, "thread count must be between 0 and %d", PARALLEL_MAX_THREADS );
+   }
+
+   __atomic_store_n( &thread_count, (uint32_t)count, __ATOMIC_RELAXED );
+
+   return count_rb;
+}
@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_PARALLEL_H
+#define  VECTOR_SSE_PARALLEL_H
+
+#include <stdint.h>
+#include "ruby.h"
+
+#define  PARALLEL_MAX_THREADS   (64)
+
+// Processes the half-open range [begin, end) of some partitioned work.
+typedef void ( *parallel_task )( void* context, uint32_t begin, uint32_t end );
+
+// Number of threads kernels may split work across.
+uint32_t parallel_thread_count( void );
+
+// Split [0, count) into at most 'chunks' ranges of roughly equal weight,
+// where prefix[i] is the total weight of items before item i (so prefix
+// has count + 1 entries, like a CSR row pointer). Writes chunk boundaries
+// to 'bounds' (chunks + 1 entries) and returns the number of chunks used.
+uint32_t parallel_partition( const uint32_t* prefix, uint32_t count, uint32_t chunks, uint32_t* bounds );
+
+// Runs 'task' once per chunk, each chunk on its own thread, with the GVL
+// released. The task must not touch Ruby objects. 'chunks' must not
+// exceed PARALLEL_MAX_THREADS.
+void parallel_run( parallel_task task, void* context, const uint32_t* bounds, uint32_t chunks );
+
+// Marks the calling thread as a native (non-Ruby) thread, so parallel_run
+// skips the GVL release it cannot perform there.
+void parallel_enter_native_thread( void );
+
+VALUE method_get_thread_count( VALUE self );
+VALUE method_set_thread_count( VALUE self, VALUE count_rb );
+
+#endif // VECTOR_SSE_PARALLEL_H
@@ -0,0 +1,656 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <smmintrin.h>
+#include <nmmintrin.h>
+#include "vector_sse_sort.h"
+
+// The sort is a bottom-up merge sort. Blocks of EL_PER_VEC x EL_PER_VEC
+// elements are first sorted in registers: a sorting network across the
+// registers sorts each lane column, and a transpose turns the columns into
+// sorted runs of one vector each. Runs are then merged a vector at a time
+// with a bitonic merge network.
+//
+// 32-bit elements are shuffled in the float domain and 64-bit elements in
+// the double domain, so only the min/max operations differ by type.
+
+#define  MIN_S32( A, B ) \
+   _mm_castsi128_ps( _mm_min_epi32( _mm_castps_si128( A ), _mm_castps_si128( B ) ) )
+#define  MAX_S32( A, B ) \
+   _mm_castsi128_ps( _mm_max_epi32( _mm_castps_si128( A ), _mm_castps_si128( B ) ) )
+
+#define  GT_S64( A, B ) \
+   _mm_castsi128_pd( _mm_cmpgt_epi64( _mm_castpd_si128( A ), _mm_castpd_si128( B ) ) )
+#define  MIN_S64( A, B )   _mm_blendv_pd( A, B, GT_S64( A, B ) )
+#define  MAX_S64( A, B )   _mm_blendv_pd( B, A, GT_S64( A, B ) )
+
+
+#define  TEMPLATE_SORT_NETWORK_4( SUFFIX, MIN, MAX ) \
+static inline void compare_exchange_##SUFFIX( __m128* low, __m128* high ) \
+{ \
+   __m128 min = MIN( *low, *high ); \
+   *high = MAX( *low, *high ); \
+   *low = min; \
+} \
+\
+static inline void sort_block_##SUFFIX( void* block ) \
+{ \
+   float* base = (float*)block; \
+   __m128 row0 = _mm_loadu_ps( base ); \
+   __m128 row1 = _mm_loadu_ps( base + 4 ); \
+   __m128 row2 = _mm_loadu_ps( base + 8 ); \
+   __m128 row3 = _mm_loadu_ps( base + 12 ); \
+\
+   compare_exchange_##SUFFIX( &row0, &row1 ); \
+   compare_exchange_##SUFFIX( &row2, &row3 ); \
+   compare_exchange_##SUFFIX( &row0, &row2 ); \
+   compare_exchange_##SUFFIX( &row1, &row3 ); \
+   compare_exchange_##SUFFIX( &row1, &row2 ); \
+\
+   _MM_TRANSPOSE4_PS( row0, row1, row2, row3 ); \
+\
+   _mm_storeu_ps( base, row0 ); \
+   _mm_storeu_ps( base + 4, row1 ); \
+   _mm_storeu_ps( base + 8, row2 ); \
+   _mm_storeu_ps( base + 12, row3 ); \
+} \
+\
+/* Sorts a bitonic vector: compare lanes two apart, then one apart. */ \
+static inline __m128 bitonic_clean_##SUFFIX( __m128 vec ) \
+{ \
+   __m128 swapped = _mm_shuffle_ps( vec, vec, _MM_SHUFFLE( 1, 0, 3, 2 ) ); \
+   vec = _mm_movelh_ps( MIN( vec, swapped ), MAX( vec, swapped ) ); \
+   swapped = _mm_shuffle_ps( vec, vec, _MM_SHUFFLE( 2, 3, 0, 1 ) ); \
+   return _mm_blend_ps( MIN( vec, swapped ), MAX( vec, swapped ), 0xA ); \
+} \
+\
+/* Merges two sorted vectors: 'low' receives the smaller half. */ \
+static inline void bitonic_merge_##SUFFIX( __m128* low, __m128* high ) \
+{ \
+   __m128 reversed = _mm_shuffle_ps( *high, *high, _MM_SHUFFLE( 0, 1, 2, 3 ) ); \
+   __m128 min = MIN( *low, reversed ); \
+   __m128 max = MAX( *low, reversed ); \
+   *low = bitonic_clean_##SUFFIX( min ); \
+   *high = bitonic_clean_##SUFFIX( max ); \
+}
+
+#define  TEMPLATE_SORT_NETWORK_2( SUFFIX, MIN, MAX ) \
+static inline void sort_block_##SUFFIX( void* block ) \
+{ \
+   double* base = (double*)block; \
+   __m128d row0 = _mm_loadu_pd( base ); \
+   __m128d row1 = _mm_loadu_pd( base + 2 ); \
+   __m128d min = MIN( row0, row1 ); \
+   __m128d max = MAX( row0, row1 ); \
+\
+   _mm_storeu_pd( base, _mm_unpacklo_pd( min, max ) ); \
+   _mm_storeu_pd( base + 2, _mm_unpackhi_pd( min, max ) ); \
+} \
+\
+static inline __m128d bitonic_clean_##SUFFIX( __m128d vec ) \
+{ \
+   __m128d swapped = _mm_shuffle_pd( vec, vec, 1 ); \
+   return _mm_move_sd( MAX( vec, swapped ), MIN( vec, swapped ) ); \
+} \
+\
+static inline void bitonic_merge_##SUFFIX( __m128d* low, __m128d* high ) \
+{ \
+   __m128d reversed = _mm_shuffle_pd( *high, *high, 1 ); \
+   __m128d min = MIN( *low, reversed ); \
+   __m128d max = MAX( *low, reversed ); \
+   *low = bitonic_clean_##SUFFIX( min ); \
+   *high = bitonic_clean_##SUFFIX( max ); \
+}
+
+TEMPLATE_SORT_NETWORK_4( s32, MIN_S32, MAX_S32 );
+TEMPLATE_SORT_NETWORK_4( f32, _mm_min_ps, _mm_max_ps );
+TEMPLATE_SORT_NETWORK_2( s64, MIN_S64, MAX_S64 );
+TEMPLATE_SORT_NETWORK_2( f64, _mm_min_pd, _mm_max_pd );
+
+
+#define  TEMPLATE_SORT( SUFFIX, TYPE, EL_PER_VEC, VTYPE, LOADU, STOREU ) \
+/* Merges sorted runs 'a' and 'b' into 'out'. While both runs have a */ \
+/* vector left, the vector whose run has the smaller head is merged with */ \
+/* the larger half of the previous merge. The rest is merged in scalar. */ \
+static void merge_runs_##SUFFIX( const TYPE* a, size_t a_count, const TYPE* b, size_t b_count, TYPE* out ) \
+{ \
+   TYPE spill[ EL_PER_VEC ]; \
+   size_t spill_count = 0; \
+   size_t spill_pos = 0; \
+   size_t a_pos = 0; \
+   size_t b_pos = 0; \
+   VTYPE low; \
+   VTYPE high; \
+\
+   if ( ( a_count >= EL_PER_VEC ) && ( b_count >= EL_PER_VEC ) ) \
+   { \
+      low = LOADU( a ); \
+      high = LOADU( b ); \
+      a_pos = EL_PER_VEC; \
+      b_pos = EL_PER_VEC; \
+\
+      for ( ;; ) \
+      { \
+         bitonic_merge_##SUFFIX( &low, &high ); \
+         STOREU( out, low ); \
+         out += EL_PER_VEC; \
+\
+         if ( ( b_pos >= b_count ) || ( ( a_pos < a_count ) && ( a[ a_pos ] <= b[ b_pos ] ) ) ) \
+         { \
+            if ( a_pos + EL_PER_VEC > a_count ) break; \
+            low = LOADU( a + a_pos ); \
+            a_pos += EL_PER_VEC; \
+         } \
+         else \
+         { \
+            if ( b_pos + EL_PER_VEC > b_count ) break; \
+            low = LOADU( b + b_pos ); \
+            b_pos += EL_PER_VEC; \
+         } \
+      } \
+\
+      STOREU( spill, high ); \
+      spill_count = EL_PER_VEC; \
+   } \
+\
+   while ( ( spill_pos < spill_count ) || ( a_pos < a_count ) || ( b_pos < b_count ) ) \
+   { \
+      if ( ( spill_pos < spill_count ) && \
+           ( ( a_pos >= a_count ) || ( spill[ spill_pos ] <= a[ a_pos ] ) ) && \
+           ( ( b_pos >= b_count ) || ( spill[ spill_pos ] <= b[ b_pos ] ) ) ) \
+      { \
+         *out++ = spill[ spill_pos++ ]; \
+      } \
+      else if ( ( a_pos < a_count ) && ( ( b_pos >= b_count ) || ( a[ a_pos ] <= b[ b_pos ] ) ) ) \
+      { \
+         *out++ = a[ a_pos++ ]; \
+      } \
+      else \
+      { \
+         *out++ = b[ b_pos++ ]; \
+      } \
+   } \
+} \
+\
+/* Sorts 'count' elements of 'data' in place, using 'scratch' (of the */ \
+/* same size) for the merge passes. */ \
+static void sort_native_##SUFFIX( TYPE* data, size_t count, TYPE* scratch ) \
+{ \
+   size_t block = EL_PER_VEC * EL_PER_VEC; \
+   size_t pos = 0; \
+   size_t inner = 0; \
+   size_t width = 0; \
+   size_t mid = 0; \
+   size_t end = 0; \
+   TYPE* source = data; \
+   TYPE* target = scratch; \
+   TYPE* swap = NULL; \
+   TYPE value; \
+\
+   for ( pos = 0; pos + block <= count; pos += block ) \
+   { \
+      sort_block_##SUFFIX( data + pos ); \
+   } \
+\
+   /* The partial block at the end is sorted as one run. */ \
+   for ( inner = pos + 1; inner < count; ++inner ) \
+   { \
+      value = data[ inner ]; \
+      for ( end = inner; ( end > pos ) && ( data[ end - 1 ] > value ); --end ) \
+      { \
+         data[ end ] = data[ end - 1 ]; \
+      } \
+      data[ end ] = value; \
+   } \
+\
+   for ( width = EL_PER_VEC; width < count; width *= 2 ) \
+   { \
+      for ( pos = 0; pos < count; pos += 2 * width ) \
+      { \
+         mid = ( pos + width < count ) ? pos + width : count; \
+         end = ( pos + 2 * width < count ) ? pos + 2 * width : count; \
+         merge_runs_##SUFFIX( source + pos, mid - pos, source + mid, end - mid, target + pos ); \
+      } \
+\
+      swap = source; \
+      source = target; \
+      target = swap; \
+   } \
+\
+   if ( source != data ) \
+   { \
+      memcpy( data, source, count * sizeof( TYPE ) ); \
+   } \
+}
+
+#define  LOADU_PS( PTR )          _mm_loadu_ps( (const float*)( PTR ) )
+#define  STOREU_PS( PTR, VEC )    _mm_storeu_ps( (float*)( PTR ), VEC )
+#define  LOADU_PD( PTR )          _mm_loadu_pd( (const double*)( PTR ) )
+#define  STOREU_PD( PTR, VEC )    _mm_storeu_pd( (double*)( PTR ), VEC )
+
+TEMPLATE_SORT( s32, int32_t, 4, __m128, LOADU_PS, STOREU_PS );
+TEMPLATE_SORT( f32, float, 4, __m128, LOADU_PS, STOREU_PS );
+TEMPLATE_SORT( s64, int64_t, 2, __m128d, LOADU_PD, STOREU_PD );
+TEMPLATE_SORT( f64, double, 2, __m128d, LOADU_PD, STOREU_PD );
+
+
+#define  IS_NUMBER_INT( X )     ( 1 )
+#define  IS_NUMBER_FLOAT( X )   ( !isnan( X ) )
+
+// Native copy of the array with NaNs moved to the end, keeping the
+// original position of each element in 'index' when it is not NULL.
+// Returns the number of elements before the NaNs.
+#define  TEMPLATE_NATIVE_COPY( SUFFIX, TYPE, CONV_IN, IS_NUMBER ) \
+static TYPE* native_copy_##SUFFIX( VALUE data, long* index, long* number_count ) \
+{ \
+   long count = RARRAY_LEN( data ); \
+   long head = 0; \
+   long tail = count; \
+   long pos = 0; \
+   TYPE value; \
+   TYPE* native = (TYPE*)malloc( ( count + 1 ) * sizeof( TYPE ) ); \
+\
+   for ( pos = 0; pos < count; ++pos ) \
+   { \
+      value = CONV_IN( rb_ary_entry( data, pos ) ); \
+      if ( IS_NUMBER( value ) ) \
+      { \
+         if ( index ) index[ head ] = pos; \
+         native[ head++ ] = value; \
+      } \
+      else \
+      { \
+         --tail; \
+      } \
+   } \
+\
+   /* NaNs were counted from the back; fill them in original order. */ \
+   for ( pos = 0; ( pos < count ) && ( tail < count ); ++pos ) \
+   { \
+      value = CONV_IN( rb_ary_entry( data, pos ) ); \
+      if ( !IS_NUMBER( value ) ) \
+      { \
+         if ( index ) index[ tail ] = pos; \
+         native[ tail++ ] = value; \
+      } \
+   } \
+\
+   *number_count = head; \
+\
+   return native; \
+}
+
+TEMPLATE_NATIVE_COPY( s32, int32_t, NUM2INT, IS_NUMBER_INT );
+TEMPLATE_NATIVE_COPY( s64, int64_t, NUM2LL, IS_NUMBER_INT );
+TEMPLATE_NATIVE_COPY( f32, float, NUM2DBL, IS_NUMBER_FLOAT );
+TEMPLATE_NATIVE_COPY( f64, double, NUM2DBL, IS_NUMBER_FLOAT );
+
+
+#define  TEMPLATE_SORT_METHOD( SUFFIX, TYPE, CONV_OUT ) \
+VALUE method_sort_##SUFFIX( VALUE self, VALUE data ) \
+{ \
+   long count = 0; \
+   long number_count = 0; \
+   long pos = 0; \
+   TYPE* native = NULL; \
+   TYPE* scratch = NULL; \
+   VALUE result; \
+\
+   Check_Type( data, T_ARRAY ); \
+   count = RARRAY_LEN( data ); \
+\
+   native = native_copy_##SUFFIX( data, NULL, &number_count ); \
+   scratch = (TYPE*)malloc( ( count + 1 ) * sizeof( TYPE ) ); \
+\
+   sort_native_##SUFFIX( native, number_count, scratch ); \
+\
+   result = rb_ary_new2( count ); \
+   for ( pos = 0; pos < count; ++pos ) \
+   { \
+      rb_ary_push( result, CONV_OUT( native[ pos ] ) ); \
+   } \
+\
+   free( scratch ); \
+   free( native ); \
+\
+   return result; \
+}
+
+TEMPLATE_SORT_METHOD( s32, int32_t, INT2NUM );
+TEMPLATE_SORT_METHOD( s64, int64_t, LL2NUM );
+TEMPLATE_SORT_METHOD( f32, float, DBL2NUM );
+TEMPLATE_SORT_METHOD( f64, double, DBL2NUM );
+
+
+// Maps a 32-bit key to a signed integer with the same ordering. Floats
+// flip their magnitude bits when negative.
+#define  ORDER_KEY_S32( X )   ( X )
+
+static inline int32_t order_key_f32( float value )
+{
+   int32_t bits = 0;
+
+   memcpy( &bits, &value, sizeof( bits ) );
+
+   return bits ^ ( ( bits >> 31 ) & 0x7FFFFFFF );
+}
+
+// 32-bit keys are sorted with their index packed into the low half of a
+// 64-bit integer. Packed values are unique, so the vector sort needs no
+// separate payload and the result is stable.
+#define  TEMPLATE_ARGSORT_PACKED( SUFFIX, TYPE, ORDER_KEY ) \
+VALUE method_argsort_##SUFFIX( VALUE self, VALUE data ) \
+{ \
+   long count = 0; \
+   long number_count = 0; \
+   long pos = 0; \
+   long* index = NULL; \
+   TYPE* native = NULL; \
+   int64_t* packed = NULL; \
+   int64_t* scratch = NULL; \
+   VALUE result; \
+\
+   Check_Type( data, T_ARRAY ); \
+   count = RARRAY_LEN( data ); \
+\
+   if ( count > UINT32_MAX ) \
+   { \
+      rb_raise( rb_eArgError, "array is too large to sort" ); \
+   } \
+\
+   index = (long*)malloc( ( count + 1 ) * sizeof( long ) ); \
+   native = native_copy_##SUFFIX( data, index, &number_count ); \
+   packed = (int64_t*)malloc( ( count + 1 ) * sizeof( int64_t ) ); \
+   scratch = (int64_t*)malloc( ( count + 1 ) * sizeof( int64_t ) ); \
+\
+   for ( pos = 0; pos < number_count; ++pos ) \
+   { \
+      packed[ pos ] = (int64_t)( ( (uint64_t)(uint32_t)ORDER_KEY( native[ pos ] ) << 32 ) | \
+                                 (uint32_t)index[ pos ] ); \
+   } \
+\
+   sort_native_s64( packed, number_count, scratch ); \
+\
+   result = rb_ary_new2( count ); \
+   for ( pos = 0; pos < number_count; ++pos ) \
+   { \
+      rb_ary_push( result, UINT2NUM( (uint32_t)packed[ pos ] ) ); \
+   } \
+   for ( pos = number_count; pos < count; ++pos ) \
+   { \
+      rb_ary_push( result, LONG2NUM( index[ pos ] ) ); \
+   } \
+\
+   free( scratch ); \
+   free( packed ); \
+   free( native ); \
+   free( index ); \
+\
+   return result; \
+}
+
+TEMPLATE_ARGSORT_PACKED( s32, int32_t, ORDER_KEY_S32 );
+TEMPLATE_ARGSORT_PACKED( f32, float, order_key_f32 );
+
+// 64-bit keys leave no room for a packed index, so their indices are
+// merge sorted by key in scalar code.
+#define  TEMPLATE_ARGSORT_SCALAR( SUFFIX, TYPE ) \
+VALUE method_argsort_##SUFFIX( VALUE self, VALUE data ) \
+{ \
+   long count = 0; \
+   long number_count = 0; \
+   long pos = 0; \
+   long width = 0; \
+   long left = 0; \
+   long right = 0; \
+   long mid = 0; \
+   long end = 0; \
+   long out = 0; \
+   long* index = NULL; \
+   long* source = NULL; \
+   long* target = NULL; \
+   long* swap = NULL; \
+   TYPE* native = NULL; \
+   VALUE result; \
+\
+   Check_Type( data, T_ARRAY ); \
+   count = RARRAY_LEN( data ); \
+\
+   index = (long*)malloc( ( count + 1 ) * sizeof( long ) ); \
+   native = native_copy_##SUFFIX( data, index, &number_count ); \
+   source = (long*)malloc( ( count + 1 ) * sizeof( long ) ); \
+   target = (long*)malloc( ( count + 1 ) * sizeof( long ) ); \
+\
+   /* Positions into 'native' are merged stably, so equal keys stay in */ \
+   /* their original order. */ \
+   for ( pos = 0; pos < number_count; ++pos ) \
+   { \
+      source[ pos ] = pos; \
+   } \
+\
+   for ( width = 1; width < number_count; width *= 2 ) \
+   { \
+      for ( pos = 0; pos < number_count; pos += 2 * width ) \
+      { \
+         mid = ( pos + width < number_count ) ? pos + width : number_count; \
+         end = ( pos + 2 * width < number_count ) ? pos + 2 * width : number_count; \
+         left = pos; \
+         right = mid; \
+         for ( out = pos; out < end; ++out ) \
+         { \
+            if ( ( left < mid ) && ( ( right >= end ) || ( native[ source[ left ] ] <= native[ source[ right ] ] ) ) ) \
+            { \
+               target[ out ] = source[ left++ ]; \
+            } \
+            else \
+            { \
+               target[ out ] = source[ right++ ]; \
+            } \
+         } \
+      } \
+\
+      swap = source; \
+      source = target; \
+      target = swap; \
+   } \
+\
+   result = rb_ary_new2( count ); \
+   for ( pos = 0; pos < number_count; ++pos ) \
+   { \
+      rb_ary_push( result, LONG2NUM( index[ source[ pos ] ] ) ); \
+   } \
+   for ( pos = number_count; pos < count; ++pos ) \
+   { \
+      rb_ary_push( result, LONG2NUM( index[ pos ] ) ); \
+   } \
+\
+   free( target ); \
+   free( source ); \
+   free( native ); \
+   free( index ); \
+\
+   return result; \
+}
+
+TEMPLATE_ARGSORT_SCALAR( s64, int64_t );
+TEMPLATE_ARGSORT_SCALAR( f64, double );
+
+
+#define  MOVEMASK_GT_S32( A, B ) \
+   _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( _mm_castps_si128( A ), _mm_castps_si128( B ) ) ) )
+#define  MOVEMASK_GT_F32( A, B )   _mm_movemask_ps( _mm_cmpgt_ps( A, B ) )
+#define  MOVEMASK_GT_S64( A, B )   _mm_movemask_pd( GT_S64( A, B ) )
+#define  MOVEMASK_GT_F64( A, B )   _mm_movemask_pd( _mm_cmpgt_pd( A, B ) )
+
+#define  SET1_S32( X )   _mm_castsi128_ps( _mm_set1_epi32( X ) )
+#define  SET1_S64( X )   _mm_castsi128_pd( _mm_set1_epi64x( X ) )
+
+// Selection keeps the k best elements seen so far in a min-heap with the
+// worst at the root. Most elements do not beat the root, so a vector
+// compare against it skips whole vectors and only the lanes that pass
+// touch the heap.
+#define  TEMPLATE_TOP_K( SUFFIX, TYPE, EL_PER_VEC, VTYPE, LOADU, SET1, MOVEMASK_GT, CONV_OUT ) \
+struct heap_entry_##SUFFIX { \
+   TYPE value; \
+   long index; \
+}; \
+\
+/* Of equal values, the later index ranks worse. */ \
+static inline int heap_worse_##SUFFIX( const struct heap_entry_##SUFFIX* left, const struct heap_entry_##SUFFIX* right ) \
+{ \
+   return ( left->value < right->value ) || \
+          ( ( left->value == right->value ) && ( left->index > right->index ) ); \
+} \
+\
+static void heap_sift_##SUFFIX( struct heap_entry_##SUFFIX* heap, long count, long pos ) \
+{ \
+   struct heap_entry_##SUFFIX entry = heap[ pos ]; \
+   long child = 0; \
+\
+   while ( ( child = 2 * pos + 1 ) < count ) \
+   { \
+      if ( ( child + 1 < count ) && heap_worse_##SUFFIX( &heap[ child + 1 ], &heap[ child ] ) ) \
+      { \
+         ++child; \
+      } \
+      if ( !heap_worse_##SUFFIX( &heap[ child ], &entry ) ) \
+      { \
+         break; \
+      } \
+      heap[ pos ] = heap[ child ]; \
+      pos = child; \
+   } \
+\
+   heap[ pos ] = entry; \
+} \
+\
+VALUE method_top_k_##SUFFIX( VALUE self, VALUE data, VALUE k_rb ) \
+{ \
+   long k = NUM2LONG( k_rb ); \
+   long count = 0; \
+   long number_count = 0; \
+   long pos = 0; \
+   long size = 0; \
+   int mask = 0; \
+   int lane = 0; \
+   TYPE* native = NULL; \
+   long* index = NULL; \
+   struct heap_entry_##SUFFIX* heap = NULL; \
+   struct heap_entry_##SUFFIX entry; \
+   VALUE values; \
+   VALUE indices; \
+\
+   Check_Type( data, T_ARRAY ); \
+\
+   if ( k < 0 ) \
+   { \
+      rb_raise( rb_eArgError, "k must not be negative" ); \
+   } \
+\
+   count = RARRAY_LEN( data ); \
+   index = (long*)malloc( ( count + 1 ) * sizeof( long ) ); \
+   native = native_copy_##SUFFIX( data, index, &number_count ); \
+\
+   /* Positions below are into the NaN-free prefix of 'native'. */ \
+   size = ( k < number_count ) ? k : number_count; \
+   heap = (struct heap_entry_##SUFFIX*)malloc( ( size + 1 ) * sizeof( *heap ) ); \
+\
+   for ( pos = 0; pos < size; ++pos ) \
+   { \
+      heap[ pos ].value = native[ pos ]; \
+      heap[ pos ].index = pos; \
+   } \
+   for ( pos = size / 2 - 1; pos >= 0; --pos ) \
+   { \
+      heap_sift_##SUFFIX( heap, size, pos ); \
+   } \
+\
+   pos = size; \
+   if ( size > 0 ) \
+   { \
+      for ( ; pos + EL_PER_VEC <= number_count; pos += EL_PER_VEC ) \
+      { \
+         mask = MOVEMASK_GT( LOADU( native + pos ), SET1( heap[ 0 ].value ) ); \
+\
+         for ( lane = 0; mask; ++lane, mask >>= 1 ) \
+         { \
+            /* The root may have risen since the vector compare. */ \
+            if ( ( mask & 1 ) && ( native[ pos + lane ] > heap[ 0 ].value ) ) \
+            { \
+               heap[ 0 ].value = native[ pos + lane ]; \
+               heap[ 0 ].index = pos + lane; \
+               heap_sift_##SUFFIX( heap, size, 0 ); \
+            } \
+         } \
+      } \
+      for ( ; pos < number_count; ++pos ) \
+      { \
+         if ( native[ pos ] > heap[ 0 ].value ) \
+         { \
+            heap[ 0 ].value = native[ pos ]; \
+            heap[ 0 ].index = pos; \
+            heap_sift_##SUFFIX( heap, size, 0 ); \
+         } \
+      } \
+   } \
+\
+   /* Moving the root to the back repeatedly leaves the best first. */ \
+   for ( pos = size - 1; pos > 0; --pos ) \
+   { \
+      entry = heap[ 0 ]; \
+      heap[ 0 ] = heap[ pos ]; \
+      heap[ pos ] = entry; \
+      heap_sift_##SUFFIX( heap, pos, 0 ); \
+   } \
+\
+   values = rb_ary_new2( size ); \
+   indices = rb_ary_new2( size ); \
+   for ( pos = 0; pos < size; ++pos ) \
+   { \
+      rb_ary_push( values, CONV_OUT( heap[ pos ].value ) ); \
+      rb_ary_push( indices, LONG2NUM( index[ heap[ pos ].index ] ) ); \
+   } \
+\
+   free( heap ); \
+   free( native ); \
+   free( index ); \
+\
+   return rb_ary_new3( 2, values, indices ); \
+}
+
+TEMPLATE_TOP_K( s32, int32_t, 4, __m128, LOADU_PS, SET1_S32, MOVEMASK_GT_S32, INT2NUM );
+TEMPLATE_TOP_K( s64, int64_t, 2, __m128d, LOADU_PD, SET1_S64, MOVEMASK_GT_S64, LL2NUM );
+TEMPLATE_TOP_K( f32, float, 4, __m128, LOADU_PS, _mm_set1_ps, MOVEMASK_GT_F32, DBL2NUM );
+TEMPLATE_TOP_K( f64, double, 2, __m128d, LOADU_PD, _mm_set1_pd, MOVEMASK_GT_F64, DBL2NUM );
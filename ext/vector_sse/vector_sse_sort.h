@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_SORT_H
+#define  VECTOR_SSE_SORT_H
+
+#include "ruby.h"
+
+// NaNs sort after every other value and are never selected by top_k.
+
+VALUE method_sort_s32( VALUE self, VALUE data );
+VALUE method_sort_s64( VALUE self, VALUE data );
+VALUE method_sort_f32( VALUE self, VALUE data );
+VALUE method_sort_f64( VALUE self, VALUE data );
+
+// Indices that sort the array. Equal elements keep their original order.
+VALUE method_argsort_s32( VALUE self, VALUE data );
+VALUE method_argsort_s64( VALUE self, VALUE data );
+VALUE method_argsort_f32( VALUE self, VALUE data );
+VALUE method_argsort_f64( VALUE self, VALUE data );
+
+// The k largest elements in descending order and their indices, as
+// [ values, indices ]. Of equal elements, the earlier ones are kept.
+VALUE method_top_k_s32( VALUE self, VALUE data, VALUE k_rb );
+VALUE method_top_k_s64( VALUE self, VALUE data, VALUE k_rb );
+VALUE method_top_k_f32( VALUE self, VALUE data, VALUE k_rb );
+VALUE method_top_k_f64( VALUE self, VALUE data, VALUE k_rb );
+
+#endif // VECTOR_SSE_SORT_H
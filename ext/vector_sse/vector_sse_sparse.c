@@ -0,0 +1,566 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "vector_sse_sparse.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_tuning.h"
+
+#define  GATHER_F32( BASE, INDICES ) \
+   _mm_set_ps( BASE[ (INDICES)[ 3 ] ], BASE[ (INDICES)[ 2 ] ], BASE[ (INDICES)[ 1 ] ], BASE[ (INDICES)[ 0 ] ] )
+#define  GATHER_F64( BASE, INDICES ) \
+   _mm_set_pd( BASE[ (INDICES)[ 1 ] ], BASE[ (INDICES)[ 0 ] ] )
+
+struct csr_view {
+   const void*     values;
+   const uint32_t* col_indices;
+   const uint32_t* row_ptr;
+   uint32_t        rows;
+   uint32_t        cols;
+};
+
+static int compare_column( const void* left, const void* right )
+{
+   uint32_t left_col  = *(const uint32_t*)left;
+   uint32_t right_col = *(const uint32_t*)right;
+
+   return ( left_col > right_col ) - ( left_col < right_col );
+}
+
+// Validates the three CSR Strings against each other and against 'cols',
+// and returns a native view of them. The raw singleton methods take these
+// Strings from any caller, so every column index is checked here.
+static struct csr_view csr_view_of( VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, size_t value_size )
+{
+   struct csr_view view;
+   uint32_t nnz = 0;
+   uint32_t pos = 0;
+
+   Check_Type( values, T_STRING );
+   Check_Type( col_indices, T_STRING );
+   Check_Type( row_ptr, T_STRING );
+
+   if ( ( RSTRING_LEN( row_ptr ) < (long)sizeof( uint32_t ) ) ||
+        ( RSTRING_LEN( row_ptr ) % sizeof( uint32_t ) != 0 ) )
+   {
+      rb_raise( rb_eArgError, "invalid CSR row pointer" );
+   }
+
+   view.values      = RSTRING_PTR( values );
+   view.col_indices = (const uint32_t*)RSTRING_PTR( col_indices );
+   view.row_ptr     = (const uint32_t*)RSTRING_PTR( row_ptr );
+   view.rows        = RSTRING_LEN( row_ptr ) / sizeof( uint32_t ) - 1;
+   view.cols        = NUM2UINT( cols_rb );
+
+   nnz = view.row_ptr[ view.rows ];
+   if ( ( view.row_ptr[ 0 ] != 0 ) ||
+        ( RSTRING_LEN( values ) != (long)( nnz * value_size ) ) ||
+        ( RSTRING_LEN( col_indices ) != (long)( nnz * sizeof( uint32_t ) ) ) )
+   {
+      rb_raise( rb_eArgError, "CSR arrays do not match" );
+   }
+
+   for ( nnz = 0; nnz < view.rows; ++nnz )
+   {
+      if ( view.row_ptr[ nnz ] > view.row_ptr[ nnz + 1 ] )
+      {
+         rb_raise( rb_eArgError, "invalid CSR row pointer" );
+      }
+   }
+
+   for ( pos = 0; pos < view.row_ptr[ view.rows ]; ++pos )
+   {
+      if ( view.col_indices[ pos ] >= view.cols )
+      {
+         rb_raise( rb_eArgError, "CSR column index out of bounds" );
+      }
+   }
+
+   return view;
+}
+
+// Number of row chunks to split 'work' multiply-adds across. Smaller
+// products run on the calling thread only.
+static uint32_t csr_chunks( uint64_t work )
+{
+   uint64_t chunks = work / vector_sse_tuning.sparse_work_per_thread;
+   uint32_t threads = parallel_thread_count();
+
+   if ( chunks < 1 )
+   {
+      return 1;
+   }
+
+   return ( chunks > threads ) ? threads : (uint32_t)chunks;
+}
+
+
+#define  TEMPLATE_SPARSE_S( SUFFIX, TYPE, EL_PER_VEC, VTYPE, LOADU, STOREU, SETZERO, SET1, ADD, MUL, CMPEQ, MOVEMASK, GATHER ) \
+struct csr_entry_##SUFFIX { \
+   uint32_t col; \
+   TYPE     value; \
+}; \
+\
+static VALUE csr_result_##SUFFIX( const TYPE* values, const uint32_t* col_indices, const uint32_t* row_ptr, uint32_t rows ) \
+{ \
+   uint32_t nnz = row_ptr[ rows ]; \
+\
+   return rb_ary_new3( 3, \
+      rb_str_new( (const char*)values, nnz * sizeof( TYPE ) ), \
+      rb_str_new( (const char*)col_indices, nnz * sizeof( uint32_t ) ), \
+      rb_str_new( (const char*)row_ptr, ( rows + 1 ) * sizeof( uint32_t ) ) ); \
+} \
+\
+/* Builds a CSR matrix from (row, col, value) triples in any order. */ \
+/* Duplicate coordinates are summed. */ \
+VALUE method_csr_from_coo_##SUFFIX( VALUE self, VALUE rows_rb, VALUE cols_rb, VALUE row_indices, VALUE col_indices, VALUE values ) \
+{ \
+   uint32_t rows = NUM2UINT( rows_rb ); \
+   uint32_t cols = NUM2UINT( cols_rb ); \
+   uint32_t count = 0; \
+   uint32_t pos = 0; \
+   uint32_t row = 0; \
+   uint32_t entry = 0; \
+   uint32_t kept = 0; \
+   long long row_index = 0; \
+   long long col_index = 0; \
+\
+   uint32_t* row_of = NULL; \
+   uint32_t* row_ptr = NULL; \
+   uint32_t* next = NULL; \
+   uint32_t* out_cols = NULL; \
+   TYPE* out_values = NULL; \
+   struct csr_entry_##SUFFIX* entries = NULL; \
+   VALUE result; \
+\
+   Check_Type( row_indices, T_ARRAY ); \
+   Check_Type( col_indices, T_ARRAY ); \
+   Check_Type( values, T_ARRAY ); \
+\
+   if ( ( RARRAY_LEN( row_indices ) != RARRAY_LEN( values ) ) || \
+        ( RARRAY_LEN( col_indices ) != RARRAY_LEN( values ) ) ) \
+   { \
+      rb_raise( rb_eArgError, "COO arrays must have the same length" ); \
+   } \
+   if ( RARRAY_LEN( values ) > UINT32_MAX ) \
+   { \
+      rb_raise( rb_eArgError, "too many nonzeros" ); \
+   } \
+   count = RARRAY_LEN( values ); \
+\
+   row_of  = (uint32_t*)malloc( ( count + 1 ) * sizeof( uint32_t ) ); \
+   row_ptr = (uint32_t*)calloc( rows + 1, sizeof( uint32_t ) ); \
+   next    = (uint32_t*)malloc( ( rows + 1 ) * sizeof( uint32_t ) ); \
+   entries = (struct csr_entry_##SUFFIX*)malloc( ( count + 1 ) * sizeof( struct csr_entry_##SUFFIX ) ); \
+\
+   /* Counting sort by row, keeping the input order within each row. */ \
+   for ( pos = 0; pos < count; ++pos ) \
+   { \
+      row_index = NUM2LL( rb_ary_entry( row_indices, pos ) ); \
+      if ( ( row_index < 0 ) || ( row_index >= rows ) ) \
+      { \
+         free( row_of ); free( row_ptr ); free( next ); free( entries ); \
+         rb_raise( rb_eIndexError, "row index %lld out of bounds", row_index ); \
+      } \
+      row_of[ pos ] = (uint32_t)row_index; \
+      row_ptr[ row_index + 1 ]++; \
+   } \
+\
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      row_ptr[ row + 1 ] += row_ptr[ row ]; \
+   } \
+   memcpy( next, row_ptr, ( rows + 1 ) * sizeof( uint32_t ) ); \
+\
+   for ( pos = 0; pos < count; ++pos ) \
+   { \
+      col_index = NUM2LL( rb_ary_entry( col_indices, pos ) ); \
+      if ( ( col_index < 0 ) || ( col_index >= cols ) ) \
+      { \
+         free( row_of ); free( row_ptr ); free( next ); free( entries ); \
+         rb_raise( rb_eIndexError, "column index %lld out of bounds", col_index ); \
+      } \
+      entry = next[ row_of[ pos ] ]++; \
+      entries[ entry ].col   = (uint32_t)col_index; \
+      entries[ entry ].value = (TYPE)NUM2DBL( rb_ary_entry( values, pos ) ); \
+   } \
+\
+   /* Sort each row by column and fold duplicates together in place. */ \
+   out_cols   = row_of; \
+   out_values = (TYPE*)malloc( ( count + 1 ) * sizeof( TYPE ) ); \
+   kept = 0; \
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      uint32_t row_begin = row_ptr[ row ]; \
+      uint32_t row_end   = row_ptr[ row + 1 ]; \
+\
+      qsort( entries + row_begin, row_end - row_begin, sizeof( struct csr_entry_##SUFFIX ), compare_column ); \
+\
+      row_ptr[ row ] = kept; \
+      for ( entry = row_begin; entry < row_end; ++entry ) \
+      { \
+         if ( ( kept > row_ptr[ row ] ) && ( out_cols[ kept - 1 ] == entries[ entry ].col ) ) \
+         { \
+            out_values[ kept - 1 ] += entries[ entry ].value; \
+         } \
+         else \
+         { \
+            out_cols[ kept ]   = entries[ entry ].col; \
+            out_values[ kept ] = entries[ entry ].value; \
+            kept++; \
+         } \
+      } \
+   } \
+   row_ptr[ rows ] = kept; \
+\
+   result = csr_result_##SUFFIX( out_values, out_cols, row_ptr, rows ); \
+\
+   free( row_of ); \
+   free( row_ptr ); \
+   free( next ); \
+   free( entries ); \
+   free( out_values ); \
+\
+   return result; \
+} \
+\
+/* Builds a CSR matrix from row-major dense data, dropping zeros. */ \
+VALUE method_csr_from_dense_##SUFFIX( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb ) \
+{ \
+   uint32_t rows = NUM2UINT( rows_rb ); \
+   uint32_t cols = NUM2UINT( cols_rb ); \
+   uint32_t row = 0; \
+   uint32_t col = 0; \
+   uint32_t nnz = 0; \
+   uint64_t length = (uint64_t)rows * cols; \
+   uint64_t pos = 0; \
+   int zero_mask = 0; \
+\
+   TYPE* dense = NULL; \
+   TYPE* values = NULL; \
+   uint32_t* col_indices = NULL; \
+   uint32_t* row_ptr = NULL; \
+   VALUE result; \
+\
+   Check_Type( data, T_ARRAY ); \
+   if ( (uint64_t)RARRAY_LEN( data ) != length ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   dense   = (TYPE*)malloc( ( length + 1 ) * sizeof( TYPE ) ); \
+   row_ptr = (uint32_t*)malloc( ( rows + 1 ) * sizeof( uint32_t ) ); \
+\
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      dense[ pos ] = (TYPE)NUM2DBL( rb_ary_entry( data, pos ) ); \
+   } \
+\
+   /* Count the nonzeros of each row a vector at a time. */ \
+   row_ptr[ 0 ] = 0; \
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      const TYPE* dense_row = dense + (uint64_t)row * cols; \
+\
+      for ( col = 0; col + EL_PER_VEC <= cols; col += EL_PER_VEC ) \
+      { \
+         zero_mask = MOVEMASK( CMPEQ( LOADU( dense_row + col ), SETZERO() ) ); \
+         nnz += EL_PER_VEC - __builtin_popcount( zero_mask ); \
+      } \
+      for ( ; col < cols; ++col ) \
+      { \
+         nnz += ( dense_row[ col ] != 0 ); \
+      } \
+      row_ptr[ row + 1 ] = nnz; \
+   } \
+\
+   values      = (TYPE*)malloc( ( nnz + 1 ) * sizeof( TYPE ) ); \
+   col_indices = (uint32_t*)malloc( ( nnz + 1 ) * sizeof( uint32_t ) ); \
+\
+   nnz = 0; \
+   for ( row = 0; row < rows; ++row ) \
+   { \
+      const TYPE* dense_row = dense + (uint64_t)row * cols; \
+\
+      for ( col = 0; col < cols; ++col ) \
+      { \
+         if ( dense_row[ col ] != 0 ) \
+         { \
+            values[ nnz ]      = dense_row[ col ]; \
+            col_indices[ nnz ] = col; \
+            nnz++; \
+         } \
+      } \
+   } \
+\
+   result = csr_result_##SUFFIX( values, col_indices, row_ptr, rows ); \
+\
+   free( dense ); \
+   free( values ); \
+   free( col_indices ); \
+   free( row_ptr ); \
+\
+   return result; \
+} \
+\
+VALUE method_csr_to_dense_##SUFFIX( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb ) \
+{ \
+   struct csr_view view = csr_view_of( values, col_indices, row_ptr, cols_rb, sizeof( TYPE ) ); \
+   const TYPE* nonzeros = (const TYPE*)view.values; \
+   uint64_t length = (uint64_t)view.rows * view.cols; \
+   uint64_t pos = 0; \
+   uint32_t row = 0; \
+   uint32_t entry = 0; \
+\
+   TYPE* dense = (TYPE*)calloc( length + 1, sizeof( TYPE ) ); \
+   VALUE result = rb_ary_new2( length ); \
+\
+   for ( row = 0; row < view.rows; ++row ) \
+   { \
+      for ( entry = view.row_ptr[ row ]; entry < view.row_ptr[ row + 1 ]; ++entry ) \
+      { \
+         dense[ (uint64_t)row * view.cols + view.col_indices[ entry ] ] = nonzeros[ entry ]; \
+      } \
+   } \
+\
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( dense[ pos ] ) ); \
+   } \
+\
+   free( dense ); \
+\
+   return result; \
+} \
+\
+struct spmv_context_##SUFFIX { \
+   struct csr_view view; \
+   const TYPE*     vector; \
+   TYPE*           output; \
+}; \
+\
+/* y[row] = sum of values[k] * x[col_indices[k]] over the row's nonzeros. */ \
+/* The x operands of each vector of nonzeros are gathered lane by lane. */ \
+static void spmv_rows_##SUFFIX( void* arg, uint32_t begin, uint32_t end ) \
+{ \
+   struct spmv_context_##SUFFIX* context = (struct spmv_context_##SUFFIX*)arg; \
+   const TYPE* values = (const TYPE*)context->view.values; \
+   const uint32_t* col_indices = context->view.col_indices; \
+   const uint32_t* row_ptr = context->view.row_ptr; \
+   const TYPE* vector = context->vector; \
+   uint32_t row = 0; \
+   uint32_t entry = 0; \
+   uint32_t lane = 0; \
+\
+   TYPE lanes[ EL_PER_VEC ]; \
+   TYPE sum = 0; \
+   VTYPE acc_vec; \
+\
+   for ( row = begin; row < end; ++row ) \
+   { \
+      acc_vec = SETZERO(); \
+      for ( entry = row_ptr[ row ]; entry + EL_PER_VEC <= row_ptr[ row + 1 ]; entry += EL_PER_VEC ) \
+      { \
+         acc_vec = ADD( acc_vec, MUL( LOADU( values + entry ), GATHER( vector, col_indices + entry ) ) ); \
+      } \
+\
+      STOREU( lanes, acc_vec ); \
+      sum = 0; \
+      for ( lane = 0; lane < EL_PER_VEC; ++lane ) \
+      { \
+         sum += lanes[ lane ]; \
+      } \
+      for ( ; entry < row_ptr[ row + 1 ]; ++entry ) \
+      { \
+         sum += values[ entry ] * vector[ col_indices[ entry ] ]; \
+      } \
+\
+      context->output[ row ] = sum; \
+   } \
+} \
+\
+VALUE method_spmv_##SUFFIX( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, VALUE vector ) \
+{ \
+   struct spmv_context_##SUFFIX context; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t chunks = 0; \
+   uint32_t pos = 0; \
+\
+   TYPE* vector_native = NULL; \
+   TYPE* output = NULL; \
+   VALUE result; \
+\
+   context.view = csr_view_of( values, col_indices, row_ptr, cols_rb, sizeof( TYPE ) ); \
+\
+   Check_Type( vector, T_ARRAY ); \
+   if ( RARRAY_LEN( vector ) != context.view.cols ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   vector_native = (TYPE*)malloc( ( context.view.cols + 1 ) * sizeof( TYPE ) ); \
+   output = (TYPE*)malloc( ( context.view.rows + 1 ) * sizeof( TYPE ) ); \
+\
+   for ( pos = 0; pos < context.view.cols; ++pos ) \
+   { \
+      vector_native[ pos ] = (TYPE)NUM2DBL( rb_ary_entry( vector, pos ) ); \
+   } \
+\
+   context.vector = vector_native; \
+   context.output = output; \
+\
+   chunks = parallel_partition( context.view.row_ptr, context.view.rows, \
+      csr_chunks( context.view.row_ptr[ context.view.rows ] ), bounds ); \
+   parallel_run( spmv_rows_##SUFFIX, &context, bounds, chunks ); \
+\
+   result = rb_ary_new2( context.view.rows ); \
+   for ( pos = 0; pos < context.view.rows; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( output[ pos ] ) ); \
+   } \
+\
+   free( vector_native ); \
+   free( output ); \
+\
+   return result; \
+} \
+\
+struct spmm_context_##SUFFIX { \
+   struct csr_view view; \
+   const TYPE*     dense; \
+   uint32_t        dense_cols; \
+   TYPE*           output; \
+}; \
+\
+/* Each nonzero scales one dense row into the output row, so the inner */ \
+/* loop runs over contiguous dense columns. */ \
+static void spmm_rows_##SUFFIX( void* arg, uint32_t begin, uint32_t end ) \
+{ \
+   struct spmm_context_##SUFFIX* context = (struct spmm_context_##SUFFIX*)arg; \
+   const TYPE* values = (const TYPE*)context->view.values; \
+   const uint32_t* col_indices = context->view.col_indices; \
+   const uint32_t* row_ptr = context->view.row_ptr; \
+   uint32_t dense_cols = context->dense_cols; \
+   uint32_t row = 0; \
+   uint32_t entry = 0; \
+   uint32_t col = 0; \
+\
+   TYPE* output_row = NULL; \
+   const TYPE* dense_row = NULL; \
+   VTYPE scale_vec; \
+\
+   for ( row = begin; row < end; ++row ) \
+   { \
+      output_row = context->output + (uint64_t)row * dense_cols; \
+      memset( output_row, 0, dense_cols * sizeof( TYPE ) ); \
+\
+      for ( entry = row_ptr[ row ]; entry < row_ptr[ row + 1 ]; ++entry ) \
+      { \
+         dense_row = context->dense + (uint64_t)col_indices[ entry ] * dense_cols; \
+         scale_vec = SET1( values[ entry ] ); \
+\
+         for ( col = 0; col + EL_PER_VEC <= dense_cols; col += EL_PER_VEC ) \
+         { \
+            STOREU( output_row + col, ADD( LOADU( output_row + col ), MUL( scale_vec, LOADU( dense_row + col ) ) ) ); \
+         } \
+         for ( ; col < dense_cols; ++col ) \
+         { \
+            output_row[ col ] += values[ entry ] * dense_row[ col ]; \
+         } \
+      } \
+   } \
+} \
+\
+VALUE method_spmm_##SUFFIX( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, VALUE dense, VALUE dense_cols_rb ) \
+{ \
+   struct spmm_context_##SUFFIX context; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t chunks = 0; \
+   uint64_t length = 0; \
+   uint64_t pos = 0; \
+\
+   TYPE* dense_native = NULL; \
+   TYPE* output = NULL; \
+   VALUE result; \
+\
+   context.view = csr_view_of( values, col_indices, row_ptr, cols_rb, sizeof( TYPE ) ); \
+   context.dense_cols = NUM2UINT( dense_cols_rb ); \
+\
+   Check_Type( dense, T_ARRAY ); \
+   length = (uint64_t)context.view.cols * context.dense_cols; \
+   if ( (uint64_t)RARRAY_LEN( dense ) != length ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+\
+   dense_native = (TYPE*)malloc( ( length + 1 ) * sizeof( TYPE ) ); \
+   output = (TYPE*)malloc( ( (uint64_t)context.view.rows * context.dense_cols + 1 ) * sizeof( TYPE ) ); \
+\
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      dense_native[ pos ] = (TYPE)NUM2DBL( rb_ary_entry( dense, pos ) ); \
+   } \
+\
+   context.dense  = dense_native; \
+   context.output = output; \
+\
+   chunks = parallel_partition( context.view.row_ptr, context.view.rows, \
+      csr_chunks( (uint64_t)context.view.row_ptr[ context.view.rows ] * context.dense_cols ), bounds ); \
+   parallel_run( spmm_rows_##SUFFIX, &context, bounds, chunks ); \
+\
+   length = (uint64_t)context.view.rows * context.dense_cols; \
+   result = rb_ary_new2( length ); \
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      rb_ary_push( result, DBL2NUM( output[ pos ] ) ); \
+   } \
+\
+   free( dense_native ); \
+   free( output ); \
+\
+   return result; \
+}
+
+TEMPLATE_SPARSE_S(
+   f32, float, 4, __m128,
+   _mm_loadu_ps, _mm_storeu_ps,
+   _mm_setzero_ps, _mm_set1_ps,
+   _mm_add_ps, _mm_mul_ps,
+   _mm_cmpeq_ps, _mm_movemask_ps, GATHER_F32 );
+TEMPLATE_SPARSE_S(
+   f64, double, 2, __m128d,
+   _mm_loadu_pd, _mm_storeu_pd,
+   _mm_setzero_pd, _mm_set1_pd,
+   _mm_add_pd, _mm_mul_pd,
+   _mm_cmpeq_pd, _mm_movemask_pd, GATHER_F64 );
@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_SPARSE_H
+#define  VECTOR_SSE_SPARSE_H
+
+#include "ruby.h"
+
+// A CSR matrix is held by Ruby as three binary Strings: the nonzero values
+// (native f32 or f64), their column indices (uint32) and the row pointer
+// (uint32, rows + 1 entries).
+
+VALUE method_csr_from_coo_f32( VALUE self, VALUE rows_rb, VALUE cols_rb, VALUE row_indices, VALUE col_indices, VALUE values );
+VALUE method_csr_from_coo_f64( VALUE self, VALUE rows_rb, VALUE cols_rb, VALUE row_indices, VALUE col_indices, VALUE values );
+
+VALUE method_csr_from_dense_f32( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb );
+VALUE method_csr_from_dense_f64( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb );
+
+VALUE method_csr_to_dense_f32( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb );
+VALUE method_csr_to_dense_f64( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb );
+
+VALUE method_spmv_f32( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, VALUE vector );
+VALUE method_spmv_f64( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, VALUE vector );
+
+VALUE method_spmm_f32( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, VALUE dense, VALUE dense_cols_rb );
+VALUE method_spmm_f64( VALUE self, VALUE values, VALUE col_indices, VALUE row_ptr, VALUE cols_rb, VALUE dense, VALUE dense_cols_rb );
+
+#endif // VECTOR_SSE_SPARSE_H
@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdlib.h>
+#include <math.h>
+#include "vector_sse_syrk.h"
+#include "vector_sse_gemm.h"
+#include "vector_sse_parallel.h"
+#include "vector_sse_tuning.h"
+
+// Rows of the result each GEMM call updates.
+#define  SYRK_TILE   (64)
+
+// The upper triangle of G = X^T X is computed as tiles of SYRK_TILE rows.
+// Tile t covers rows [t * SYRK_TILE, ...) from the diagonal rightwards, so
+// only the small triangle below the diagonal of each tile is wasted.
+//
+// X is consumed in panels of rows. For each panel, a thread transposes the
+// few columns belonging to its tile into a small packed buffer, which
+// becomes the A operand; the panel itself is the B operand in place. X is
+// therefore only ever read row by row.
+#define  TEMPLATE_SYRK( SUFFIX, TYPE, GEMM_SERIAL, BLOCK_K ) \
+struct syrk_context_##SUFFIX { \
+   uint32_t    rows; \
+   uint32_t    cols; \
+   uint32_t    panel; \
+   const TYPE* x; \
+   TYPE*       g; \
+}; \
+\
+static void syrk_tiles_##SUFFIX( void* context, uint32_t begin, uint32_t end ) \
+{ \
+   const struct syrk_context_##SUFFIX* ctx = (const struct syrk_context_##SUFFIX*)context; \
+   TYPE* packed = (TYPE*)malloc( (uint64_t)SYRK_TILE * ctx->panel * sizeof( TYPE ) ); \
+   const TYPE* source = NULL; \
+   uint32_t tile = 0; \
+   uint32_t start = 0; \
+   uint32_t height = 0; \
+   uint32_t first = 0; \
+   uint32_t depth = 0; \
+   uint32_t row = 0; \
+   uint32_t col = 0; \
+\
+   for ( tile = begin; tile < end; ++tile ) \
+   { \
+      start = tile * SYRK_TILE; \
+      height = ( ctx->cols - start < SYRK_TILE ) ? ctx->cols - start : SYRK_TILE; \
+\
+      for ( first = 0; first < ctx->rows; first += depth ) \
+      { \
+         depth = ( ctx->rows - first < ctx->panel ) ? ctx->rows - first : ctx->panel; \
+\
+         for ( row = 0; row < depth; ++row ) \
+         { \
+            source = ctx->x + (uint64_t)( first + row ) * ctx->cols + start; \
+            for ( col = 0; col < height; ++col ) \
+            { \
+               packed[ col * depth + row ] = source[ col ]; \
+            } \
+         } \
+\
+         GEMM_SERIAL( height, ctx->cols - start, depth, 1, packed, depth, \
+            ctx->x + (uint64_t)first * ctx->cols + start, ctx->cols, \
+            ctx->g + (uint64_t)start * ctx->cols + start, ctx->cols ); \
+      } \
+   } \
+\
+   free( packed ); \
+} \
+\
+/* g (cols x cols, zeroed) = x^T x, filling the lower triangle by mirroring. */ \
+static void syrk_##SUFFIX( uint32_t rows, uint32_t cols, const TYPE* x, TYPE* g ) \
+{ \
+   struct syrk_context_##SUFFIX ctx; \
+   uint32_t bounds[ PARALLEL_MAX_THREADS + 1 ]; \
+   uint32_t tiles = ( cols + SYRK_TILE - 1 ) / SYRK_TILE; \
+   uint32_t* prefix = (uint32_t*)malloc( ( tiles + 1 ) * sizeof( uint32_t ) ); \
+   uint64_t chunks = (uint64_t)rows * cols * cols / 2 / vector_sse_tuning.gemm_work_per_thread; \
+   uint32_t threads = parallel_thread_count(); \
+   uint32_t tile = 0; \
+   uint32_t row = 0; \
+   uint32_t col = 0; \
+\
+   ctx.rows = rows; \
+   ctx.cols = cols; \
+   ctx.panel = BLOCK_K; \
+   ctx.x = x; \
+   ctx.g = g; \
+\
+   /* Each tile's work is proportional to its width right of the diagonal. */ \
+   prefix[ 0 ] = 0; \
+   for ( tile = 0; tile < tiles; ++tile ) \
+   { \
+      prefix[ tile + 1 ] = prefix[ tile ] + ( cols - tile * SYRK_TILE ); \
+   } \
+\
+   chunks = ( chunks > threads ) ? threads : chunks; \
+   chunks = ( chunks > tiles ) ? tiles : chunks; \
+   chunks = parallel_partition( prefix, tiles, ( chunks > 0 ) ? (uint32_t)chunks : 1, bounds ); \
+   parallel_run( syrk_tiles_##SUFFIX, &ctx, bounds, (uint32_t)chunks ); \
+\
+   for ( row = 0; row < cols; ++row ) \
+   { \
+      for ( col = row + 1; col < cols; ++col ) \
+      { \
+         g[ (uint64_t)col * cols + row ] = g[ (uint64_t)row * cols + col ]; \
+      } \
+   } \
+\
+   free( prefix ); \
+} \
+\
+VALUE method_gram_##SUFFIX( VALUE self, VALUE data, VALUE rows_rb, VALUE cols_rb, VALUE mode_rb, VALUE ddof_rb ) \
+{ \
+   uint32_t rows = NUM2UINT( rows_rb ); \
+   uint32_t cols = NUM2UINT( cols_rb ); \
+   int mode = NUM2INT( mode_rb ); \
+   long ddof = NUM2LONG( ddof_rb ); \
+   uint64_t length = (uint64_t)rows * cols; \
+   uint64_t pos = 0; \
+   uint32_t row = 0; \
+   uint32_t col = 0; \
+   double* means = NULL; \
+   double* variances = NULL; \
+   double divisor = 1.0; \
+   double value = 0.0; \
+   TYPE* x = NULL; \
+   TYPE* g = NULL; \
+   VALUE result; \
+\
+   Check_Type( data, T_ARRAY ); \
+\
+   if ( length != (uint64_t)RARRAY_LEN( data ) ) \
+   { \
+      rb_raise( rb_eRuntimeError, "Vector length does not match dimensions" ); \
+   } \
+   if ( ( mode < GRAM_MODE_GRAM ) || ( mode > GRAM_MODE_CORRELATION ) ) \
+   { \
+      rb_raise( rb_eArgError, "invalid Gram matrix mode" ); \
+   } \
+   if ( ( mode != GRAM_MODE_GRAM ) && ( (long)rows - ddof <= 0 ) ) \
+   { \
+      rb_raise( rb_eArgError, "ddof must be less than the number of rows" ); \
+   } \
+\
+   x = (TYPE*)malloc( ( length + 1 ) * sizeof( TYPE ) ); \
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      x[ pos ] = NUM2DBL( rb_ary_entry( data, pos ) ); \
+   } \
+\
+   /* Centre each column on its mean, accumulated in double precision. */ \
+   if ( mode != GRAM_MODE_GRAM ) \
+   { \
+      means = (double*)calloc( cols, sizeof( double ) ); \
+      for ( row = 0; row < rows; ++row ) \
+      { \
+         for ( col = 0; col < cols; ++col ) \
+         { \
+            means[ col ] += x[ (uint64_t)row * cols + col ]; \
+         } \
+      } \
+      for ( row = 0; row < rows; ++row ) \
+      { \
+         for ( col = 0; col < cols; ++col ) \
+         { \
+            x[ (uint64_t)row * cols + col ] -= means[ col ] / rows; \
+         } \
+      } \
+      free( means ); \
+      divisor = (double)( (long)rows - ddof ); \
+   } \
+\
+   g = (TYPE*)calloc( (uint64_t)cols * cols, sizeof( TYPE ) ); \
+   syrk_##SUFFIX( rows, cols, x, g ); \
+\
+   if ( mode == GRAM_MODE_CORRELATION ) \
+   { \
+      variances = (double*)malloc( cols * sizeof( double ) ); \
+      for ( col = 0; col < cols; ++col ) \
+      { \
+         variances[ col ] = g[ (uint64_t)col * cols + col ]; \
+      } \
+   } \
+\
+   result = rb_ary_new2( (uint64_t)cols * cols ); \
+   for ( row = 0; row < cols; ++row ) \
+   { \
+      for ( col = 0; col < cols; ++col ) \
+      { \
+         value = g[ (uint64_t)row * cols + col ]; \
+         if ( variances ) \
+         { \
+            /* Rounding can push the ratio just past one. */ \
+            value /= sqrt( variances[ row ] * variances[ col ] ); \
+            value = ( value > 1.0 ) ? 1.0 : ( value < -1.0 ) ? -1.0 : value; \
+         } \
+         else \
+         { \
+            value /= divisor; \
+         } \
+         rb_ary_push( result, DBL2NUM( (TYPE)value ) ); \
+      } \
+   } \
+\
+   free( variances ); \
+   free( g ); \
+   free( x ); \
+\
+   return result; \
+}
+
+TEMPLATE_SYRK( f32, float, gemm_f32_serial, vector_sse_tuning.gemm_f32_block_k );
+TEMPLATE_SYRK( f64, double, gemm_f64_serial, vector_sse_tuning.gemm_f64_block_k );
@@ -0,0 +1,298 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "vector_sse_tuning.h"
+#include "vector_sse_convert.h"
+#include "vector_sse_gemm.h"
+
+#define  TUNING_DEFAULTS   { 256, 512, 256, 512, 1 << 20, 1 << 15 }
+
+struct vector_sse_tuning vector_sse_tuning = TUNING_DEFAULTS;
+
+struct tuning_parameter {
+   const char* name;
+   size_t      offset;
+   uint32_t    min;
+   uint32_t    max;
+   uint32_t    multiple;
+};
+
+// Column blocks stay a multiple of the micro-kernel width so that only the
+// last block has scalar leftovers.
+static const struct tuning_parameter parameters[] = {
+   { "gemm_f32_block_k", offsetof( struct vector_sse_tuning, gemm_f32_block_k ), 16, 4096, 1 },
+   { "gemm_f32_block_n", offsetof( struct vector_sse_tuning, gemm_f32_block_n ), 8, 8192, 8 },
+   { "gemm_f64_block_k", offsetof( struct vector_sse_tuning, gemm_f64_block_k ), 16, 4096, 1 },
+   { "gemm_f64_block_n", offsetof( struct vector_sse_tuning, gemm_f64_block_n ), 8, 8192, 8 },
+   { "gemm_work_per_thread", offsetof( struct vector_sse_tuning, gemm_work_per_thread ), 1, UINT32_MAX, 1 },
+   { "sparse_work_per_thread", offsetof( struct vector_sse_tuning, sparse_work_per_thread ), 1, UINT32_MAX, 1 },
+};
+
+#define  PARAMETER_COUNT   ( sizeof( parameters ) / sizeof( parameters[ 0 ] ) )
+
+static uint32_t* parameter_value( struct vector_sse_tuning* tuning, const struct tuning_parameter* parameter )
+{
+   return (uint32_t*)( (char*)tuning + parameter->offset );
+}
+
+static const struct tuning_parameter* find_parameter( const char* name )
+{
+   size_t index = 0;
+
+   for ( index = 0; index < PARAMETER_COUNT; ++index )
+   {
+      if ( strcmp( parameters[ index ].name, name ) == 0 )
+      {
+         return &parameters[ index ];
+      }
+   }
+
+   return NULL;
+}
+
+static int valid_value( const struct tuning_parameter* parameter, unsigned long long value )
+{
+   return ( value >= parameter->min ) && ( value <= parameter->max ) &&
+          ( value % parameter->multiple == 0 );
+}
+
+// Applies "name value" lines, skipping blank lines, '#' comments and
+// anything that does not name a parameter with a valid value. Returns
+// zero if the file cannot be opened.
+static int load_profile( const char* path )
+{
+   char line[ 256 ];
+   char name[ 64 ];
+   unsigned long long value = 0;
+   const struct tuning_parameter* parameter = NULL;
+   FILE* file = fopen( path, "r" );
+
+   if ( file == NULL )
+   {
+      return 0;
+   }
+
+   while ( fgets( line, sizeof( line ), file ) )
+   {
+      if ( ( line[ 0 ] == '#' ) || ( sscanf( line, "%63s %llu", name, &value ) != 2 ) )
+      {
+         continue;
+      }
+
+      parameter = find_parameter( name );
+      if ( parameter && valid_value( parameter, value ) )
+      {
+         *parameter_value( &vector_sse_tuning, parameter ) = (uint32_t)value;
+      }
+   }
+
+   fclose( file );
+
+   return 1;
+}
+
+void tuning_load_default_profile( void )
+{
+   char path[ 4096 ];
+   const char* home = NULL;
+   const char* profile = getenv( "VECTOR_SSE_PROFILE" );
+
+   if ( profile && profile[ 0 ] )
+   {
+      load_profile( profile );
+      return;
+   }
+
+   home = getenv( "HOME" );
+   if ( home && ( snprintf( path, sizeof( path ), "%s/.vector_sse_profile", home ) < (int)sizeof( path ) ) )
+   {
+      load_profile( path );
+   }
+}
+
+VALUE method_get_tuning( VALUE self )
+{
+   size_t index = 0;
+   VALUE settings = rb_hash_new();
+
+   for ( index = 0; index < PARAMETER_COUNT; ++index )
+   {
+      rb_hash_aset( settings, ID2SYM( rb_intern( parameters[ index ].name ) ),
+         UINT2NUM( *parameter_value( &vector_sse_tuning, &parameters[ index ] ) ) );
+   }
+
+   return settings;
+}
+
+// Checks one setting and stores it in the pending tuning passed as 'arg'.
+static int set_parameter( VALUE key, VALUE value, VALUE arg )
+{
+   const struct tuning_parameter* parameter = NULL;
+   unsigned long long number = 0;
+
+   if ( SYMBOL_P( key ) )
+   {
+      key = rb_sym2str( key );
+   }
+   parameter = find_parameter( StringValueCStr( key ) );
+
+   if ( parameter == NULL )
+   {
+      rb_raise( rb_eArgError, "unknown tuning parameter %s", StringValueCStr( key ) );
+   }
+
+   number = NUM2ULL( value );
+   if ( !valid_value( parameter, number ) )
+   {
+      rb_raise( rb_eArgError, "invalid value %llu for tuning parameter %s", number, parameter->name );
+   }
+
+   *parameter_value( (struct vector_sse_tuning*)arg, parameter ) = (uint32_t)number;
+
+   return ST_CONTINUE;
+}
+
+// Sets the parameters named in 'settings'; the others keep their values.
+// The entries are checked into a pending copy, which replaces the live
+// tuning only once all of them are valid.
+VALUE method_set_tuning( VALUE self, VALUE settings )
+{
+   struct vector_sse_tuning pending = vector_sse_tuning;
+
+   Check_Type( settings, T_HASH );
+
+   rb_hash_foreach( settings, set_parameter, (VALUE)&pending );
+   vector_sse_tuning = pending;
+
+   return method_get_tuning( self );
+}
+
+VALUE method_reset_tuning( VALUE self )
+{
+   struct vector_sse_tuning defaults = TUNING_DEFAULTS;
+
+   vector_sse_tuning = defaults;
+
+   return method_get_tuning( self );
+}
+
+VALUE method_load_profile( VALUE self, VALUE path )
+{
+   if ( !load_profile( StringValueCStr( path ) ) )
+   {
+      rb_sys_fail( StringValueCStr( path ) );
+   }
+
+   return method_get_tuning( self );
+}
+
+static double seconds_now( void )
+{
+   struct timespec now;
+
+   clock_gettime( CLOCK_MONOTONIC, &now );
+
+   return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+#define  TEMPLATE_BENCHMARK_GEMM( FUNC_NAME, TYPE, GEMM ) \
+static double FUNC_NAME( uint32_t size, uint32_t repeats ) \
+{ \
+   uint64_t length = (uint64_t)size * size; \
+   uint64_t pos = 0; \
+   uint32_t repeat = 0; \
+   double start = 0; \
+   double elapsed = 0; \
+   double best = 0; \
+\
+   TYPE* left   = (TYPE*)malloc( length * sizeof( TYPE ) ); \
+   TYPE* right  = (TYPE*)malloc( length * sizeof( TYPE ) ); \
+   TYPE* result = (TYPE*)malloc( length * sizeof( TYPE ) ); \
+\
+   for ( pos = 0; pos < length; ++pos ) \
+   { \
+      left[ pos ]  = (TYPE)( pos % 7 ) - 3; \
+      right[ pos ] = (TYPE)( pos % 5 ) - 2; \
+   } \
+\
+   for ( repeat = 0; repeat < repeats; ++repeat ) \
+   { \
+      memset( result, 0, length * sizeof( TYPE ) ); \
+      start = seconds_now(); \
+      GEMM( size, size, size, 1, left, size, right, size, result, size ); \
+      elapsed = seconds_now() - start; \
+      if ( ( repeat == 0 ) || ( elapsed < best ) ) \
+      { \
+         best = elapsed; \
+      } \
+   } \
+\
+   free( left ); \
+   free( right ); \
+   free( result ); \
+\
+   return best; \
+}
+
+TEMPLATE_BENCHMARK_GEMM( benchmark_gemm_f32, float, gemm_f32 );
+TEMPLATE_BENCHMARK_GEMM( benchmark_gemm_f64, double, gemm_f64 );
+
+// Best of 'repeats' timings, in seconds, of a size x size native GEMM with
+// the current parameters. Ruby conversions are not included.
+VALUE method_benchmark_gemm( VALUE self, VALUE type_rb, VALUE size_rb, VALUE repeats_rb )
+{
+   int type = NUM2INT( type_rb );
+   uint32_t size = NUM2UINT( size_rb );
+   uint32_t repeats = NUM2UINT( repeats_rb );
+
+   if ( ( size == 0 ) || ( repeats == 0 ) )
+   {
+      rb_raise( rb_eArgError, "size and repeats must be positive" );
+   }
+
+   switch ( type )
+   {
+   case VECTOR_TYPE_F32:
+      return DBL2NUM( benchmark_gemm_f32( size, repeats ) );
+   case VECTOR_TYPE_F64:
+      return DBL2NUM( benchmark_gemm_f64( size, repeats ) );
+   default:
+      rb_raise( rb_eArgError, "GEMM benchmarks require F32 or F64" );
+   }
+
+   return Qnil;
+}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2015, Robert Glissmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+// %% license-end-token %%
+// 
+// Author: Robert.Glissmann@gmail.com (Robert Glissmann)
+// 
+// 
+
+#ifndef  VECTOR_SSE_TUNING_H
+#define  VECTOR_SSE_TUNING_H
+
+#include <stdint.h>
+#include "ruby.h"
+
+// Machine-dependent kernel parameters. They start at built-in defaults,
+// are overridden by the profile file at load time (see
+// tuning_load_default_profile) and can be changed from the main Ractor.
+// Kernels in other Ractors may read them meanwhile, so each kernel reads a
+// field once per call, and every field is valid whatever the others hold.
+struct vector_sse_tuning {
+   // Cache blocking of the GEMM common dimension and columns.
+   uint32_t gemm_f32_block_k;
+   uint32_t gemm_f32_block_n;
+   uint32_t gemm_f64_block_k;
+   uint32_t gemm_f64_block_n;
+
+   // Minimum multiply-adds per thread before work is split across threads.
+   uint32_t gemm_work_per_thread;
+   uint32_t sparse_work_per_thread;
+};
+
+extern struct vector_sse_tuning vector_sse_tuning;
+
+// Loads $VECTOR_SSE_PROFILE, or ~/.vector_sse_profile, if it exists.
+void tuning_load_default_profile( void );
+
+VALUE method_get_tuning( VALUE self );
+VALUE method_set_tuning( VALUE self, VALUE settings );
+VALUE method_reset_tuning( VALUE self );
+VALUE method_load_profile( VALUE self, VALUE path );
+VALUE method_benchmark_gemm( VALUE self, VALUE type_rb, VALUE size_rb, VALUE repeats_rb );
+
+#endif // VECTOR_SSE_TUNING_H
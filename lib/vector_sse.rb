@@ -30,6 +30,9 @@
 # 
 # 
 
+require 'io/wait'
+require 'stringio'
+
 bin_root = File.join( File.dirname( __FILE__ ), 'vector_sse' )
 require File.join( bin_root, 'vector_sse.so' )
 
@@ -39,8 +42,12 @@ module VectorSSE
    module Type
       S32 = 0
       S64 = 1
+      S8 = 2
+      S16 = 3
       F32 = 4
       F64 = 5
+      F16 = 6
+      BF16 = 7
       INVALID = -1
    end
 
@@ -48,11 +55,226 @@ module VectorSSE
       [ Type::S32, Type::S64, Type::F32, Type::F64 ].include?( type )
    end
 
+   ROUNDING_MODES = { nearest: 0, truncate: 1, floor: 2, ceil: 3 }.freeze
+
+   # Common type for an elementwise operation on two different types.
+   # Integers widen to S64, and integers mixed with floats become floats.
+   # F32 is kept for S32 operands, but S64 needs F64 to hold its range.
+   #
+   def self.promote_type( left, right )
+      types = [ left, right ]
+
+      if left == right
+         left
+      elsif types.include?( Type::F64 ) || types.include?( Type::F32 ) && types.include?( Type::S64 )
+         Type::F64
+      elsif types.include?( Type::F32 )
+         Type::F32
+      else
+         Type::S64
+      end
+   end
+
+   def self.rounding_mode( rounding )
+      unless ROUNDING_MODES.key?( rounding )
+         raise ArgumentError.new( "invalid rounding mode #{rounding.inspect}" )
+      end
+      ROUNDING_MODES[ rounding ]
+   end
+
+   CONVOLUTION_MODES = { full: 0, same: 1, valid: 2 }.freeze
+
+   def self.convolution_mode( mode )
+      unless CONVOLUTION_MODES.key?( mode )
+         raise ArgumentError.new( "invalid convolution mode #{mode.inspect}" )
+      end
+      CONVOLUTION_MODES[ mode ]
+   end
+
+   # Index arrays for gathers and scatters are S32 or S64 VectorSSE::Array
+   # instances or plain Arrays of Integers.
+   #
+   def self.valid_index_array( indices )
+
+      if indices.is_a?( VectorSSE::Array )
+         unless [ Type::S32, Type::S64 ].include?( indices.type )
+            raise ArgumentError.new( "index arrays must be S32 or S64" )
+         end
+      elsif indices.class != ::Array
+         raise ArgumentError.new( "expected index array for argument 0" )
+      end
+
+   end
+
+   def self.valid_packed_type( type )
+      [ Type::S8, Type::S16, Type::F16, Type::BF16 ].include?( type )
+   end
+
+   # Runs the block on a separate Ruby thread and returns a Future for its
+   # result. Kernels called from the block that release the GVL overlap
+   # with work on the calling thread.
+   #
+   def self.async( &block )
+      raise ArgumentError.new( "no block given" ) unless block
+      thread = Thread.new do
+         # The Future re-raises exceptions from the block when asked for
+         # its value.
+         Thread.current.report_on_exception = false
+         block.call
+      end
+      Future.new( thread: thread )
+   end
+
+   # Cache block candidates tried by autotune! for each GEMM type.
+   AUTOTUNE_BLOCK_K = [ 64, 128, 256, 512 ].freeze
+   AUTOTUNE_BLOCK_N = [ 128, 256, 512, 1024 ].freeze
+
+   # Square sizes tried, smallest first, when looking for the point at
+   # which splitting a GEMM across threads starts to pay off.
+   AUTOTUNE_CUTOVER_SIZES = [ 32, 48, 64, 96, 128, 192, 256 ].freeze
+
+   # Profile read when the extension is loaded and written by autotune!.
+   #
+   def self.profile_path
+      ENV[ 'VECTOR_SSE_PROFILE' ] || File.join( Dir.home, '.vector_sse_profile' )
+   end
+
+   def self.save_profile( path = profile_path )
+      File.open( path, 'w' ) do |file|
+         file.puts "# vector_sse tuning profile"
+         tuning.each { |name,value| file.puts "#{name} #{value}" }
+      end
+      path
+   end
+
+   # Benchmarks candidate GEMM cache blocks for F32 and F64 at 'size' and
+   # the single- versus multi-thread cut-over, keeps the fastest settings
+   # and, when 'save' is set, writes them to the profile. Returns the new
+   # settings. Takes a few seconds at the default size. If the run is
+   # interrupted, the previous settings and thread count are restored.
+   #
+   def self.autotune!( size: 384, repeats: 3, save: true, path: profile_path )
+
+      previous = tuning
+      threads = thread_count
+      completed = false
+
+      begin
+         { Type::F32 => 'f32', Type::F64 => 'f64' }.each do |type,suffix|
+            block_k = :"gemm_#{suffix}_block_k"
+            block_n = :"gemm_#{suffix}_block_n"
+
+            best = AUTOTUNE_BLOCK_K.product( AUTOTUNE_BLOCK_N ).min_by do |k,n|
+               self.tuning = { block_k => k, block_n => n }
+               benchmark_gemm( type, size, repeats )
+            end
+
+            self.tuning = { block_k => best[ 0 ], block_n => best[ 1 ] }
+         end
+
+         if threads > 1
+            cutover = AUTOTUNE_CUTOVER_SIZES.find do |n|
+               self.thread_count = 1
+               serial = benchmark_gemm( Type::F32, n, repeats )
+
+               self.thread_count = threads
+               self.tuning = { gemm_work_per_thread: 1 }
+               split = benchmark_gemm( Type::F32, n, repeats )
+
+               split < serial
+            end
+
+            # At the cut-over size the product is split in two.
+            cutover ||= AUTOTUNE_CUTOVER_SIZES.last * 2
+            self.tuning = { gemm_work_per_thread: cutover ** 3 / 2 }
+         end
+
+         completed = true
+      ensure
+         self.thread_count = threads
+         self.tuning = previous unless completed
+      end
+
+      save_profile( path ) if save
+      tuning
+   end
+
+   # Distance between every row of 'left' and every row of 'right'. See
+   # Mat#pairwise_distances.
+   #
+   def self.pairwise_distances( left, right, metric: :l2 )
+      left.pairwise_distances( right, metric: metric )
+   end
+
+   # The 'k' rows of 'catalogue' nearest to each row of 'query'. See Mat#knn.
+   #
+   def self.knn( query, catalogue, k, metric: :l2 )
+      query.knn( catalogue, k, metric: metric )
+   end
+
+   # Product of a chain of matrices in the cheapest order. See Mat#chain_mul.
+   #
+   def self.chain_mul( first, *others )
+      first.chain_mul( *others )
+   end
+
+
+   # Mixed into the matrix and array classes. A shareable instance is
+   # deeply frozen in place, so it can be sent to other Ractors by reference
+   # instead of being copied. Operations on it still return new, unfrozen
+   # results, and dup returns a writable copy with its own storage.
+   #
+   module Shareable
+
+      # Freezes self and its element storage and returns self.
+      #
+      def make_shareable
+         Ractor.make_shareable( self )
+      end
+
+      # Also freezes the element storage, so that a frozen instance is
+      # read-only.
+      #
+      def freeze
+         instance_variables.each { |name| instance_variable_get( name ).freeze }
+         super
+      end
+
+      # Gives a copy its own element storage rather than sharing (possibly
+      # frozen) storage with the original.
+      #
+      def initialize_copy( other )
+         super
+         instance_variables.each do |name|
+            value = instance_variable_get( name )
+            if value.is_a?( ::Array ) || value.is_a?( String )
+               instance_variable_set( name, value.dup )
+            end
+         end
+      end
+
+      # Object#clone( freeze: true ) sets the frozen flag without calling
+      # #freeze, which would leave the copied storage writable.
+      #
+      def initialize_clone( other, freeze: nil )
+         super
+         self.freeze if freeze || ( freeze.nil? && other.frozen? )
+      end
+
+   end
+
 
    class Mat
+      include Shareable
 
       MIN_ROW_COL_COUNT = 1
 
+      DISTANCE_METRICS = { l2: 0, cosine: 1, dot: 2 }.freeze
+
+      BROADCAST_OPS = { add: 0, sub: 1, mul: 2, div: 3 }.freeze
+
+      GRAM_MODES = { gram: 0, covariance: 1, correlation: 2 }.freeze
+
       attr_reader :type
       attr_reader :rows
       attr_reader :cols
@@ -106,7 +328,8 @@ module VectorSSE
             valid_data_type( value )
          end
 
-         @data = data
+         # A copy, so that freezing self cannot freeze the caller's Array.
+         @data = data.dup
       end
 
       def []( pos )
@@ -195,17 +418,25 @@ module VectorSSE
 
          if [ Integer, Float ].include? other.class
 
-            scalar_value = other
-            other = Mat.new( @type, @rows, @cols )
-            other.data.replace( ::Array.new( @linear_size, scalar_value ) )
+            return broadcast( :add, Mat.new( @type, 1, 1, [ other ] ) )
 
          elsif other.class == self.class
 
-            if ( @rows != other.rows ) || ( @cols != other.cols )
+            unless broadcastable?( other )
                raise ArgumentError.new(
                   "matrix addition requires operands of equal size")
             end
 
+            # Mixed types are converted to the common type as the kernel
+            # reads its operands.
+            type = VectorSSE::promote_type( @type, other.type )
+
+            # A 1 x cols or rows x 1 operand is applied across the other
+            # dimension.
+            if ( @rows != other.rows ) || ( @cols != other.cols )
+               return broadcast( :add, other, type )
+            end
+
          else
 
             raise ArgumentError.new(
@@ -213,9 +444,9 @@ module VectorSSE
 
          end
 
-         result = Mat.new( @type, @rows, @cols )
+         result = Mat.new( type, @rows, @cols )
 
-         case @type
+         case type
          when Type::S32
             result.data.replace( VectorSSE::add_s32( self.data, other.data ) )
          when Type::S64
@@ -233,17 +464,23 @@ module VectorSSE
 
          if [ Integer, Float ].include? other.class
 
-            scalar_value = other
-            other = Mat.new( @type, @rows, @cols )
-            other.data = ::Array.new( @linear_size, scalar_value )
+            return broadcast( :sub, Mat.new( @type, 1, 1, [ other ] ) )
 
          elsif other.class == self.class
 
-            if ( @rows != other.rows ) || ( @cols != other.cols )
+            unless broadcastable?( other )
                raise ArgumentError.new(
                   "matrix subtraction requires operands of equal size")
             end
 
+            # Mixed types are converted to the common type as the kernel
+            # reads its operands.
+            type = VectorSSE::promote_type( @type, other.type )
+
+            if ( @rows != other.rows ) || ( @cols != other.cols )
+               return broadcast( :sub, other, type )
+            end
+
          else
 
             raise ArgumentError.new(
@@ -251,9 +488,9 @@ module VectorSSE
 
          end
 
-         result = Mat.new( @type, @rows, @cols )
+         result = Mat.new( type, @rows, @cols )
 
-         case @type
+         case type
          when Type::S32
             result.data.replace( VectorSSE::sub_s32( self.data, other.data ) )
          when Type::S64
@@ -267,164 +504,1196 @@ module VectorSSE
          result
       end
 
-      def transpose
-         raise "unimplemented"
-      end
+      # Running sum along an axis. Axis 0 accumulates down each column and
+      # axis 1 accumulates across each row. An exclusive scan starts every
+      # run at zero, so each element holds the sum of the elements before it.
+      #
+      def cumsum( axis: 0, exclusive: false )
+         result = Mat.new( @type, @rows, @cols )
 
-      def reshape( rows, cols )
-         raise "unimplemented"
-      end
+         case @type
+         when Type::S32
+            result.data.replace( VectorSSE::cumsum_s32( @data, @rows, @cols, axis, exclusive ) )
+         when Type::S64
+            result.data.replace( VectorSSE::cumsum_s64( @data, @rows, @cols, axis, exclusive ) )
+         when Type::F32
+            result.data.replace( VectorSSE::cumsum_f32( @data, @rows, @cols, axis, exclusive ) )
+         when Type::F64
+            result.data.replace( VectorSSE::cumsum_f64( @data, @rows, @cols, axis, exclusive ) )
+         end
 
+         result
+      end
 
-      protected
+      # Running product along an axis. See #cumsum.
+      #
+      def cumprod( axis: 0, exclusive: false )
+         result = Mat.new( @type, @rows, @cols )
 
+         case @type
+         when Type::S32
+            result.data.replace( VectorSSE::cumprod_s32( @data, @rows, @cols, axis, exclusive ) )
+         when Type::S64
+            result.data.replace( VectorSSE::cumprod_s64( @data, @rows, @cols, axis, exclusive ) )
+         when Type::F32
+            result.data.replace( VectorSSE::cumprod_f32( @data, @rows, @cols, axis, exclusive ) )
+         when Type::F64
+            result.data.replace( VectorSSE::cumprod_f64( @data, @rows, @cols, axis, exclusive ) )
+         end
 
-      def linear_index( row, col )
+         result
+      end
 
-         row * @cols + col
+      # Returns a rows x other.rows matrix holding the distance between each
+      # row of self and each row of other. Supported metrics are :l2
+      # (Euclidean distance), :cosine (one minus cosine similarity) and :dot
+      # (dot product). Only F32 and F64 matrices are supported.
+      #
+      def pairwise_distances( other, metric: :l2 )
 
-      end
+         valid_distance_operand( other )
 
-      def valid_linear_index( pos )
+         result = Mat.new( @type, @rows, other.rows )
 
-         if ( pos < 0 ) || ( pos >= @linear_size )
-            raise IndexError.new( "index out of bounds" )
+         case @type
+         when Type::F32
+            result.data.replace( VectorSSE::pairwise_f32(
+               @data, @rows, @cols, other.data, other.rows, other.cols, distance_metric( metric ) ) )
+         when Type::F64
+            result.data.replace( VectorSSE::pairwise_f64(
+               @data, @rows, @cols, other.data, other.rows, other.cols, distance_metric( metric ) ) )
          end
 
+         result
       end
 
-      def valid_row_col( row, col )
+      # For each row of self, finds the 'k' nearest rows of 'catalogue'.
+      # Returns [ indices, distances ], both rows x k matrices ordered from
+      # nearest to farthest. Indices are S32 catalogue row numbers. With the
+      # :dot metric the largest dot products are nearest.
+      #
+      def knn( catalogue, k, metric: :l2 )
 
-         if ( row < 0 ) || ( row >= @rows )
-            raise IndexError.new( "row index out of bounds" )
+         valid_distance_operand( catalogue )
+
+         if ( k < 1 ) || ( k > catalogue.rows )
+            raise ArgumentError.new(
+               "k must be between 1 and the number of catalogue rows" )
          end
 
-         if ( col < 0 ) || ( col >= @cols )
-            raise IndexError.new( "column index out of bounds" )
+         indices   = Mat.new( Type::S32, @rows, k )
+         distances = Mat.new( @type, @rows, k )
+
+         case @type
+         when Type::F32
+            index_data, distance_data = VectorSSE::knn_f32(
+               @data, @rows, @cols, catalogue.data, catalogue.rows, catalogue.cols, k,
+               distance_metric( metric ) )
+         when Type::F64
+            index_data, distance_data = VectorSSE::knn_f64(
+               @data, @rows, @cols, catalogue.data, catalogue.rows, catalogue.cols, k,
+               distance_metric( metric ) )
          end
 
+         indices.data.replace( index_data )
+         distances.data.replace( distance_data )
+
+         [ indices, distances ]
       end
 
-      def valid_data_type( value )
+      # 2D convolution with the matrix 'kernel', which must have the same
+      # type. Only F32 and F64 matrices are supported. :full returns every
+      # partial overlap, :same keeps the size of self with the kernel
+      # centred, and :valid returns only positions where the kernel lies
+      # entirely inside self.
+      #
+      def convolve2d( kernel, mode: :full )
+         valid_convolution_kernel( kernel )
+         correlate_data( kernel.data.reverse, kernel.rows, kernel.cols, mode )
+      end
 
-         unless [ Integer, Float ].include? value.class
-            raise ArgumentError.new( "expected argument of type Integer or Float" )
-         end
+      # 2D cross-correlation, which is convolution without flipping the
+      # kernel. See #convolve2d.
+      #
+      def correlate2d( kernel, mode: :full )
+         valid_convolution_kernel( kernel )
+         correlate_data( kernel.data, kernel.rows, kernel.cols, mode )
+      end
 
+      # X^T X as a cols x cols matrix, for an F32 or F64 matrix X. Only one
+      # triangle is computed and mirrored, and self is read row by row
+      # without being transposed.
+      #
+      def gram
+         gram_data( :gram, 0 )
       end
 
-      attr_accessor :data
-      
-   end
-   Matrix = Mat
+      # Covariance of the columns, treating each row as an observation. The
+      # sums of squared deviations are divided by rows - ddof.
+      #
+      def covariance( ddof: 1 )
+         gram_data( :covariance, ddof )
+      end
 
+      # Pearson correlation of the columns. Constant columns give NaN.
+      #
+      def correlation
+         gram_data( :correlation, 0 )
+      end
 
-   class Array < Array
+      # Converts to a reduced-precision PackedMat. S8 and S16 values are
+      # quantized as round( value / scale ) + zero_point; when no scale is
+      # given a symmetric scale is chosen from the largest magnitude.
+      #
+      def to_packed( type, scale: nil, zero_point: 0 )
 
-      attr_reader :type
+         if scale.nil?
+            scale = PackedMat.symmetric_scale( type, @data )
+         end
 
-      def initialize( type, size=0, val=nil )
-         super( size, val )
+         PackedMat.new( type, @rows, @cols, @data, scale: scale, zero_point: zero_point )
+      end
 
-         if VectorSSE::valid_type( type )
-            @type = type
-         else
-            raise "invalid SSE vector type"
-         end
+      # Converts an F32 or F64 matrix to a SparseMat holding its nonzeros.
+      #
+      def to_sparse
+         SparseMat.from_dense( self )
       end
 
-      def <<( value )
-         unless [ Integer, Float ].include? value.class
-            raise ArgumentError.new(
-               "expected argument of type Integer or Float for argument 0" )
+      # Returns a copy converted to 'type'. Float to integer conversions use
+      # 'rounding' (:nearest, :truncate, :floor or :ceil) and, when
+      # 'saturate' is set, clamp out of range values and map NaN to zero.
+      #
+      def astype( type, rounding: :nearest, saturate: true )
+
+         unless VectorSSE::valid_type( type )
+            raise ArgumentError.new( "invalid SSE matrix type for argument 0" )
          end
-         super( value )
+
+         result = Mat.new( type, @rows, @cols )
+         result.data.replace( VectorSSE::convert(
+            @data, @type, type, VectorSSE::rounding_mode( rounding ), saturate ) )
+         result
       end
 
-      def insert( index, *values )
-         values.each_with_index do |value,arg_index|
-            unless [ Integer, Float ].include? value.class
-               raise ArgumentError.new(
-                  "expected argument of type Integer or Float for argument #{arg_index}" )
-            end
+      # Starts self * other in the background and returns a Future for the
+      # product. F32 and F64 matrix products run on the native worker pool
+      # from copies of the operands, so the caller may keep using (and
+      # modifying) both matrices; other products run via VectorSSE.async.
+      #
+      def mul_async( other )
+
+         unless ( other.class == self.class ) && ( other.type == @type ) &&
+                [ Type::F32, Type::F64 ].include?( @type )
+            return VectorSSE.async { self * other }
          end
-         super( index, values )
-      end
 
-      def []=( index, value )
-         unless [ Integer, Float ].include? value.class
-            raise ArgumentError.new(
-               "expected argument of type Integer or Float for argument 1" )
+         if @cols != other.rows
+            raise "invalid matrix dimensions"
          end
-         super( index, value )
-      end
- 
-      # Note:
-      # This method replaces the base class implementation of '+', which
-      # performs concatenation. To concatenate, see #concat.
-      #
-      def +( other )
 
-         if [ Integer, Float ].include? other.class
+         notify = Future.scheduler_active?
+         job = case @type
+         when Type::F32
+            VectorSSE::mul_async_f32( @data, @rows, @cols, other.data, other.rows, other.cols, notify )
+         when Type::F64
+            VectorSSE::mul_async_f64( @data, @rows, @cols, other.data, other.rows, other.cols, notify )
+         end
 
-            other = ::Array.new( self.length, other )
+         result = Mat.new( @type, @rows, other.cols )
+         Future.new( job: job ) do |data|
+            result.data.replace( data )
+            result
+         end
+      end
 
-         elsif other.class != self.class
+      # Product self * others[0] * others[1] * ..., multiplied in the order
+      # that needs the fewest multiply-adds. The order is found by dynamic
+      # programming over the dimensions, which pays off when the shapes
+      # differ widely, e.g. 10000x50 * 50x10000 * 10000x1. F32 and F64
+      # intermediates share one native scratch buffer.
+      #
+      def chain_mul( *others )
 
-            raise ArgumentError.new(
-               "expect argument of type #{self.class}, Integer, or Float for argument 0" )
+         mats = [ self ] + others
+
+         others.each_with_index do |other,index|
+            unless ( other.class == self.class ) && ( other.type == @type )
+               raise ArgumentError.new(
+                  "expected argument of type #{self.class} with matching type for argument #{index}" )
+            end
+         end
 
+         mats.each_cons( 2 ) do |left,right|
+            if left.cols != right.rows
+               raise "invalid matrix dimensions"
+            end
          end
 
-         result = self.class.new( @type )
+         dims = [ @rows ] + mats.map( &:cols )
+         splits = VectorSSE::chain_order( dims )
 
          case @type
-         when Type::S32
-            result.replace( VectorSSE::add_s32( self, other ) )
-         when Type::S64
-            result.replace( VectorSSE::add_s64( self, other ) )
          when Type::F32
-            result.replace( VectorSSE::add_f32( self, other ) )
+            data = VectorSSE::chain_mul_f32( mats.map { |mat| mat.data }, dims, splits )
          when Type::F64
-            result.replace( VectorSSE::add_f64( self, other ) )
+            data = VectorSSE::chain_mul_f64( mats.map { |mat| mat.data }, dims, splits )
+         else
+            return chain_product( mats, splits, 0, mats.length - 1 )
          end
 
+         result = Mat.new( @type, @rows, mats.last.cols )
+         result.data.replace( data )
          result
       end
 
-      # Note:
-      # This method replaces the base class implementation of '-', which
-      # removes items that are found in 'other'.
+      # Elementwise product. 'other' may be a scalar or a matrix of the same
+      # size, or a 1 x cols or rows x 1 matrix that is broadcast across self.
       #
-      def -( other )
+      def multiply( other )
+         elementwise( :mul, other )
+      end
 
-         if [ Integer, Float ].include? other.class
-            other = ::Array.new( self.length, other )
-         elsif other.class != self.class
-            raise ArgumentError.new(
-               "expected argument of type #{self.class}, Integer, or Float for argument 0" )
-         end
+      # Elementwise quotient, with the same broadcasting rules as #multiply.
+      # Integer matrices round toward negative infinity like Integer#/.
+      #
+      def /( other )
+         elementwise( :div, other )
+      end
 
-         result = self.class.new( @type )
+      # Rows at 'indices' (an S32/S64 VectorSSE::Array or Array of
+      # Integers), in index order. Each row is copied as a contiguous block.
+      #
+      def take_rows( indices )
+         VectorSSE::valid_index_array( indices )
 
-         case @type
-         when Type::S32
-            result.replace( VectorSSE::sub_s32( self, other ) )
-         when Type::S64
-            result.replace( VectorSSE::sub_s64( self, other ) )
-         when Type::F32
-            result.replace( VectorSSE::sub_f32( self, other ) )
-         when Type::F64
-            result.replace( VectorSSE::sub_f64( self, other ) )
+         # A matrix has at least one row.
+         if indices.empty?
+            raise ArgumentError.new( "take_rows needs at least one row index" )
          end
 
+         result = Mat.new( @type, indices.length, @cols )
+         result.data.replace( VectorSSE::take( @data, @cols, indices ) )
          result
       end
 
-      def sum
-         sum_result = 0
+      # Adds row i of 'other' into row indices[ i ] of self, in place.
+      # Repeated indices accumulate.
+      #
+      def index_add!( indices, other )
+         VectorSSE::valid_index_array( indices )
 
-         case @type
+         unless ( other.class == self.class ) && ( other.type == @type )
+            raise ArgumentError.new(
+               "expected argument of type #{self.class} with the same element type for argument 1" )
+         end
+
+         if ( other.rows != indices.length ) || ( other.cols != @cols )
+            raise "invalid matrix dimensions"
+         end
+
+         case @type
+         when Type::S32 then VectorSSE::index_add_s32( @data, @cols, indices, other.data )
+         when Type::S64 then VectorSSE::index_add_s64( @data, @cols, indices, other.data )
+         when Type::F32 then VectorSSE::index_add_f32( @data, @cols, indices, other.data )
+         when Type::F64 then VectorSSE::index_add_f64( @data, @cols, indices, other.data )
+         end
+
+         self
+      end
+
+      # LU factorization with partial pivoting. Returns [ l, u, p ] where l
+      # is unit lower triangular, u is upper triangular and p is an Array
+      # of row indices such that row i of l * u is row p[ i ] of self.
+      #
+      def lu
+         valid_square_float
+
+         factors, permutation, sign = case @type
+         when Type::F32 then VectorSSE::lu_f32( @data, @rows )
+         when Type::F64 then VectorSSE::lu_f64( @data, @rows )
+         end
+
+         lower = Mat.new( @type, @rows, @cols )
+         upper = Mat.new( @type, @rows, @cols )
+         @rows.times do |row|
+            @cols.times do |col|
+               value = factors[ linear_index( row, col ) ]
+               if col < row
+                  lower.data[ linear_index( row, col ) ] = value
+                  upper.data[ linear_index( row, col ) ] = 0.0
+               else
+                  lower.data[ linear_index( row, col ) ] = ( col == row ) ? 1.0 : 0.0
+                  upper.data[ linear_index( row, col ) ] = value
+               end
+            end
+         end
+
+         [ lower, upper, permutation ]
+      end
+
+      # Solves self * x = b. 'b' is a VectorSSE::Array with one element per
+      # row, or a Mat with the same number of rows, and x has the same
+      # form. Raises if the matrix is singular.
+      #
+      def solve( b )
+         valid_square_float
+
+         if b.is_a?( VectorSSE::Array )
+            rhs = b
+            rhs_cols = 1
+            if b.length != @rows
+               raise "invalid vector dimensions"
+            end
+         elsif b.class == self.class
+            rhs = b.data
+            rhs_cols = b.cols
+            if b.rows != @rows
+               raise "invalid matrix dimensions"
+            end
+         else
+            raise ArgumentError.new(
+               "expected argument of type VectorSSE::Array or #{self.class} for argument 0" )
+         end
+
+         solution = case @type
+         when Type::F32 then VectorSSE::solve_f32( @data, @rows, rhs, rhs_cols )
+         when Type::F64 then VectorSSE::solve_f64( @data, @rows, rhs, rhs_cols )
+         end
+
+         if b.is_a?( VectorSSE::Array )
+            result = VectorSSE::Array.new( @type )
+            result.replace( solution )
+         else
+            result = Mat.new( @type, @rows, rhs_cols )
+            result.data.replace( solution )
+         end
+
+         result
+      end
+
+      def inverse
+         valid_square_float
+
+         result = Mat.new( @type, @rows, @cols )
+         result.data.replace( case @type
+            when Type::F32 then VectorSSE::inverse_f32( @data, @rows )
+            when Type::F64 then VectorSSE::inverse_f64( @data, @rows )
+            end )
+         result
+      end
+
+      def det
+         valid_square_float
+
+         factors, permutation, sign = case @type
+         when Type::F32 then VectorSSE::lu_f32( @data, @rows )
+         when Type::F64 then VectorSSE::lu_f64( @data, @rows )
+         end
+
+         @rows.times.inject( sign.to_f ) do |product, diag|
+            product * factors[ linear_index( diag, diag ) ]
+         end
+      end
+
+      # Lower triangular l such that l * l^T is self, for a symmetric
+      # positive definite matrix. Only the lower triangle of self is read.
+      #
+      def cholesky
+         valid_square_float
+
+         result = Mat.new( @type, @rows, @cols )
+         result.data.replace( case @type
+            when Type::F32 then VectorSSE::cholesky_f32( @data, @rows )
+            when Type::F64 then VectorSSE::cholesky_f64( @data, @rows )
+            end )
+         result
+      end
+
+      def transpose
+         raise "unimplemented"
+      end
+
+      def reshape( rows, cols )
+         raise "unimplemented"
+      end
+
+
+      protected
+
+
+      def linear_index( row, col )
+
+         row * @cols + col
+
+      end
+
+      def valid_linear_index( pos )
+
+         if ( pos < 0 ) || ( pos >= @linear_size )
+            raise IndexError.new( "index out of bounds" )
+         end
+
+      end
+
+      def valid_row_col( row, col )
+
+         if ( row < 0 ) || ( row >= @rows )
+            raise IndexError.new( "row index out of bounds" )
+         end
+
+         if ( col < 0 ) || ( col >= @cols )
+            raise IndexError.new( "column index out of bounds" )
+         end
+
+      end
+
+      def broadcastable?( other )
+         ( ( @rows == other.rows ) || ( @rows == 1 ) || ( other.rows == 1 ) ) &&
+            ( ( @cols == other.cols ) || ( @cols == 1 ) || ( other.cols == 1 ) )
+      end
+
+      def elementwise( op, other )
+
+         if [ Integer, Float ].include? other.class
+
+            other = Mat.new( @type, 1, 1, [ other ] )
+
+         elsif other.class == self.class
+
+            unless broadcastable?( other )
+               raise ArgumentError.new( "operands could not be broadcast together" )
+            end
+
+            return broadcast( op, other, VectorSSE::promote_type( @type, other.type ) )
+
+         else
+
+            raise ArgumentError.new(
+               "expect argument of type #{self.class}, Integer, or Float for argument 0" )
+
+         end
+
+         broadcast( op, other )
+      end
+
+      # Applies 'op' in 'type', to which both operands are converted as the
+      # kernel reads them.
+      def broadcast( op, other, type = @type )
+
+         result = Mat.new( type, [ @rows, other.rows ].max, [ @cols, other.cols ].max )
+         args = [ BROADCAST_OPS[ op ], @data, @rows, @cols, other.data, other.rows, other.cols ]
+
+         case type
+         when Type::S32
+            result.data.replace( VectorSSE::broadcast_s32( *args ) )
+         when Type::S64
+            result.data.replace( VectorSSE::broadcast_s64( *args ) )
+         when Type::F32
+            result.data.replace( VectorSSE::broadcast_f32( *args ) )
+         when Type::F64
+            result.data.replace( VectorSSE::broadcast_f64( *args ) )
+         end
+
+         result
+      end
+
+      def valid_distance_operand( other )
+
+         unless other.class == self.class
+            raise ArgumentError.new(
+               "expected argument of type #{self.class} for argument 0" )
+         end
+
+         unless [ Type::F32, Type::F64 ].include?( @type ) && ( other.type == @type )
+            raise ArgumentError.new(
+               "distance computations require F32 or F64 operands of the same type" )
+         end
+
+         if @cols != other.cols
+            raise "invalid matrix dimensions"
+         end
+
+      end
+
+      def distance_metric( metric )
+
+         unless DISTANCE_METRICS.key?( metric )
+            raise ArgumentError.new( "invalid distance metric #{metric.inspect}" )
+         end
+
+         DISTANCE_METRICS[ metric ]
+
+      end
+
+      def valid_convolution_kernel( kernel )
+
+         unless ( kernel.class == self.class ) && ( kernel.type == @type )
+            raise ArgumentError.new(
+               "expected argument of type #{self.class} with matching type for argument 0" )
+         end
+
+         unless [ Type::F32, Type::F64 ].include?( @type )
+            raise ArgumentError.new( "convolution requires an F32 or F64 matrix" )
+         end
+
+      end
+
+      def correlate_data( kernel_data, kernel_rows, kernel_cols, mode )
+
+         args = [ @data, @rows, @cols, kernel_data, kernel_rows, kernel_cols,
+                  VectorSSE::convolution_mode( mode ) ]
+
+         # A matrix cannot be empty, so :valid needs the kernel to fit.
+         if ( mode == :valid ) && ( ( kernel_rows > @rows ) || ( kernel_cols > @cols ) )
+            raise ArgumentError.new( "kernel must not be larger than the matrix in :valid mode" )
+         end
+
+         data, rows, cols = case @type
+         when Type::F32 then VectorSSE::correlate_f32( *args )
+         when Type::F64 then VectorSSE::correlate_f64( *args )
+         end
+
+         result = Mat.new( @type, rows, cols )
+         result.data.replace( data )
+         result
+      end
+
+      # Integer chains are multiplied with #* in the order given by 'splits'.
+      def chain_product( mats, splits, first, last )
+
+         if first == last
+            # A chain of one still returns a new matrix with its own data.
+            return ( mats.length == 1 ) ? Mat.new( @type, @rows, @cols, @data.dup ) : mats[ first ]
+         end
+
+         split = splits[ first * mats.length + last ]
+         chain_product( mats, splits, first, split ) * chain_product( mats, splits, split + 1, last )
+      end
+
+      def gram_data( mode, ddof )
+
+         unless [ Type::F32, Type::F64 ].include?( @type )
+            raise ArgumentError.new( "Gram matrices require an F32 or F64 matrix" )
+         end
+
+         args = [ @data, @rows, @cols, GRAM_MODES[ mode ], ddof ]
+
+         data = case @type
+         when Type::F32 then VectorSSE::gram_f32( *args )
+         when Type::F64 then VectorSSE::gram_f64( *args )
+         end
+
+         result = Mat.new( @type, @cols, @cols )
+         result.data.replace( data )
+         result
+      end
+
+      def valid_square_float
+
+         unless [ Type::F32, Type::F64 ].include?( @type )
+            raise ArgumentError.new( "linear solvers require an F32 or F64 matrix" )
+         end
+
+         if @rows != @cols
+            raise "matrix must be square"
+         end
+
+      end
+
+      def valid_data_type( value )
+
+         unless [ Integer, Float ].include? value.class
+            raise ArgumentError.new( "expected argument of type Integer or Float" )
+         end
+
+      end
+
+      attr_accessor :data
+      
+   end
+   Matrix = Mat
+
+
+   # Result of a computation running in the background, from Mat#mul_async
+   # or VectorSSE.async. Waiting on a native job releases the GVL; when a
+   # Fiber scheduler is active, waiting yields to it instead of blocking.
+   #
+   class Future
+
+      def self.scheduler_active?
+         Fiber.respond_to?( :scheduler ) && !Fiber.scheduler.nil?
+      end
+
+      # Wraps either a native VectorSSE::Job, whose raw result is passed
+      # through 'finish', or a Ruby Thread.
+      #
+      def initialize( job: nil, thread: nil, &finish )
+         @job = job
+         @thread = thread
+         @finish = finish
+         @lock = Mutex.new
+
+         fd = job && job.notify_fd
+         @notify = fd && IO.for_fd( fd, autoclose: true )
+      end
+
+      def ready?
+         @job ? @job.ready? : !@thread.alive?
+      end
+
+      # Blocks until the result is available and returns self.
+      #
+      def wait
+         if @job
+            if @notify && !@notify.closed?
+               @notify.wait_readable
+               @notify.close
+            end
+            @job.wait
+         else
+            @thread.join
+         end
+         self
+      end
+
+      # The result, waiting for it if necessary. Exceptions raised by a
+      # VectorSSE.async block are re-raised here.
+      #
+      def value
+         @lock.synchronize do
+            unless defined?( @value )
+               wait
+               @value = @job ? ( @finish ? @finish.call( @job.result ) : @job.result ) : @thread.value
+            end
+         end
+         @value
+      end
+
+   end
+
+
+   # Streaming statistics over values that arrive in chunks. The running
+   # count, sum, min, max, mean and variance are kept natively and each
+   # chunk is reduced with SIMD, so memory use is bounded by the chunk size.
+   # An accumulator should be fed by one thread. Adding to it while another
+   # thread reduces a large String into it raises RuntimeError, so threads
+   # should each fill their own accumulator and combine them with #merge!.
+   #
+   #    acc = VectorSSE::Accumulator.new( VectorSSE::Type::F32 )
+   #    acc << [ 1.0, 2.0 ]
+   #    acc << File.open( 'samples.f32', 'rb' )
+   #    acc.mean
+   #
+   class Accumulator
+
+      # Bytes read from an IO per chunk.
+      IO_CHUNK_BYTES = 1 << 20
+
+      # Values from an Enumerator collected per chunk.
+      ENUM_CHUNK_SIZE = 4096
+
+      # Adds a chunk and returns self. A chunk is an Array of values, a
+      # binary String of native-endian packed values (which may split a
+      # value across two chunks), an IO that is read to EOF, or an
+      # Enumerable whose items are values or chunks.
+      #
+      def <<( chunk )
+
+         case chunk
+         when ::Array
+            add_array( chunk )
+         when String
+            add_bytes( chunk )
+         when IO, StringIO
+            buffer = String.new( capacity: IO_CHUNK_BYTES )
+            add_bytes( buffer ) while chunk.read( IO_CHUNK_BYTES, buffer )
+         when Enumerable
+            values = []
+            chunk.each do |item|
+               if [ Integer, Float ].include? item.class
+                  values << item
+                  if values.length == ENUM_CHUNK_SIZE
+                     add_array( values )
+                     values.clear
+                  end
+               else
+                  self << item
+               end
+            end
+            add_array( values )
+         else
+            raise ArgumentError.new(
+               "expected Array, String, IO or Enumerable for argument 0" )
+         end
+
+         self
+      end
+
+      # New accumulator holding the statistics of both self and 'other'.
+      #
+      def merge( other )
+         Accumulator.new( type ).merge!( self ).merge!( other )
+      end
+
+      # Variance divided by count - ddof, or nil when count <= ddof.
+      #
+      def variance( ddof: 0 )
+         native_variance( ddof )
+      end
+
+      def stddev( ddof: 0 )
+         value = variance( ddof: ddof )
+         value && Math.sqrt( value )
+      end
+
+      def to_h
+         { count: count, sum: sum, min: min, max: max, mean: mean, variance: variance }
+      end
+
+      private :native_variance
+
+   end
+
+
+   # Matrix of reduced-precision values packed into a binary String. S8 and
+   # S16 hold quantized integers with a scale and zero point; F16 and BF16
+   # hold IEEE half-precision and bfloat16 values. Arithmetic widens to
+   # 32 bits, so products are returned as F32 Mat instances.
+   #
+   class PackedMat
+      include Shareable
+
+      MIN_ROW_COL_COUNT = 1
+
+      BYTES_PER_ELEMENT = {
+         Type::S8 => 1, Type::S16 => 2, Type::F16 => 2, Type::BF16 => 2
+      }.freeze
+
+      QUANTIZED_RANGE = {
+         Type::S8 => ( -128..127 ), Type::S16 => ( -32768..32767 )
+      }.freeze
+
+      attr_reader :type
+      attr_reader :rows
+      attr_reader :cols
+      attr_reader :scale
+      attr_reader :zero_point
+
+      # Scale that maps the largest magnitude in 'values' to the top of the
+      # quantized range of 'type'.
+      #
+      def self.symmetric_scale( type, values )
+         range = QUANTIZED_RANGE[ type ]
+         return 1.0 if range.nil?
+
+         max_abs = values.map( &:abs ).max
+         ( max_abs.nil? || ( max_abs == 0 ) ) ? 1.0 : ( max_abs.to_f / range.max )
+      end
+
+      def initialize( type, rows, cols, data=nil, scale: 1.0, zero_point: 0 )
+
+         unless VectorSSE::valid_packed_type( type )
+            raise ArgumentError.new( "invalid packed matrix type for argument 0" )
+         end
+
+         if rows < MIN_ROW_COL_COUNT
+            raise ArgumentError.new( "row count must be greater than zero for argument 1" )
+         end
+
+         if cols < MIN_ROW_COL_COUNT
+            raise ArgumentError.new( "column count must be greater than zero for argument 2" )
+         end
+
+         if data && ( data.class != ::Array )
+            raise ArgumentError.new( "expected value of type Array for argument 3" )
+         end
+
+         if data && ( data.length != rows * cols )
+            raise ArgumentError.new( "size does not match matrix size" )
+         end
+
+         if QUANTIZED_RANGE.key?( type )
+            if scale == 0
+               raise ArgumentError.new( "scale must be non-zero" )
+            end
+            unless zero_point.is_a?( Integer ) && QUANTIZED_RANGE[ type ].include?( zero_point )
+               raise ArgumentError.new( "zero point out of range for packed type" )
+            end
+         else
+            scale = 1.0
+            zero_point = 0
+         end
+
+         @type = type
+         @rows = rows
+         @cols = cols
+         @scale = scale.to_f
+         @zero_point = zero_point
+
+         @bytes = VectorSSE::pack(
+            data || ::Array.new( rows * cols, 0 ), @type, @scale, @zero_point )
+      end
+
+      def bytesize
+         @bytes.bytesize
+      end
+
+      def at( row, col )
+
+         if ( row < 0 ) || ( row >= @rows )
+            raise IndexError.new( "row index out of bounds" )
+         end
+
+         if ( col < 0 ) || ( col >= @cols )
+            raise IndexError.new( "column index out of bounds" )
+         end
+
+         size = BYTES_PER_ELEMENT[ @type ]
+         VectorSSE::unpack(
+            @bytes.byteslice( ( row * @cols + col ) * size, size ),
+            @type, @scale, @zero_point ).first
+      end
+
+      # Dequantizes to an F32 Mat.
+      #
+      def to_mat
+         Mat.new( Type::F32, @rows, @cols,
+            VectorSSE::unpack( @bytes, @type, @scale, @zero_point ) )
+      end
+
+      # Matrix product of two packed matrices of the same type. S8 products
+      # accumulate exactly in 32-bit integers; the other types accumulate in
+      # f32. The result is an F32 Mat.
+      #
+      def *( other )
+
+         unless other.class == self.class
+            raise ArgumentError.new(
+               "expected argument of type #{self.class} for argument 0" )
+         end
+
+         if other.type != @type
+            raise ArgumentError.new( "packed matrix types must match" )
+         end
+
+         if @cols != other.rows
+            raise "invalid matrix dimensions"
+         end
+
+         Mat.new( Type::F32, @rows, other.cols, VectorSSE::mul_packed( @type,
+            @bytes, @rows, @cols, @scale, @zero_point,
+            other.bytes, other.rows, other.cols, other.scale, other.zero_point ) )
+      end
+
+
+      protected
+
+
+      attr_reader :bytes
+
+   end
+
+
+   # Sparse F32 or F64 matrix in compressed sparse row (CSR) form. Only the
+   # nonzero values are stored, along with their column indices and the
+   # offset of each row's first nonzero. Products with dense vectors and
+   # matrices skip the zeros entirely.
+   #
+   class SparseMat
+      include Shareable
+
+      MIN_ROW_COL_COUNT = 1
+
+      INDEX_BYTES = 4
+
+      attr_reader :type
+      attr_reader :rows
+      attr_reader :cols
+
+      # Builds a matrix from coordinate (COO) triples given as three equal
+      # length arrays. Triples may be in any order; duplicates are summed.
+      #
+      def self.from_coo( type, rows, cols, row_indices, col_indices, values )
+         result = new( type, rows, cols )
+
+         csr = case type
+         when Type::F32
+            VectorSSE::csr_from_coo_f32( rows, cols, row_indices, col_indices, values )
+         when Type::F64
+            VectorSSE::csr_from_coo_f64( rows, cols, row_indices, col_indices, values )
+         end
+
+         result.send( :replace_csr, *csr )
+         result
+      end
+
+      # Builds a matrix from the nonzero elements of a dense Mat.
+      #
+      def self.from_dense( mat )
+
+         unless mat.is_a?( Mat )
+            raise ArgumentError.new( "expected argument of type Mat for argument 0" )
+         end
+
+         result = new( mat.type, mat.rows, mat.cols )
+
+         csr = case mat.type
+         when Type::F32
+            VectorSSE::csr_from_dense_f32( dense_data( mat ), mat.rows, mat.cols )
+         when Type::F64
+            VectorSSE::csr_from_dense_f64( dense_data( mat ), mat.rows, mat.cols )
+         end
+
+         result.send( :replace_csr, *csr )
+         result
+      end
+
+      # Creates an all-zero matrix. Use from_coo or from_dense to build one
+      # with nonzero elements.
+      #
+      def initialize( type, rows, cols )
+
+         unless [ Type::F32, Type::F64 ].include?( type )
+            raise ArgumentError.new( "sparse matrices must be F32 or F64" )
+         end
+
+         if rows < MIN_ROW_COL_COUNT
+            raise ArgumentError.new( "row count must be greater than zero for argument 1" )
+         end
+
+         if cols < MIN_ROW_COL_COUNT
+            raise ArgumentError.new( "column count must be greater than zero for argument 2" )
+         end
+
+         @type = type
+         @rows = rows
+         @cols = cols
+
+         replace_csr( ''.b, ''.b, [ 0 ].pack( 'L' ) * ( rows + 1 ) )
+      end
+
+      # Number of stored (nonzero) elements.
+      #
+      def nnz
+         @col_indices.bytesize / INDEX_BYTES
+      end
+
+      def density
+         nnz.to_f / ( @rows * @cols )
+      end
+
+      def at( row, col )
+
+         if ( row < 0 ) || ( row >= @rows )
+            raise IndexError.new( "row index out of bounds" )
+         end
+
+         if ( col < 0 ) || ( col >= @cols )
+            raise IndexError.new( "column index out of bounds" )
+         end
+
+         row_begin, row_end = @row_ptr.byteslice( row * INDEX_BYTES, 2 * INDEX_BYTES ).unpack( 'L2' )
+         offset = @col_indices.byteslice(
+            row_begin * INDEX_BYTES, ( row_end - row_begin ) * INDEX_BYTES ).unpack( 'L*' ).index( col )
+         return 0.0 if offset.nil?
+
+         size = value_bytes
+         @values.byteslice( ( row_begin + offset ) * size, size ).unpack(
+            ( @type == Type::F32 ) ? 'f' : 'd' ).first
+      end
+
+      def to_mat
+         dense = case @type
+         when Type::F32
+            VectorSSE::csr_to_dense_f32( @values, @col_indices, @row_ptr, @cols )
+         when Type::F64
+            VectorSSE::csr_to_dense_f64( @values, @col_indices, @row_ptr, @cols )
+         end
+
+         Mat.new( @type, @rows, @cols, dense )
+      end
+
+      # Product with a dense VectorSSE::Array of length cols (returning an
+      # Array of length rows) or a dense Mat with cols rows (returning a
+      # Mat). Large products are split across threads by rows, balanced so
+      # that each thread gets a similar number of nonzeros.
+      #
+      def *( other )
+
+         if other.is_a?( VectorSSE::Array )
+
+            if other.length != @cols
+               raise "invalid vector dimensions"
+            end
+
+            result = VectorSSE::Array.new( @type )
+            result.replace( case @type
+               when Type::F32
+                  VectorSSE::spmv_f32( @values, @col_indices, @row_ptr, @cols, other )
+               when Type::F64
+                  VectorSSE::spmv_f64( @values, @col_indices, @row_ptr, @cols, other )
+               end )
+            result
+
+         elsif other.is_a?( Mat )
+
+            if other.rows != @cols
+               raise "invalid matrix dimensions"
+            end
+
+            Mat.new( @type, @rows, other.cols, case @type
+               when Type::F32
+                  VectorSSE::spmm_f32( @values, @col_indices, @row_ptr, @cols, dense_data( other ), other.cols )
+               when Type::F64
+                  VectorSSE::spmm_f64( @values, @col_indices, @row_ptr, @cols, dense_data( other ), other.cols )
+               end )
+
+         else
+            raise ArgumentError.new( "expected argument of type VectorSSE::Array or Mat for argument 0" )
+         end
+      end
+
+
+      # Mat keeps its element array protected from other classes.
+      #
+      def self.dense_data( mat )
+         mat.send( :data )
+      end
+      private_class_method :dense_data
+
+
+      protected
+
+
+      def dense_data( mat )
+         SparseMat.send( :dense_data, mat )
+      end
+
+      def replace_csr( values, col_indices, row_ptr )
+         @values = values.freeze
+         @col_indices = col_indices.freeze
+         @row_ptr = row_ptr.freeze
+      end
+
+      def value_bytes
+         ( @type == Type::F32 ) ? 4 : 8
+      end
+
+   end
+
+
+   class Array < Array
+      include Shareable
+
+      attr_reader :type
+
+      def initialize( type, size=0, val=nil )
+         super( size, val )
+
+         if VectorSSE::valid_type( type )
+            @type = type
+         else
+            raise "invalid SSE vector type"
+         end
+      end
+
+      def <<( value )
+         unless [ Integer, Float ].include? value.class
+            raise ArgumentError.new(
+               "expected argument of type Integer or Float for argument 0" )
+         end
+         super( value )
+      end
+
+      def insert( index, *values )
+         values.each_with_index do |value,arg_index|
+            unless [ Integer, Float ].include? value.class
+               raise ArgumentError.new(
+                  "expected argument of type Integer or Float for argument #{arg_index}" )
+            end
+         end
+         super( index, values )
+      end
+
+      def []=( index, value )
+         unless [ Integer, Float ].include? value.class
+            raise ArgumentError.new(
+               "expected argument of type Integer or Float for argument 1" )
+         end
+         super( index, value )
+      end
+ 
+      # Note:
+      # This method replaces the base class implementation of '+', which
+      # performs concatenation. To concatenate, see #concat.
+      #
+      def +( other )
+
+         if [ Integer, Float ].include? other.class
+
+            other = ::Array.new( self.length, other )
+
+         elsif other.class != self.class
+
+            raise ArgumentError.new(
+               "expect argument of type #{self.class}, Integer, or Float for argument 0" )
+
+         end
+
+         # Mixed types are converted to the common type as the kernel reads
+         # its operands.
+         type = other.is_a?( self.class ) ? VectorSSE::promote_type( @type, other.type ) : @type
+         result = self.class.new( type )
+
+         case type
+         when Type::S32
+            result.replace( VectorSSE::add_s32( self, other ) )
+         when Type::S64
+            result.replace( VectorSSE::add_s64( self, other ) )
+         when Type::F32
+            result.replace( VectorSSE::add_f32( self, other ) )
+         when Type::F64
+            result.replace( VectorSSE::add_f64( self, other ) )
+         end
+
+         result
+      end
+
+      # Note:
+      # This method replaces the base class implementation of '-', which
+      # removes items that are found in 'other'.
+      #
+      def -( other )
+
+         if [ Integer, Float ].include? other.class
+            other = ::Array.new( self.length, other )
+         elsif other.class != self.class
+            raise ArgumentError.new(
+               "expected argument of type #{self.class}, Integer, or Float for argument 0" )
+         end
+
+         type = other.is_a?( self.class ) ? VectorSSE::promote_type( @type, other.type ) : @type
+         result = self.class.new( type )
+
+         case type
+         when Type::S32
+            result.replace( VectorSSE::sub_s32( self, other ) )
+         when Type::S64
+            result.replace( VectorSSE::sub_s64( self, other ) )
+         when Type::F32
+            result.replace( VectorSSE::sub_f32( self, other ) )
+         when Type::F64
+            result.replace( VectorSSE::sub_f64( self, other ) )
+         end
+
+         result
+      end
+
+      def sum
+         sum_result = 0
+
+         case @type
          when Type::S32
             sum_result = VectorSSE::sum_s32( self )
          when Type::S64
@@ -465,6 +1734,279 @@ module VectorSSE
          result
       end
 
+      # Running sum of the elements. An exclusive scan shifts the result one
+      # position to the right so that the first element is zero, which is
+      # handy for turning bucket counts into bucket offsets.
+      #
+      def cumsum( exclusive: false )
+         result = self.class.new( @type )
+
+         case @type
+         when Type::S32
+            result.replace( VectorSSE::cumsum_s32( self, 1, self.length, 1, exclusive ) )
+         when Type::S64
+            result.replace( VectorSSE::cumsum_s64( self, 1, self.length, 1, exclusive ) )
+         when Type::F32
+            result.replace( VectorSSE::cumsum_f32( self, 1, self.length, 1, exclusive ) )
+         when Type::F64
+            result.replace( VectorSSE::cumsum_f64( self, 1, self.length, 1, exclusive ) )
+         end
+
+         result
+      end
+
+      # Running product of the elements. See #cumsum.
+      #
+      def cumprod( exclusive: false )
+         result = self.class.new( @type )
+
+         case @type
+         when Type::S32
+            result.replace( VectorSSE::cumprod_s32( self, 1, self.length, 1, exclusive ) )
+         when Type::S64
+            result.replace( VectorSSE::cumprod_s64( self, 1, self.length, 1, exclusive ) )
+         when Type::F32
+            result.replace( VectorSSE::cumprod_f32( self, 1, self.length, 1, exclusive ) )
+         when Type::F64
+            result.replace( VectorSSE::cumprod_f64( self, 1, self.length, 1, exclusive ) )
+         end
+
+         result
+      end
+
+      # With an index array (an S32/S64 VectorSSE::Array or Array of
+      # Integers), returns the elements at those indices. With an Integer,
+      # returns the first 'indices' elements like Array#take.
+      #
+      def take( indices )
+         return super( indices ) if indices.is_a?( Integer )
+
+         VectorSSE::valid_index_array( indices )
+
+         result = self.class.new( @type )
+         result.replace( VectorSSE::take( self, 1, indices ) )
+         result
+      end
+
+      # Stores values[ i ] at indices[ i ], in place. A single Integer or
+      # Float value is stored at every index.
+      #
+      def put( indices, values )
+         VectorSSE::valid_index_array( indices )
+
+         if [ Integer, Float ].include? values.class
+            values = ::Array.new( indices.length, values )
+         end
+
+         VectorSSE::put( self, 1, indices, values )
+         self
+      end
+
+      # Adds values[ i ] to the element at indices[ i ], in place. Repeated
+      # indices accumulate.
+      #
+      def index_add!( indices, values )
+         VectorSSE::valid_index_array( indices )
+
+         case @type
+         when Type::S32 then VectorSSE::index_add_s32( self, 1, indices, values )
+         when Type::S64 then VectorSSE::index_add_s64( self, 1, indices, values )
+         when Type::F32 then VectorSSE::index_add_f32( self, 1, indices, values )
+         when Type::F64 then VectorSSE::index_add_f64( self, 1, indices, values )
+         end
+
+         self
+      end
+
+      # Counts of the elements falling in each bin, as an S64 array. 'bins'
+      # is either a bin count, with the bins spaced evenly over 'range'
+      # (the element range by default, or an inclusive Range or [ low, high ]
+      # pair), or a non-decreasing Array of bin edges. Each bin includes its
+      # left edge and the last bin also includes its right edge. Elements
+      # outside the bins are not counted.
+      #
+      def histogram( bins: 10, range: nil )
+         result = self.class.new( Type::S64 )
+
+         if bins.is_a?( Integer )
+            low, high = histogram_range( range )
+            result.replace( VectorSSE::histogram( self, bins, low, high ) )
+         else
+            result.replace( VectorSSE::histogram_edges( self, bins ) )
+         end
+
+         result
+      end
+
+      # Bin index of each element, as an S32 array: the number of 'edges'
+      # that are less than or equal to it. 'edges' must be non-decreasing.
+      #
+      def digitize( edges )
+         result = self.class.new( Type::S32 )
+         result.replace( VectorSSE::digitize( self, edges ) )
+         result
+      end
+
+      # Discrete convolution with 'kernel', an Array of values. Only F32 and
+      # F64 arrays are supported. :full returns every partial overlap
+      # (length + kernel.length - 1 elements), :same keeps the length of
+      # self with the kernel centred, and :valid returns only positions
+      # where the kernel lies entirely inside self.
+      #
+      def convolve( kernel, mode: :full )
+         correlate_values( kernel.reverse, mode )
+      end
+
+      # Cross-correlation, which is convolution without reversing the
+      # kernel. See #convolve.
+      #
+      def correlate( kernel, mode: :valid )
+         correlate_values( kernel, mode )
+      end
+
+      # Sorted copy, with NaNs last. With a block, falls back to Array#sort.
+      #
+      def sort( &block )
+         return super( &block ) if block
+
+         result = self.class.new( @type )
+
+         case @type
+         when Type::S32
+            result.replace( VectorSSE::sort_s32( self ) )
+         when Type::S64
+            result.replace( VectorSSE::sort_s64( self ) )
+         when Type::F32
+            result.replace( VectorSSE::sort_f32( self ) )
+         when Type::F64
+            result.replace( VectorSSE::sort_f64( self ) )
+         end
+
+         result
+      end
+
+      def sort!( &block )
+         return super( &block ) if block
+
+         replace( sort )
+      end
+
+      # Indices that sort the array, as an index array. Equal elements keep
+      # their original order.
+      #
+      def argsort
+         result = self.class.new( index_type )
+
+         case @type
+         when Type::S32
+            result.replace( VectorSSE::argsort_s32( self ) )
+         when Type::S64
+            result.replace( VectorSSE::argsort_s64( self ) )
+         when Type::F32
+            result.replace( VectorSSE::argsort_f32( self ) )
+         when Type::F64
+            result.replace( VectorSSE::argsort_f64( self ) )
+         end
+
+         result
+      end
+
+      # The 'k' largest elements, largest first. Of equal elements the
+      # earliest are selected, and NaNs never are. With 'indices', returns
+      # [ values, indices ] where indices is an index array of their
+      # positions.
+      #
+      def top_k( k, indices: false )
+         selected = case @type
+         when Type::S32 then VectorSSE::top_k_s32( self, k )
+         when Type::S64 then VectorSSE::top_k_s64( self, k )
+         when Type::F32 then VectorSSE::top_k_f32( self, k )
+         when Type::F64 then VectorSSE::top_k_f64( self, k )
+         end
+
+         values = self.class.new( @type )
+         values.replace( selected[ 0 ] )
+         return values unless indices
+
+         positions = self.class.new( index_type )
+         positions.replace( selected[ 1 ] )
+         [ values, positions ]
+      end
+
+      # Returns a copy converted to 'type'. See Mat#astype.
+      #
+      def astype( type, rounding: :nearest, saturate: true )
+
+         result = self.class.new( type )
+         result.replace( VectorSSE::convert(
+            self, @type, type, VectorSSE::rounding_mode( rounding ), saturate ) )
+         result
+      end
+
+
+      protected
+
+
+      def correlate_values( kernel, mode )
+
+         unless [ Type::F32, Type::F64 ].include?( @type )
+            raise ArgumentError.new( "convolution requires an F32 or F64 array" )
+         end
+
+         if !kernel.is_a?( ::Array ) || kernel.empty?
+            raise ArgumentError.new( "expected non-empty kernel array for argument 0" )
+         end
+
+         args = [ self, 1, length, kernel, 1, kernel.length, VectorSSE::convolution_mode( mode ) ]
+
+         result = self.class.new( @type )
+
+         case @type
+         when Type::F32
+            result.replace( VectorSSE::correlate_f32( *args )[ 0 ] )
+         when Type::F64
+            result.replace( VectorSSE::correlate_f64( *args )[ 0 ] )
+         end
+
+         result
+      end
+
+      # S32 when every position fits in 32 bits, S64 otherwise.
+      def index_type
+         ( length > 2**31 - 1 ) ? Type::S64 : Type::S32
+      end
+
+      # Bounds of the uniform histogram bins. A degenerate range is widened
+      # by one half on each side so the values still fall in a bin.
+      def histogram_range( range )
+         low, high = if range.nil?
+            empty? ? [ 0.0, 1.0 ] : minmax
+         elsif range.is_a?( Range )
+            # The last bin includes its right edge, which an exclusive
+            # Range would leave out.
+            if range.begin.nil? || range.end.nil?
+               raise ArgumentError.new( "histogram range must be bounded" )
+            end
+            if range.exclude_end?
+               raise ArgumentError.new( "histogram range must include its end" )
+            end
+            [ range.begin, range.end ]
+         else
+            range
+         end
+
+         if low == high
+            low -= 0.5
+            high += 0.5
+         end
+
+         if low > high
+            raise ArgumentError.new( "histogram range must be increasing" )
+         end
+
+         [ low, high ]
+      end
+
    end
    Arr = Array
 
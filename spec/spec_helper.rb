@@ -0,0 +1,12 @@
+# Runs the block with 'count' kernel threads and restores the previous
+# thread count afterwards. Returns the value of the block.
+def with_thread_count( count )
+   previous = VectorSSE.thread_count
+
+   begin
+      VectorSSE.thread_count = count
+      yield
+   ensure
+      VectorSSE.thread_count = previous
+   end
+end
@@ -0,0 +1,108 @@
+begin
+   require 'vector_sse'
+rescue StandardError => e
+   # vector_sse is not installed as a gem
+   require File.join( '..', 'lib', 'vector_sse' )
+end
+
+require 'stringio'
+
+RSpec.describe VectorSSE::Accumulator do
+
+   def reference( values )
+      mean = values.sum.to_f / values.length
+      [ mean, values.map { |value| ( value - mean ) ** 2 }.sum / values.length ]
+   end
+
+   describe "constructor" do
+
+      it "raises exception on invalid type" do
+         expect {
+            VectorSSE::Accumulator.new( VectorSSE::Type::S8 )
+         }.to raise_error ArgumentError, "invalid SSE accumulator type for argument 0"
+      end
+
+      it "starts empty" do
+         acc = VectorSSE::Accumulator.new( VectorSSE::Type::F64 )
+         expect( acc.count ).to eq( 0 )
+         expect( acc.sum ).to eq( 0.0 )
+         expect( acc.mean ).to be_nil
+         expect( acc.min ).to be_nil
+         expect( acc.variance ).to be_nil
+      end
+   end
+
+   describe "accumulation" do
+
+      it "computes statistics across array chunks" do
+         random = Random.new( 1 )
+         values = ::Array.new( 10003 ) { random.rand( 1000 ) - 500 }
+
+         [ VectorSSE::Type::S32, VectorSSE::Type::S64,
+           VectorSSE::Type::F32, VectorSSE::Type::F64 ].each do |type|
+            acc = VectorSSE::Accumulator.new( type )
+            values.each_slice( 777 ) { |chunk| acc << chunk }
+
+            mean, variance = reference( values )
+            expect( acc.count ).to eq( values.length )
+            expect( acc.sum ).to eq( values.sum )
+            expect( acc.min ).to eq( values.min )
+            expect( acc.max ).to eq( values.max )
+            expect( acc.mean ).to be_within( 1e-9 ).of( mean )
+            expect( acc.variance ).to be_within( 1e-6 ).of( variance )
+            expect( acc.variance( ddof: 1 ) ).to be_within( 1e-6 ).of( variance * values.length / ( values.length - 1 ) )
+         end
+      end
+
+      it "reads packed values split at arbitrary byte offsets" do
+         values = [ 1.5, -2.25, 3.0, 8.5, -0.5, 7.0, 2.0 ]
+         bytes = values.pack( 'f*' )
+
+         acc = VectorSSE::Accumulator.new( VectorSSE::Type::F32 )
+         acc << bytes.byteslice( 0, 3 ) << bytes.byteslice( 3, 10 ) << bytes.byteslice( 13, 15 )
+         expect( acc.pending_bytes ).to eq( 0 )
+         expect( acc.count ).to eq( values.length )
+         expect( acc.sum ).to eq( values.sum )
+         expect( acc.max ).to eq( 8.5 )
+      end
+
+      it "reads an IO to the end" do
+         values = ( 1..5000 ).map( &:to_f )
+         acc = VectorSSE::Accumulator.new( VectorSSE::Type::F64 )
+         acc << StringIO.new( values.pack( 'd*' ) )
+
+         expect( acc.count ).to eq( 5000 )
+         expect( acc.mean ).to eq( 2500.5 )
+      end
+
+      it "reads values from an Enumerator" do
+         acc = VectorSSE::Accumulator.new( VectorSSE::Type::S64 )
+         acc << ( 1..10 ).each
+         expect( acc.sum ).to eq( 55 )
+         expect( acc.variance ).to be_within( 1e-12 ).of( 8.25 )
+      end
+
+      it "merges accumulators built on separate threads" do
+         values = ( 1..40000 ).map { |value| ( value % 97 ) * 0.5 }
+         accs = values.each_slice( 10000 ).map do |slice|
+            Thread.new do
+               VectorSSE::Accumulator.new( VectorSSE::Type::F64 ) << slice.pack( 'd*' )
+            end
+         end.map( &:value )
+
+         total = accs.inject { |merged,acc| merged.merge( acc ) }
+         mean, variance = reference( values )
+         expect( total.count ).to eq( values.length )
+         expect( total.mean ).to be_within( 1e-9 ).of( mean )
+         expect( total.variance ).to be_within( 1e-9 ).of( variance )
+      end
+
+      it "raises exception when merging different types" do
+         expect {
+            VectorSSE::Accumulator.new( VectorSSE::Type::F32 ).merge!(
+               VectorSSE::Accumulator.new( VectorSSE::Type::F64 ) )
+         }.to raise_error ArgumentError, "accumulator types must match"
+      end
+   end
+
+end
@@ -5,6 +5,8 @@ rescue StandardError => e
    require File.join( '..', 'lib', 'vector_sse' )
 end
 
+require_relative 'spec_helper'
+
 RSpec.describe VectorSSE::Mat do
 
    describe "constructor" do
@@ -371,4 +373,843 @@ RSpec.describe VectorSSE::Mat do
       end
    end
 
-end
\ No newline at end of file
+   describe "prefix sum" do
+      mat = VectorSSE::Mat.new( VectorSSE::Type::S32, 3, 5 )
+      mat.fill([
+          1,  2,  3,  4,  5,
+          6,  7,  8,  9, 10,
+         11, 12, 13, 14, 15
+      ])
+
+      it "accumulates down each column" do
+         result = mat.cumsum( axis: 0 )
+         expect( result.rows ).to eq( 3 )
+         expect( result.cols ).to eq( 5 )
+
+         [  1,  2,  3,  4,  5,
+            7,  9, 11, 13, 15,
+           18, 21, 24, 27, 30 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "accumulates across each row" do
+         result = mat.cumsum( axis: 1 )
+
+         [  1,  3,  6, 10, 15,
+            6, 13, 21, 30, 40,
+           11, 23, 36, 50, 65 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "returns exclusive running sum" do
+         result = mat.cumsum( axis: 0, exclusive: true )
+
+         [  0,  0,  0,  0,  0,
+            1,  2,  3,  4,  5,
+            7,  9, 11, 13, 15 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         result = mat.cumsum( axis: 1, exclusive: true )
+
+         [  0,  1,  3,  6, 10,
+            0,  6, 13, 21, 30,
+            0, 11, 23, 36, 50 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "raises exception on invalid axis" do
+         expect {
+            mat.cumsum( axis: 2 )
+         }.to raise_error ArgumentError, "axis must be 0 or 1"
+      end
+   end
+
+   describe "pairwise distances" do
+      left = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 3 )
+      left.fill([
+         1.0, 2.0, 2.0,
+         0.0, 3.0, 4.0
+      ])
+      right = VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 3 )
+      right.fill([
+         1.0, 2.0, 2.0,
+         0.0, 0.0, 0.0,
+         2.0, 4.0, 4.0
+      ])
+
+      it "returns euclidean distances" do
+         result = VectorSSE.pairwise_distances( left, right, metric: :l2 )
+         expect( result.type ).to eq( VectorSSE::Type::F64 )
+         expect( result.rows ).to eq( 2 )
+         expect( result.cols ).to eq( 3 )
+
+         [ 0.0, 3.0, 3.0,
+           Math.sqrt( 6 ), 5.0, Math.sqrt( 5 ) ].each_with_index do |value,index|
+            expect( result[ index ] ).to be_within( 1e-9 ).of( value )
+         end
+      end
+
+      it "returns cosine distances and dot products" do
+         result = VectorSSE.pairwise_distances( left, right, metric: :cosine )
+         [ 0.0, 1.0, 0.0,
+           1.0 - 14.0 / 15.0, 1.0, 1.0 - 14.0 / 15.0 ].each_with_index do |value,index|
+            expect( result[ index ] ).to be_within( 1e-9 ).of( value )
+         end
+
+         result = VectorSSE.pairwise_distances( left, right, metric: :dot )
+         [ 9.0, 0.0, 18.0, 14.0, 0.0, 28.0 ].each_with_index do |value,index|
+            expect( result[ index ] ).to be_within( 1e-9 ).of( value )
+         end
+      end
+
+      it "raises exception on mismatched column count" do
+         other = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 2 )
+         expect {
+            VectorSSE.pairwise_distances( left, other )
+         }.to raise_error "invalid matrix dimensions"
+      end
+
+      it "raises exception on unsupported type or metric" do
+         ints = VectorSSE::Mat.new( VectorSSE::Type::S32, 2, 3 )
+         expect {
+            VectorSSE.pairwise_distances( ints, ints )
+         }.to raise_error ArgumentError
+         expect {
+            VectorSSE.pairwise_distances( left, right, metric: :manhattan )
+         }.to raise_error ArgumentError
+      end
+   end
+
+   describe "nearest neighbor search" do
+
+      it "matches a brute force search" do
+         random = Random.new( 42 )
+         cols = 7
+         catalogue_data = ::Array.new( 300 * cols ) { random.rand( -1.0..1.0 ) }
+         query_data = ::Array.new( 5 * cols ) { random.rand( -1.0..1.0 ) }
+
+         catalogue = VectorSSE::Mat.new( VectorSSE::Type::F32, 300, cols, catalogue_data )
+         query = VectorSSE::Mat.new( VectorSSE::Type::F32, 5, cols, query_data )
+
+         indices, distances = VectorSSE.knn( query, catalogue, 4 )
+         expect( indices.type ).to eq( VectorSSE::Type::S32 )
+         expect( indices.rows ).to eq( 5 )
+         expect( indices.cols ).to eq( 4 )
+
+         5.times do |row|
+            q = query_data[ row * cols, cols ]
+            expected = 300.times.map do |index|
+               c = catalogue_data[ index * cols, cols ]
+               [ Math.sqrt( q.zip( c ).map { |a,b| ( a - b ) ** 2 }.sum ), index ]
+            end.sort.first( 4 )
+
+            expected.each_with_index do |(distance,index),rank|
+               expect( indices.at( row, rank ) ).to eq( index )
+               expect( distances.at( row, rank ) ).to be_within( 1e-4 ).of( distance )
+            end
+         end
+      end
+
+      it "ranks largest dot product first" do
+         catalogue = VectorSSE::Mat.new( VectorSSE::Type::F64, 4, 2, [
+            1.0, 0.0,
+            3.0, 1.0,
+            -2.0, 0.0,
+            2.0, 2.0
+         ])
+         query = VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 2, [ 1.0, 0.5 ] )
+
+         indices, distances = VectorSSE.knn( query, catalogue, 2, metric: :dot )
+         expect( indices[ 0 ] ).to eq( 1 )
+         expect( indices[ 1 ] ).to eq( 3 )
+         expect( distances[ 0 ] ).to be_within( 1e-9 ).of( 3.5 )
+         expect( distances[ 1 ] ).to be_within( 1e-9 ).of( 3.0 )
+      end
+
+      it "returns rows whose distance overflows or is NaN" do
+         query = VectorSSE::Mat.new( VectorSSE::Type::F32, 1, 2, [ 0.0, 0.0 ] )
+         catalogue = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 1e20, 0.0, 1.0, 1.0 ] )
+
+         indices, distances = VectorSSE.knn( query, catalogue, 2 )
+         expect( [ indices[ 0 ], indices[ 1 ] ] ).to eq( [ 1, 0 ] )
+         expect( distances[ 1 ] ).to eq( Float::INFINITY )
+
+         catalogue = VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 2,
+            [ Float::NAN, 0.0, 1e200, 0.0, 1.0, 0.0 ] )
+         indices, distances = VectorSSE.knn( query.astype( VectorSSE::Type::F64 ), catalogue, 3 )
+         expect( ( 0...3 ).map { |pos| indices[ pos ] } ).to eq( [ 2, 1, 0 ] )
+         expect( distances[ 1 ] ).to eq( Float::INFINITY )
+         expect( distances[ 2 ].nan? ).to be true
+      end
+
+      it "gives the same neighbors when query rows are split across threads" do
+         random = Random.new( 11 )
+         catalogue = VectorSSE::Mat.new( VectorSSE::Type::F64, 300, 9,
+            ::Array.new( 300 * 9 ) { random.rand( -1.0..1.0 ) } )
+         query = VectorSSE::Mat.new( VectorSSE::Type::F64, 70, 9,
+            ::Array.new( 70 * 9 ) { random.rand( -1.0..1.0 ) } )
+
+         serial = VectorSSE.knn( query, catalogue, 6 ).map( &:to_s )
+
+         previous = VectorSSE.tuning
+         begin
+            VectorSSE.tuning = { gemm_work_per_thread: 1 }
+            with_thread_count( 4 ) do
+               expect( VectorSSE.knn( query, catalogue, 6 ).map( &:to_s ) ).to eq( serial )
+
+               distances = VectorSSE.pairwise_distances( query, query )
+               expect( ( 0...70 ).map { |row| distances.at( row, row ) }.uniq ).to eq( [ 0.0 ] )
+            end
+         ensure
+            VectorSSE.tuning = previous
+         end
+      end
+
+      it "raises exception on invalid k" do
+         catalogue = VectorSSE::Mat.new( VectorSSE::Type::F32, 3, 2 )
+         query = VectorSSE::Mat.new( VectorSSE::Type::F32, 1, 2 )
+         expect {
+            VectorSSE.knn( query, catalogue, 4 )
+         }.to raise_error ArgumentError
+      end
+   end
+
+   describe "type conversion" do
+
+      it "converts to requested type" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 2, [ 1.6, -1.6, 2.5, 7.0 ] )
+
+         result = mat.astype( VectorSSE::Type::S32, rounding: :truncate )
+         expect( result.type ).to eq( VectorSSE::Type::S32 )
+         expect( result.rows ).to eq( 2 )
+         expect( result.cols ).to eq( 2 )
+
+         [ 1, -1, 2, 7 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "promotes mixed operand types in addition" do
+         left = VectorSSE::Mat.new( VectorSSE::Type::S32, 1, 3, [ 1, 2, 3 ] )
+         right = VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 3, [ 0.5, 0.25, 0.125 ] )
+
+         result = left + right
+         expect( result.type ).to eq( VectorSSE::Type::F64 )
+         [ 1.5, 2.25, 3.125 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         result = left - right
+         expect( result.type ).to eq( VectorSSE::Type::F64 )
+         [ 0.5, 1.75, 2.875 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+   end
+
+   describe "broadcasting" do
+      types = [ VectorSSE::Type::S32, VectorSSE::Type::S64, VectorSSE::Type::F32, VectorSSE::Type::F64 ]
+      data = [
+          1,  2,  3,  4,  5,
+          6,  7,  8,  9, 10,
+         11, 12, 13, 14, 15
+      ]
+
+      it "adds a row vector to every row" do
+         types.each do |type|
+            mat = VectorSSE::Mat.new( type, 3, 5, data )
+            bias = VectorSSE::Mat.new( type, 1, 5, [ 10, 20, 30, 40, 50 ] )
+
+            result = mat + bias
+            expect( result.type ).to eq( type )
+            expect( result.rows ).to eq( 3 )
+            expect( result.cols ).to eq( 5 )
+
+            data.each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value + ( index % 5 + 1 ) * 10 )
+            end
+
+            result = bias - mat
+            data.each_with_index do |value,index|
+               expect( result[ index ] ).to eq( ( index % 5 + 1 ) * 10 - value )
+            end
+         end
+      end
+
+      it "scales each row by a column vector" do
+         types.each do |type|
+            mat = VectorSSE::Mat.new( type, 3, 5, data )
+            scale = VectorSSE::Mat.new( type, 3, 1, [ 2, -1, 3 ] )
+
+            result = mat.multiply( scale )
+            data.each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value * [ 2, -1, 3 ][ index / 5 ] )
+            end
+         end
+      end
+
+      it "forms an outer sum from a row and a column vector" do
+         row = VectorSSE::Mat.new( VectorSSE::Type::F32, 1, 3, [ 1.0, 2.0, 3.0 ] )
+         col = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 1, [ 10.0, 20.0 ] )
+
+         result = col + row
+         expect( result.rows ).to eq( 2 )
+         expect( result.cols ).to eq( 3 )
+         [ 11.0, 12.0, 13.0, 21.0, 22.0, 23.0 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "divides elementwise" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 3, [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 ] )
+         divisor = VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 3, [ 2.0, 4.0, 8.0 ] )
+
+         result = mat / divisor
+         [ 0.5, 0.5, 0.375, 2.0, 1.25, 0.75 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         result = mat / 2
+         [ 0.5, 1.0, 1.5, 2.0, 2.5, 3.0 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "floors integer division like Integer#/" do
+         [ VectorSSE::Type::S32, VectorSSE::Type::S64 ].each do |type|
+            mat = VectorSSE::Mat.new( type, 1, 5, [ 7, -7, 7, -7, 6 ] )
+            divisor = VectorSSE::Mat.new( type, 1, 5, [ 2, 2, -2, -2, 3 ] )
+
+            result = mat / divisor
+            [ 3, -4, -4, 3, 2 ].each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value )
+            end
+         end
+      end
+
+      it "raises exception on integer division by zero" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::S32, 1, 2, [ 1, 2 ] )
+         expect {
+            mat / 0
+         }.to raise_error ZeroDivisionError
+      end
+
+      it "raises exception on incompatible shapes" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::S32, 3, 5, data )
+         other = VectorSSE::Mat.new( VectorSSE::Type::S32, 2, 5 )
+         expect {
+            mat.multiply( other )
+         }.to raise_error ArgumentError, "operands could not be broadcast together"
+      end
+   end
+
+   describe "linear solvers" do
+
+      def random_matrix( type, rows, cols, seed )
+         random = Random.new( seed )
+         VectorSSE::Mat.new( type, rows, cols,
+            ::Array.new( rows * cols ) { random.rand * 2.0 - 1.0 } )
+      end
+
+      it "factors with partial pivoting" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 3, [
+            1.0, 2.0, 3.0,
+            4.0, 5.0, 6.0,
+            7.0, 8.0, 10.0 ] )
+
+         lower, upper, permutation = mat.lu
+         expect( permutation ).to eq( [ 2, 0, 1 ] )
+         expect( lower.at( 0, 0 ) ).to eq( 1.0 )
+         expect( lower.at( 0, 2 ) ).to eq( 0.0 )
+         expect( upper.at( 2, 0 ) ).to eq( 0.0 )
+
+         product = lower * upper
+         3.times do |row|
+            3.times do |col|
+               expect( product.at( row, col ) ).to be_within( 1e-12 ).of( mat.at( permutation[ row ], col ) )
+            end
+         end
+      end
+
+      it "computes the determinant" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 3, [
+            1.0, 2.0, 3.0,
+            4.0, 5.0, 6.0,
+            7.0, 8.0, 10.0 ] )
+         expect( mat.det ).to be_within( 1e-12 ).of( -3.0 )
+
+         singular = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 1.0, 2.0, 2.0, 4.0 ] )
+         expect( singular.det ).to eq( 0.0 )
+      end
+
+      it "solves for a vector right-hand side" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 2.0, 1.0, 1.0, 3.0 ] )
+         b = VectorSSE::Array.new( VectorSSE::Type::F32 )
+         b.replace( [ 3.0, 5.0 ] )
+
+         x = mat.solve( b )
+         expect( x.class ).to eq( VectorSSE::Array )
+         expect( x[ 0 ] ).to be_within( 1e-6 ).of( 0.8 )
+         expect( x[ 1 ] ).to be_within( 1e-6 ).of( 1.4 )
+      end
+
+      it "solves systems larger than one block" do
+         n = 150
+         mat = random_matrix( VectorSSE::Type::F64, n, n, 1 )
+         b = random_matrix( VectorSSE::Type::F64, n, 3, 2 )
+
+         residual = mat * mat.solve( b ) - b
+         ( n * 3 ).times do |pos|
+            expect( residual[ pos ] ).to be_within( 1e-9 ).of( 0.0 )
+         end
+      end
+
+      it "inverts a matrix" do
+         n = 70
+         mat = random_matrix( VectorSSE::Type::F64, n, n, 3 )
+
+         product = mat * mat.inverse
+         n.times do |row|
+            n.times do |col|
+               expect( product.at( row, col ) ).to be_within( 1e-9 ).of( ( row == col ) ? 1.0 : 0.0 )
+            end
+         end
+      end
+
+      it "raises exception on a singular matrix" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 2, [ 1.0, 2.0, 2.0, 4.0 ] )
+         expect {
+            mat.inverse
+         }.to raise_error RuntimeError, "matrix is singular"
+      end
+
+      it "raises exception on integer or non-square matrices" do
+         expect {
+            VectorSSE::Mat.new( VectorSSE::Type::S32, 2, 2 ).det
+         }.to raise_error ArgumentError, "linear solvers require an F32 or F64 matrix"
+         expect {
+            VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 3 ).lu
+         }.to raise_error RuntimeError, "matrix must be square"
+      end
+
+      it "computes the Cholesky factor" do
+         n = 100
+         base = random_matrix( VectorSSE::Type::F64, n, n, 4 )
+         spd = VectorSSE::Mat.new( VectorSSE::Type::F64, n, n )
+         n.times do |row|
+            n.times do |col|
+               sum = ( row == col ) ? n.to_f : 0.0
+               n.times { |common| sum += base.at( row, common ) * base.at( col, common ) }
+               spd.set( row, col, sum )
+            end
+         end
+
+         lower = spd.cholesky
+         expect( lower.at( 0, 1 ) ).to eq( 0.0 )
+
+         n.times do |row|
+            n.times do |col|
+               sum = 0.0
+               n.times { |common| sum += lower.at( row, common ) * lower.at( col, common ) }
+               expect( sum ).to be_within( 1e-9 ).of( spd.at( row, col ) )
+            end
+         end
+      end
+
+      it "raises exception when not positive definite" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 1.0, 2.0, 2.0, 1.0 ] )
+         expect {
+            mat.cholesky
+         }.to raise_error RuntimeError, "matrix is not positive definite"
+      end
+   end
+
+   describe "row gather and scatter" do
+
+      it "takes rows by index" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::S32, 3, 2, [ 1, 2, 3, 4, 5, 6 ] )
+
+         result = mat.take_rows( [ 2, 2, 0 ] )
+         expect( result.rows ).to eq( 3 )
+         expect( result.cols ).to eq( 2 )
+         [ 5, 6, 5, 6, 1, 2 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "raises exception on an empty row index array" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::S32, 3, 2 )
+         expect {
+            mat.take_rows( [] )
+         }.to raise_error ArgumentError, "take_rows needs at least one row index"
+      end
+
+      it "adds rows at repeated indices" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 5, [ 0.0 ] * 10 )
+         updates = VectorSSE::Mat.new( VectorSSE::Type::F32, 3, 5, ( 1..15 ).map( &:to_f ) )
+
+         mat.index_add!( [ 1, 0, 1 ], updates )
+         [ 6, 7, 8, 9, 10, 12, 14, 16, 18, 20 ].each_with_index do |value,index|
+            expect( mat[ index ] ).to eq( value.to_f )
+         end
+      end
+
+      it "raises exception on mismatched row updates" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2 )
+         updates = VectorSSE::Mat.new( VectorSSE::Type::F32, 1, 2 )
+         expect {
+            mat.index_add!( [ 0, 1 ], updates )
+         }.to raise_error RuntimeError, "invalid matrix dimensions"
+      end
+   end
+
+   describe "asynchronous multiplication" do
+
+      it "returns a future for a float product" do
+         [ VectorSSE::Type::F32, VectorSSE::Type::F64 ].each do |type|
+            left = VectorSSE::Mat.new( type, 2, 3, [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 ] )
+            right = VectorSSE::Mat.new( type, 3, 2, [ 1.0, 0.5, 1.0, 0.5, 1.0, 0.5 ] )
+
+            future = left.mul_async( right )
+            expect( future.class ).to eq( VectorSSE::Future )
+
+            result = future.value
+            expect( future.ready? ).to be_truthy
+            expect( result.type ).to eq( type )
+            expect( result.to_s ).to eq( ( left * right ).to_s )
+            expect( future.value ).to be( result )
+         end
+      end
+
+      it "copies the operands when the job is queued" do
+         left = VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 1, [ 2.0 ] )
+         right = VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 1, [ 3.0 ] )
+
+         future = left.mul_async( right )
+         left.set( 0, 0, 100.0 )
+         expect( future.value.at( 0, 0 ) ).to eq( 6.0 )
+      end
+
+      it "runs integer products on a Ruby thread" do
+         left = VectorSSE::Mat.new( VectorSSE::Type::S32, 1, 2, [ 1, 2 ] )
+         right = VectorSSE::Mat.new( VectorSSE::Type::S32, 2, 1, [ 3, 4 ] )
+
+         expect( left.mul_async( right ).wait.value.at( 0, 0 ) ).to eq( 11 )
+      end
+
+      it "raises exception on mismatched dimensions" do
+         left = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 3 )
+         expect {
+            left.mul_async( left )
+         }.to raise_error RuntimeError, "invalid matrix dimensions"
+      end
+
+      it "interrupts one of several threads waiting on a job" do
+         size = 1200
+         left = VectorSSE::Mat.new( VectorSSE::Type::F64, size, size, ::Array.new( size * size, 1.0 ) )
+         future = left.mul_async( left )
+
+         waiters = 2.times.map { Thread.new { future.wait } }
+         sleep 0.01
+         waiters[ 0 ].kill
+
+         expect( waiters[ 0 ].join( 5 ) ).to be( waiters[ 0 ] )
+         waiters[ 1 ].join
+         expect( future.value.at( 0, 0 ) ).to eq( size.to_f )
+      end
+
+      it "re-raises exceptions from an async block" do
+         future = VectorSSE.async { raise ArgumentError.new( "failed" ) }
+         expect {
+            future.value
+         }.to raise_error ArgumentError, "failed"
+      end
+   end
+
+   describe "convolution" do
+
+      # Direct 'same' mode cross-correlation, for comparison.
+      def reference( image, kernel )
+         ( 0...image.rows ).flat_map do |row|
+            ( 0...image.cols ).map do |col|
+               sum = 0.0
+               kernel.rows.times do |krow|
+                  kernel.cols.times do |kcol|
+                     r = row + krow - kernel.rows / 2
+                     c = col + kcol - kernel.cols / 2
+                     if ( r >= 0 ) && ( r < image.rows ) && ( c >= 0 ) && ( c < image.cols )
+                        sum += kernel.at( krow, kcol ) * image.at( r, c )
+                     end
+                  end
+               end
+               sum
+            end
+         end
+      end
+
+      it "convolves a matrix in every mode" do
+         image = VectorSSE::Mat.new( VectorSSE::Type::F32, 3, 3, ( 1..9 ).map( &:to_f ) )
+         kernel = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 1.0, 0.0, 0.0, -1.0 ] )
+
+         full = image.convolve2d( kernel )
+         expect( [ full.rows, full.cols ] ).to eq( [ 4, 4 ] )
+         expect( full.to_s ).to eq( VectorSSE::Mat.new( VectorSSE::Type::F32, 4, 4,
+            [ 1.0, 2.0, 3.0, 0.0, 4.0, 4.0, 4.0, -3.0, 7.0, 4.0, 4.0, -6.0, 0.0, -7.0, -8.0, -9.0 ] ).to_s )
+
+         valid = image.convolve2d( kernel, mode: :valid )
+         expect( valid.to_s ).to eq( VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 4.0, 4.0, 4.0, 4.0 ] ).to_s )
+
+         same = image.correlate2d( kernel, mode: :same )
+         expect( same.to_s ).to eq( VectorSSE::Mat.new( VectorSSE::Type::F32, 3, 3,
+            [ -1.0, -2.0, -3.0, -4.0, -4.0, -4.0, -7.0, -4.0, -4.0 ] ).to_s )
+      end
+
+      it "matches direct correlation for small and large kernels" do
+         random = Random.new( 13 )
+         image = VectorSSE::Mat.new( VectorSSE::Type::F64, 37, 29,
+            ::Array.new( 37 * 29 ) { random.rand( 8 ).to_f } )
+
+         with_thread_count( 4 ) do
+            [ [ 3, 3 ], [ 5, 5 ], [ 7, 7 ], [ 9, 4 ] ].each do |rows,cols|
+               kernel = VectorSSE::Mat.new( VectorSSE::Type::F64, rows, cols,
+                  ::Array.new( rows * cols ) { random.rand( 4 ).to_f } )
+               result = image.correlate2d( kernel, mode: :same )
+
+               expected = reference( image, kernel )
+               expect( ( 0...expected.length ).map { |pos| result[ pos ] } ).to eq( expected )
+            end
+         end
+      end
+
+      it "raises exception on mismatched kernel types" do
+         image = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2 )
+         expect {
+            image.convolve2d( VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 1 ) )
+         }.to raise_error ArgumentError
+         expect {
+            VectorSSE::Mat.new( VectorSSE::Type::S32, 2, 2 ).convolve2d( VectorSSE::Mat.new( VectorSSE::Type::S32, 1, 1 ) )
+         }.to raise_error ArgumentError, "convolution requires an F32 or F64 matrix"
+      end
+
+      it "raises exception on a kernel larger than the matrix in valid mode" do
+         image = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 3 )
+         [ [ 3, 1 ], [ 1, 4 ] ].each do |rows,cols|
+            kernel = VectorSSE::Mat.new( VectorSSE::Type::F64, rows, cols )
+            expect {
+               image.convolve2d( kernel, mode: :valid )
+            }.to raise_error ArgumentError, "kernel must not be larger than the matrix in :valid mode"
+            expect {
+               image.correlate2d( kernel, mode: :valid )
+            }.to raise_error ArgumentError, "kernel must not be larger than the matrix in :valid mode"
+         end
+         expect( image.convolve2d( VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 4 ) ).rows ).to eq( 4 )
+      end
+   end
+
+   describe "ractors" do
+
+      around_ractors = lambda do |&block|
+         experimental = Warning[ :experimental ]
+         Warning[ :experimental ] = false
+         begin
+            block.call
+         ensure
+            Warning[ :experimental ] = experimental
+         end
+      end
+
+      it "runs kernels in non-main ractors" do
+         around_ractors.call do
+            ractor = Ractor.new do
+               left = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 1.0, 2.0, 3.0, 4.0 ] )
+               vec = VectorSSE::Array.new( VectorSSE::Type::S32 )
+               vec.replace( [ 1, 2, 3 ] )
+               [ ( left * left ).to_s, vec.sum ]
+            end
+
+            expect( ractor.take ).to eq( [ "|7.0 10.0|\n|15.0 22.0|\n", 6 ] )
+         end
+      end
+
+      it "shares read-only matrices without copying" do
+         around_ractors.call do
+            mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 2, [ 1.0, 0.0, 0.0, 2.0 ] ).make_shareable
+            expect( Ractor.shareable?( mat ) ).to be true
+
+            ractor = Ractor.new( mat ) do |shared|
+               [ shared.object_id, ( shared * shared ).at( 1, 1 ) ]
+            end
+
+            expect( ractor.take ).to eq( [ mat.object_id, 4.0 ] )
+            expect {
+               mat.set( 0, 0, 5.0 )
+            }.to raise_error FrozenError
+         end
+      end
+
+      it "leaves copies and the caller's data writable" do
+         data = [ 1.0, 2.0 ]
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 1, 2, data ).make_shareable
+         expect( data.frozen? ).to be false
+
+         copy = mat.dup
+         copy.set( 0, 0, 3.0 )
+         expect( copy.at( 0, 0 ) ).to eq( 3.0 )
+         expect( mat.at( 0, 0 ) ).to eq( 1.0 )
+
+         expect {
+            mat.clone.set( 0, 0, 3.0 )
+         }.to raise_error FrozenError
+      end
+
+      it "only changes settings from the main ractor" do
+         around_ractors.call do
+            ractor = Ractor.new do
+               begin
+                  VectorSSE.thread_count = 1
+               rescue Ractor::UnsafeError => error
+                  error.class
+               end
+            end
+
+            expect( ractor.take ).to eq( Ractor::UnsafeError )
+         end
+      end
+   end
+
+
+   describe "gram and covariance" do
+
+      # Sums of products of column pairs after subtracting 'offsets'.
+      def reference( mat, offsets )
+         ( 0...mat.cols ).flat_map do |left|
+            ( 0...mat.cols ).map do |right|
+               ( 0...mat.rows ).sum do |row|
+                  ( mat.at( row, left ) - offsets[ left ] ) * ( mat.at( row, right ) - offsets[ right ] )
+               end
+            end
+         end
+      end
+
+      def means( mat )
+         ( 0...mat.cols ).map do |col|
+            ( 0...mat.rows ).sum { |row| mat.at( row, col ) } / mat.rows.to_f
+         end
+      end
+
+      it "computes the gram matrix" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 3, 2, [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 ] )
+         expect( mat.gram.to_s ).to eq(
+            VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2, [ 35.0, 44.0, 44.0, 56.0 ] ).to_s )
+      end
+
+      it "matches direct sums when threaded" do
+         random = Random.new( 41 )
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 300, 70,
+            ::Array.new( 300 * 70 ) { random.rand( 16 ).to_f } )
+
+         with_thread_count( 4 ) do
+            gram = mat.gram
+            expect( ( 0...70 * 70 ).map { |pos| gram[ pos ] } ).to eq( reference( mat, [ 0.0 ] * 70 ) )
+
+            covariance = mat.covariance
+            reference( mat, means( mat ) ).each_with_index do |value,pos|
+               expect( covariance[ pos ] ).to be_within( 1e-9 ).of( value / 299.0 )
+            end
+         end
+      end
+
+      it "applies ddof to the covariance" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 4, 2, [ 1.0, 2.0, 2.0, 4.0, 3.0, 6.0, 6.0, 0.0 ] )
+         expect( mat.covariance.to_s ).to eq(
+            VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 2, [ 14.0 / 3, -8.0 / 3, -8.0 / 3, 20.0 / 3 ] ).to_s )
+         expect( mat.covariance( ddof: 0 ).to_s ).to eq(
+            VectorSSE::Mat.new( VectorSSE::Type::F64, 2, 2, [ 3.5, -2.0, -2.0, 5.0 ] ).to_s )
+         expect {
+            mat.covariance( ddof: 4 )
+         }.to raise_error ArgumentError, "ddof must be less than the number of rows"
+      end
+
+      it "computes the correlation" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F64, 4, 3,
+            [ 1.0, 2.0, 4.0, 2.0, 4.0, 1.0, 3.0, 6.0, 3.0, 4.0, 8.0, 0.0 ] )
+         correlation = mat.correlation
+         expect( ( 0...3 ).map { |pos| correlation.at( pos, pos ) } ).to eq( [ 1.0, 1.0, 1.0 ] )
+         expect( correlation.at( 0, 1 ) ).to eq( 1.0 )
+         expect( correlation.at( 1, 0 ) ).to eq( 1.0 )
+         expect( correlation.at( 0, 2 ) ).to be_within( 1e-12 ).of( -Math.sqrt( 0.5 ) )
+      end
+
+      it "raises exception on integer matrices" do
+         expect {
+            VectorSSE::Mat.new( VectorSSE::Type::S32, 2, 2 ).gram
+         }.to raise_error ArgumentError, "Gram matrices require an F32 or F64 matrix"
+      end
+   end
+
+   describe "chain multiplication" do
+
+      def random_mat( type, rows, cols, random )
+         VectorSSE::Mat.new( type, rows, cols, ::Array.new( rows * cols ) {
+            ( type == VectorSSE::Type::S32 ) ? random.rand( 5 ) - 2 : random.rand( 5 ).to_f - 2.0 } )
+      end
+
+      it "finds the cheapest parenthesization" do
+         splits = VectorSSE.chain_order( [ 30, 35, 15, 5, 10, 20, 25 ] )
+         expect( splits[ 0 * 6 + 5 ] ).to eq( 2 )
+         expect( splits[ 0 * 6 + 2 ] ).to eq( 0 )
+         expect( splits[ 3 * 6 + 5 ] ).to eq( 4 )
+      end
+
+      it "matches left to right multiplication" do
+         random = Random.new( 7 )
+         shapes = [ 40, 3, 57, 1, 33, 9, 21 ]
+
+         with_thread_count( 4 ) do
+            [ VectorSSE::Type::F32, VectorSSE::Type::F64, VectorSSE::Type::S32 ].each do |type|
+               mats = shapes.each_cons( 2 ).map { |rows,cols| random_mat( type, rows, cols, random ) }
+               expect( VectorSSE.chain_mul( *mats ).to_s ).to eq( mats.reduce( :* ).to_s )
+            end
+         end
+      end
+
+      it "returns a copy of a single matrix" do
+         { VectorSSE::Type::S32 => [ 1, 2, 3, 4 ], VectorSSE::Type::F64 => [ 1.0, 2.0, 3.0, 4.0 ] }.each do |type,data|
+            mat = VectorSSE::Mat.new( type, 2, 2, data )
+            copy = VectorSSE.chain_mul( mat )
+            expect( copy.to_s ).to eq( mat.to_s )
+            expect( copy ).not_to be( mat )
+
+            copy.set( 0, 0, 99 )
+            expect( mat.at( 0, 0 ) ).to eq( 1 )
+         end
+      end
+
+      it "raises exception on mismatched chains" do
+         left = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 3 )
+         expect {
+            VectorSSE.chain_mul( left, VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 3 ) )
+         }.to raise_error RuntimeError, "invalid matrix dimensions"
+         expect {
+            VectorSSE.chain_mul( left, VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 3 ) )
+         }.to raise_error ArgumentError
+      end
+
+      it "raises exception on a split table that does not fit the chain" do
+         data = ::Array.new( 4, 1.0 )
+         expect {
+            VectorSSE.chain_mul_f32( [ data, data ], [ 2, 2, 2 ], [ 0, 900000, 0, 0 ] )
+         }.to raise_error ArgumentError, "matrix chain split out of range"
+         expect {
+            VectorSSE.chain_mul_f64( [ data, data, data ], [ 2, 2, 2, 2 ], [ 0, 0, 2, 0, 0, 1, 0, 0, 0 ] )
+         }.to raise_error ArgumentError, "matrix chain split out of range"
+         expect {
+            VectorSSE.chain_mul_f64( [ data, data ], [ 2, 2, 2 ], [ 0, 0, 0 ] )
+         }.to raise_error ArgumentError, "matrix chain does not match its dimensions"
+      end
+   end
+end
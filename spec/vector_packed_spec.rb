@@ -0,0 +1,198 @@
+begin
+   require 'vector_sse'
+rescue StandardError => e
+   # vector_sse is not installed as a gem
+   require File.join( '..', 'lib', 'vector_sse' )
+end
+
+require_relative 'spec_helper'
+
+RSpec.describe VectorSSE::PackedMat do
+
+   describe "constructor" do
+
+      it "raises exception on invalid type" do
+         expect {
+            VectorSSE::PackedMat.new( VectorSSE::Type::F32, 2, 1 )
+         }.to raise_error ArgumentError, "invalid packed matrix type for argument 0"
+      end
+
+      it "raises exception on out of range zero point" do
+         expect {
+            VectorSSE::PackedMat.new( VectorSSE::Type::S8, 2, 1, nil, zero_point: 200 )
+         }.to raise_error ArgumentError, "zero point out of range for packed type"
+      end
+
+      it "stores elements in packed form" do
+         { VectorSSE::Type::S8 => 12,
+           VectorSSE::Type::S16 => 24,
+           VectorSSE::Type::F16 => 24,
+           VectorSSE::Type::BF16 => 24 }.each do |type,size|
+            expect( VectorSSE::PackedMat.new( type, 3, 4 ).bytesize ).to eq( size )
+         end
+      end
+   end
+
+   describe "conversion" do
+
+      it "round trips half precision values" do
+         data = [ 1.0, -2.5, 0.333251953125, 65504.0, 6.103515625e-05, 5.960464477539063e-08, 0.0 ]
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 1, data.length, data )
+
+         result = mat.to_packed( VectorSSE::Type::F16 ).to_mat
+         expect( result.type ).to eq( VectorSSE::Type::F32 )
+
+         data.each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "rounds half precision to nearest even and saturates to infinity" do
+         data = [ 1.0 + 2.0 ** -11, 1.0 + 3 * 2.0 ** -11, 70000.0 ]
+         packed = VectorSSE::PackedMat.new( VectorSSE::Type::F16, 1, 3, data )
+
+         expect( packed.at( 0, 0 ) ).to eq( 1.0 )
+         expect( packed.at( 0, 1 ) ).to eq( 1.0 + 2.0 ** -9 )
+         expect( packed.at( 0, 2 ) ).to eq( Float::INFINITY )
+      end
+
+      it "round trips bfloat16 values" do
+         data = [ 1.0, -3.0, 0.5, 1.0 + 2.0 ** -7, 256.0 ]
+         packed = VectorSSE::PackedMat.new( VectorSSE::Type::BF16, 1, 5, data )
+
+         data.each_with_index do |value,index|
+            expect( packed.at( 0, index ) ).to eq( value )
+         end
+      end
+
+      it "quantizes and dequantizes with scale and zero point" do
+         data = [ 0.0, 0.5, 1.0, -1.0, 10.0, -10.0 ]
+         packed = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 2, 3, data, scale: 0.5, zero_point: 4 )
+         result = packed.to_mat
+
+         [ 0.0, 0.5, 1.0, -1.0, 10.0, -10.0 ].each_with_index do |value,index|
+            expect( result[ index ] ).to be_within( 1e-6 ).of( value )
+         end
+
+         saturated = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 1, 2, [ 100.0, -100.0 ], scale: 0.5 )
+         expect( saturated.at( 0, 0 ) ).to eq( 63.5 )
+         expect( saturated.at( 0, 1 ) ).to eq( -64.0 )
+      end
+
+      it "picks a symmetric scale from the largest magnitude" do
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 1, 3, [ 2.54, -1.26, 0.0 ] )
+         packed = mat.to_packed( VectorSSE::Type::S8 )
+
+         expect( packed.scale ).to be_within( 1e-9 ).of( 0.02 )
+         expect( packed.at( 0, 0 ) ).to be_within( 1e-6 ).of( 2.54 )
+         expect( packed.at( 0, 1 ) ).to be_within( 1e-6 ).of( -1.26 )
+      end
+   end
+
+   describe "matrix multiplication" do
+
+      left_data = [
+          1, -2,  3,  4, -5,  6,  7, -8,  9, 10, -11, 12, 13, -14, 15, 16, 17,
+         -1,  2, -3, -4,  5, -6, -7,  8, -9, 10,  11, 12, 13,  14, 15, 16, 17
+      ]
+      right_data = ( 0...( 17 * 3 ) ).map { |index| ( index % 7 ) - 3 }
+
+      expected = ::Array.new( 6, 0 )
+      2.times do |row|
+         3.times do |col|
+            17.times do |common|
+               expected[ row * 3 + col ] += left_data[ row * 17 + common ] * right_data[ common * 3 + col ]
+            end
+         end
+      end
+
+      it "returns exact int8 product" do
+         left = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 2, 17, left_data )
+         right = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 17, 3, right_data )
+
+         result = left * right
+         expect( result.type ).to eq( VectorSSE::Type::F32 )
+         expect( result.rows ).to eq( 2 )
+         expect( result.cols ).to eq( 3 )
+
+         expected.each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "applies scales and zero points to int8 product" do
+         left = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 2, 17, left_data.map { |v| v * 0.5 }, scale: 0.5, zero_point: -3 )
+         right = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 17, 3, right_data.map { |v| v * 0.25 }, scale: 0.25, zero_point: 5 )
+
+         result = left * right
+         expected.each_with_index do |value,index|
+            expect( result[ index ] ).to be_within( 1e-4 ).of( value * 0.125 )
+         end
+      end
+
+      it "does not overflow long int8 dot products" do
+         common = 140_001
+         left = VectorSSE::PackedMat.new( VectorSSE::Type::S8, 1, common,
+            ::Array.new( common, -255 ), zero_point: 127 )
+         right = VectorSSE::PackedMat.new( VectorSSE::Type::S8, common, 1,
+            ::Array.new( common, -255 ), zero_point: 127 )
+
+         value = 255 * 255 * common
+         expect( ( left * right )[ 0 ] ).to be_within( value * 1e-6 ).of( value )
+      end
+
+      it "returns half precision and bfloat16 products" do
+         [ VectorSSE::Type::S16, VectorSSE::Type::F16, VectorSSE::Type::BF16 ].each do |type|
+            left = VectorSSE::PackedMat.new( type, 2, 17, left_data )
+            right = VectorSSE::PackedMat.new( type, 17, 3, right_data )
+
+            result = left * right
+            expected.each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value )
+            end
+         end
+      end
+
+      it "multiplies across panels and threads" do
+         rows, common, cols = 70, 37, 21
+         random = Random.new( 5 )
+         left_values = ::Array.new( rows * common ) { random.rand( -3..3 ) }
+         right_values = ::Array.new( common * cols ) { random.rand( -3..3 ) }
+
+         product = ::Array.new( rows * cols, 0 )
+         rows.times do |row|
+            cols.times do |col|
+               common.times do |pos|
+                  product[ row * cols + col ] += left_values[ row * common + pos ] * right_values[ pos * cols + col ]
+               end
+            end
+         end
+
+         previous = VectorSSE.tuning
+         begin
+            VectorSSE.tuning = { gemm_f32_block_k: 16, gemm_f32_block_n: 8, gemm_work_per_thread: 1 }
+            with_thread_count( 4 ) do
+               [ VectorSSE::Type::S8, VectorSSE::Type::S16, VectorSSE::Type::F16, VectorSSE::Type::BF16 ].each do |type|
+                  left = VectorSSE::PackedMat.new( type, rows, common, left_values )
+                  right = VectorSSE::PackedMat.new( type, common, cols, right_values )
+
+                  result = left * right
+                  expect( ( 0...( rows * cols ) ).map { |pos| result[ pos ] } ).to eq( product )
+               end
+            end
+         ensure
+            VectorSSE.tuning = previous
+         end
+      end
+
+      it "raises exception on invalid factor dimensions" do
+         left = VectorSSE::PackedMat.new( VectorSSE::Type::F16, 2, 2 )
+         right = VectorSSE::PackedMat.new( VectorSSE::Type::F16, 3, 2 )
+
+         expect {
+            left * right
+         }.to raise_error "invalid matrix dimensions"
+      end
+   end
+
+end
@@ -0,0 +1,114 @@
+begin
+   require 'vector_sse'
+rescue StandardError => e
+   # vector_sse is not installed as a gem
+   require File.join( '..', 'lib', 'vector_sse' )
+end
+
+require_relative 'spec_helper'
+
+RSpec.describe VectorSSE::SparseMat do
+
+   describe "constructor" do
+
+      it "raises exception on integer type" do
+         expect {
+            VectorSSE::SparseMat.new( VectorSSE::Type::S32, 2, 2 )
+         }.to raise_error ArgumentError, "sparse matrices must be F32 or F64"
+      end
+
+      it "creates an all-zero matrix" do
+         sparse = VectorSSE::SparseMat.new( VectorSSE::Type::F64, 3, 2 )
+         expect( sparse.nnz ).to eq( 0 )
+         expect( sparse.to_mat.to_s ).to eq( VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 2, [ 0.0 ] * 6 ).to_s )
+      end
+
+      it "builds from unordered COO triples and sums duplicates" do
+         sparse = VectorSSE::SparseMat.from_coo( VectorSSE::Type::F64, 3, 3,
+            [ 2, 0, 1, 0, 2 ], [ 1, 2, 0, 2, 0 ], [ 5.0, 1.5, 3.0, 2.5, 4.0 ] )
+
+         expect( sparse.nnz ).to eq( 4 )
+         expect( sparse.at( 0, 2 ) ).to eq( 4.0 )
+         expect( sparse.at( 1, 1 ) ).to eq( 0.0 )
+         expect( sparse.to_mat.to_s ).to eq( VectorSSE::Mat.new( VectorSSE::Type::F64, 3, 3,
+            [ 0.0, 0.0, 4.0, 3.0, 0.0, 0.0, 4.0, 5.0, 0.0 ] ).to_s )
+      end
+
+      it "raises exception on out of bounds COO index" do
+         expect {
+            VectorSSE::SparseMat.from_coo( VectorSSE::Type::F32, 2, 2, [ 0, 2 ], [ 0, 0 ], [ 1.0, 1.0 ] )
+         }.to raise_error IndexError, "row index 2 out of bounds"
+      end
+
+      it "builds from the nonzeros of a dense matrix" do
+         data = [ 0.0, 1.0, 0.0, 0.0, 0.0, 2.0, 0.0, 0.0, 0.0, -3.0 ]
+         mat = VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 5, data )
+
+         sparse = mat.to_sparse
+         expect( sparse.nnz ).to eq( 3 )
+         expect( sparse.density ).to be_within( 0.0001 ).of( 0.3 )
+         expect( sparse.to_mat.to_s ).to eq( mat.to_s )
+      end
+   end
+
+   describe "multiplication" do
+
+      def dense_matrix( type, rows, cols, density, seed )
+         random = Random.new( seed )
+         data = ::Array.new( rows * cols ) do
+            ( random.rand < density ) ? ( random.rand( 200 ) - 100 ) / 8.0 : 0.0
+         end
+         VectorSSE::Mat.new( type, rows, cols, data )
+      end
+
+      it "multiplies by a dense vector" do
+         sparse = VectorSSE::SparseMat.from_coo( VectorSSE::Type::F32, 2, 7,
+            [ 0, 0, 0, 0, 0, 1 ], [ 0, 1, 2, 3, 6, 4 ], [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 ] )
+         vector = VectorSSE::Array.new( VectorSSE::Type::F32 )
+         vector.replace( [ 1.0, 1.0, 1.0, 1.0, 2.0, 3.0, 4.0 ] )
+
+         result = sparse * vector
+         expect( result.class ).to eq( VectorSSE::Array )
+         expect( result.type ).to eq( VectorSSE::Type::F32 )
+         expect( result ).to eq( [ 30.0, 12.0 ] )
+      end
+
+      it "multiplies by a dense matrix" do
+         dense = dense_matrix( VectorSSE::Type::F32, 6, 5, 0.4, 1 )
+         other = dense_matrix( VectorSSE::Type::F32, 5, 3, 1.0, 2 )
+
+         result = dense.to_sparse * other
+         expect( result.class ).to eq( VectorSSE::Mat )
+         expect( result.to_s ).to eq( ( dense * other ).to_s )
+      end
+
+      it "raises exception on mismatched dimensions" do
+         sparse = VectorSSE::SparseMat.new( VectorSSE::Type::F32, 2, 3 )
+         expect {
+            sparse * VectorSSE::Mat.new( VectorSSE::Type::F32, 2, 2 )
+         }.to raise_error RuntimeError, "invalid matrix dimensions"
+      end
+
+      it "raises exception on out of range column indices" do
+         expect {
+            VectorSSE.csr_to_dense_f32( [ 1.0 ].pack( "e" ), [ 100_000_000 ].pack( "L" ), [ 0, 1 ].pack( "L*" ), 2 )
+         }.to raise_error ArgumentError, "CSR column index out of bounds"
+      end
+
+      it "gives the same result when split across threads" do
+         dense = dense_matrix( VectorSSE::Type::F64, 400, 300, 0.6, 3 )
+         other = dense_matrix( VectorSSE::Type::F64, 300, 4, 1.0, 4 )
+         vector = VectorSSE::Array.new( VectorSSE::Type::F64 )
+         vector.replace( ::Array.new( 300 ) { |index| other.at( index, 0 ) } )
+         sparse = dense.to_sparse
+
+         serial_vector, serial_matrix = with_thread_count( 1 ) { [ sparse * vector, sparse * other ] }
+
+         with_thread_count( 4 ) do
+            expect( sparse * vector ).to eq( serial_vector )
+            expect( ( sparse * other ).to_s ).to eq( serial_matrix.to_s )
+         end
+      end
+   end
+
+end
@@ -0,0 +1,105 @@
+begin
+   require 'vector_sse'
+rescue StandardError => e
+   # vector_sse is not installed as a gem
+   require File.join( '..', 'lib', 'vector_sse' )
+end
+
+require_relative 'spec_helper'
+
+require 'tmpdir'
+
+RSpec.describe VectorSSE do
+
+   describe "tuning" do
+
+      before( :each ) do
+         @saved = VectorSSE.tuning
+      end
+
+      after( :each ) do
+         VectorSSE.tuning = @saved
+      end
+
+      it "lists every parameter" do
+         expect( VectorSSE.tuning.keys ).to eq( [
+            :gemm_f32_block_k, :gemm_f32_block_n, :gemm_f64_block_k, :gemm_f64_block_n,
+            :gemm_work_per_thread, :sparse_work_per_thread ] )
+      end
+
+      it "overrides individual parameters" do
+         VectorSSE.tuning = { gemm_f32_block_k: 32, "gemm_f32_block_n" => 64 }
+         expect( VectorSSE.tuning[ :gemm_f32_block_k ] ).to eq( 32 )
+         expect( VectorSSE.tuning[ :gemm_f32_block_n ] ).to eq( 64 )
+         expect( VectorSSE.tuning[ :gemm_f64_block_k ] ).to eq( @saved[ :gemm_f64_block_k ] )
+
+         left = VectorSSE::Mat.new( VectorSSE::Type::F32, 3, 70, ( 1..210 ).map { |v| ( v % 5 ).to_f } )
+         right = VectorSSE::Mat.new( VectorSSE::Type::F32, 70, 70, ( 1..4900 ).map { |v| ( v % 3 ).to_f } )
+         product = left * right
+         VectorSSE.reset_tuning!
+         expect( product.to_s ).to eq( ( left * right ).to_s )
+      end
+
+      it "rejects invalid settings without applying any" do
+         expect {
+            VectorSSE.tuning = { gemm_f32_block_k: 128, gemm_f32_block_n: 100 }
+         }.to raise_error ArgumentError, "invalid value 100 for tuning parameter gemm_f32_block_n"
+         expect( VectorSSE.tuning ).to eq( @saved )
+
+         expect {
+            VectorSSE.tuning = { block_m: 4 }
+         }.to raise_error ArgumentError, "unknown tuning parameter block_m"
+      end
+
+      it "saves and loads a profile" do
+         Dir.mktmpdir do |dir|
+            path = File.join( dir, 'profile' )
+            VectorSSE.tuning = { gemm_f64_block_n: 128, sparse_work_per_thread: 1000 }
+            VectorSSE.save_profile( path )
+
+            VectorSSE.reset_tuning!
+            expect( VectorSSE.load_profile( path ) ).to eq( VectorSSE.tuning )
+            expect( VectorSSE.tuning[ :gemm_f64_block_n ] ).to eq( 128 )
+            expect( VectorSSE.tuning[ :sparse_work_per_thread ] ).to eq( 1000 )
+         end
+      end
+
+      it "autotunes and persists the chosen parameters" do
+         Dir.mktmpdir do |dir|
+            path = File.join( dir, 'profile' )
+            result = VectorSSE.autotune!( size: 24, repeats: 1, path: path )
+
+            expect( result ).to eq( VectorSSE.tuning )
+            expect( VectorSSE::AUTOTUNE_BLOCK_K ).to include( result[ :gemm_f32_block_k ] )
+            expect( File.read( path ) ).to include( "gemm_f64_block_n #{result[ :gemm_f64_block_n ]}" )
+         end
+      end
+
+      it "restores the previous settings when interrupted" do
+         previous = VectorSSE.tuning
+         benchmark = VectorSSE.method( :benchmark_gemm )
+         blocks = VectorSSE::AUTOTUNE_BLOCK_K.length * VectorSSE::AUTOTUNE_BLOCK_N.length
+         calls = 0
+
+         # Interrupt the first multi-threaded cut-over run.
+         VectorSSE.define_singleton_method( :benchmark_gemm ) do |*args|
+            calls += 1
+            raise Interrupt if calls == blocks * 2 + 2
+            benchmark.call( *args )
+         end
+
+         begin
+            with_thread_count( 2 ) do
+               expect {
+                  VectorSSE.autotune!( size: 24, repeats: 1, save: false )
+               }.to raise_error Interrupt
+               expect( VectorSSE.tuning ).to eq( previous )
+               expect( VectorSSE.thread_count ).to eq( 2 )
+            end
+         ensure
+            VectorSSE.define_singleton_method( :benchmark_gemm, benchmark )
+         end
+      end
+   end
+
+end
@@ -5,8 +5,16 @@ rescue StandardError => e
    require File.join( '..', 'lib', 'vector_sse' )
 end
 
+require_relative 'spec_helper'
+
 RSpec.describe VectorSSE::Array do
 
+   def typed( type, values )
+      array = VectorSSE::Array.new( type )
+      array.replace( values )
+      array
+   end
+
    describe "constructor" do
    end
 
@@ -192,4 +200,431 @@ RSpec.describe VectorSSE::Array do
 
    end
 
+   describe "prefix sum" do
+
+      it "returns inclusive running sum" do
+         data = [ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 ]
+
+         arr = VectorSSE::Array.new( VectorSSE::Type::S32 )
+         arr.replace data
+
+         result = arr.cumsum
+         expect( result.type ).to eq( VectorSSE::Type::S32 )
+         expect( result.length ).to eq( data.length )
+
+         running = 0
+         data.each_with_index do |value,index|
+            running += value
+            expect( result[ index ] ).to eq( running )
+         end
+      end
+
+      it "returns exclusive running sum" do
+         data = [ 3, -1, 4, 1, -5 ]
+
+         arr = VectorSSE::Array.new( VectorSSE::Type::S64 )
+         arr.replace data
+
+         result = arr.cumsum( exclusive: true )
+
+         [ 0, 3, 2, 6, 7 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+      end
+
+      it "returns floating point running sum" do
+         data = [ 1.5, 2.25, -0.75, 3.1, 0.4, 6.2, -2.2 ]
+
+         [ VectorSSE::Type::F32, VectorSSE::Type::F64 ].each do |type|
+            arr = VectorSSE::Array.new( type )
+            arr.replace data
+
+            result = arr.cumsum
+
+            running = 0.0
+            data.each_with_index do |value,index|
+               running += value
+               expect( result[ index ] ).to be_within( 1e-5 ).of( running )
+            end
+         end
+      end
+
+      it "returns running product" do
+         data = [ 2, -1, 3, 1, 2, -2, 1 ]
+
+         [ VectorSSE::Type::S32, VectorSSE::Type::S64 ].each do |type|
+            arr = VectorSSE::Array.new( type )
+            arr.replace data
+
+            result = arr.cumprod
+            [ 2, -2, -6, -6, -12, 24, 24 ].each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value )
+            end
+
+            result = arr.cumprod( exclusive: true )
+            [ 1, 2, -2, -6, -6, -12, 24 ].each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value )
+            end
+         end
+      end
+
+      it "returns empty result for empty array" do
+         arr = VectorSSE::Array.new( VectorSSE::Type::F32 )
+         expect( arr.cumsum.length ).to eq( 0 )
+      end
+
+      it "scans long arrays in parallel" do
+         data = ::Array.new( 600_001 ) { |index| index % 7 - 3 }
+         arr = VectorSSE::Array.new( VectorSSE::Type::S64 )
+         arr.replace data
+
+         running = 0
+         inclusive = data.map { |value| running += value }
+
+         with_thread_count( 4 ) do
+            expect( arr.cumsum.to_a ).to eq( inclusive )
+            expect( arr.cumsum( exclusive: true ).to_a ).to eq( [ 0 ] + inclusive[ 0...-1 ] )
+         end
+      end
+   end
+
+   describe "type conversion" do
+
+      it "converts integers to floating point" do
+         arr = VectorSSE::Array.new( VectorSSE::Type::S32 )
+         arr.replace [ 1, -2, 3, 2147483647, -2147483648 ]
+
+         {  VectorSSE::Type::S64 => [ 1, -2, 3, 2147483647, -2147483648 ],
+            VectorSSE::Type::F32 => [ 1.0, -2.0, 3.0, 2147483648.0, -2147483648.0 ],
+            VectorSSE::Type::F64 => [ 1.0, -2.0, 3.0, 2147483647.0, -2147483648.0 ] }.each do |type,expected|
+            result = arr.astype( type )
+            expect( result.type ).to eq( type )
+            expected.each_with_index do |value,index|
+               expect( result[ index ] ).to eq( value )
+            end
+         end
+      end
+
+      it "rounds floating point to integers with each rounding mode" do
+         data = [ 1.5, 2.5, -1.5, -2.7, 3.2 ]
+
+         [ VectorSSE::Type::F32, VectorSSE::Type::F64 ].each do |type|
+            arr = VectorSSE::Array.new( type )
+            arr.replace data
+
+            {  nearest:  [ 2, 2, -2, -3, 3 ],
+               truncate: [ 1, 2, -1, -2, 3 ],
+               floor:    [ 1, 2, -2, -3, 3 ],
+               ceil:     [ 2, 3, -1, -2, 4 ] }.each do |rounding,expected|
+               [ VectorSSE::Type::S32, VectorSSE::Type::S64 ].each do |int_type|
+                  result = arr.astype( int_type, rounding: rounding )
+                  expect( result.type ).to eq( int_type )
+                  expected.each_with_index do |value,index|
+                     expect( result[ index ] ).to eq( value )
+                  end
+               end
+            end
+         end
+      end
+
+      it "saturates out of range values" do
+         arr = VectorSSE::Array.new( VectorSSE::Type::F64 )
+         arr.replace [ 1e12, -1e12, Float::NAN ]
+
+         result = arr.astype( VectorSSE::Type::S32 )
+         [ 2147483647, -2147483648, 0 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         arr = VectorSSE::Array.new( VectorSSE::Type::S64 )
+         arr.replace [ 4294967297, -4294967297 ]
+
+         result = arr.astype( VectorSSE::Type::S32 )
+         expect( result[ 0 ] ).to eq( 2147483647 )
+         expect( result[ 1 ] ).to eq( -2147483648 )
+
+         result = arr.astype( VectorSSE::Type::S32, saturate: false )
+         expect( result[ 0 ] ).to eq( 1 )
+         expect( result[ 1 ] ).to eq( -1 )
+      end
+
+      it "raises exception on invalid rounding mode" do
+         arr = VectorSSE::Array.new( VectorSSE::Type::F32, 2, 1.0 )
+         expect {
+            arr.astype( VectorSSE::Type::S32, rounding: :up )
+         }.to raise_error ArgumentError
+      end
+
+      it "adds double precision values without truncation" do
+         left = VectorSSE::Array.new( VectorSSE::Type::F64 )
+         left.replace [ 1.25, 2.5, -3.75 ]
+         right = VectorSSE::Array.new( VectorSSE::Type::F64 )
+         right.replace [ 0.5, 0.25, 0.125 ]
+
+         result = left + right
+         [ 1.75, 2.75, -3.625 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         expect( left.sum ).to eq( 0.0 )
+      end
+
+      it "promotes mixed operand types" do
+         ints = VectorSSE::Array.new( VectorSSE::Type::S32 )
+         ints.replace [ 1, 2, 3 ]
+         floats = VectorSSE::Array.new( VectorSSE::Type::F32 )
+         floats.replace [ 0.5, 0.25, 0.125 ]
+
+         result = ints + floats
+         expect( result.type ).to eq( VectorSSE::Type::F32 )
+         [ 1.5, 2.25, 3.125 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         result = floats - ints
+         expect( result.type ).to eq( VectorSSE::Type::F32 )
+         [ -0.5, -1.75, -2.875 ].each_with_index do |value,index|
+            expect( result[ index ] ).to eq( value )
+         end
+
+         longs = VectorSSE::Array.new( VectorSSE::Type::S64 )
+         longs.replace [ 10, 20, 30 ]
+         expect( ( ints + longs ).type ).to eq( VectorSSE::Type::S64 )
+         expect( ( floats + longs ).type ).to eq( VectorSSE::Type::F64 )
+      end
+   end
+
+   describe "gather and scatter" do
+
+      it "takes elements by index" do
+         vec = typed( VectorSSE::Type::F64, [ 0.5, 1.5, 2.5, 3.5 ] )
+         indices = typed( VectorSSE::Type::S32, [ 3, 0, -1, 3 ] )
+
+         result = vec.take( indices )
+         expect( result.class ).to eq( VectorSSE::Array )
+         expect( result.type ).to eq( VectorSSE::Type::F64 )
+         expect( result ).to eq( [ 3.5, 0.5, 3.5, 3.5 ] )
+      end
+
+      it "keeps Array#take for an element count" do
+         vec = typed( VectorSSE::Type::S32, [ 1, 2, 3 ] )
+         expect( vec.take( 2 ) ).to eq( [ 1, 2 ] )
+      end
+
+      it "raises exception on out of bounds or float indices" do
+         vec = typed( VectorSSE::Type::S32, [ 1, 2, 3 ] )
+         expect {
+            vec.take( [ 1, 3 ] )
+         }.to raise_error IndexError, "index 3 out of bounds"
+         expect {
+            vec.take( typed( VectorSSE::Type::F32, [ 1.0 ] ) )
+         }.to raise_error ArgumentError, "index arrays must be S32 or S64"
+      end
+
+      it "puts values at indices" do
+         vec = typed( VectorSSE::Type::S64, [ 0, 0, 0, 0 ] )
+         vec.put( typed( VectorSSE::Type::S64, [ 2, 0 ] ), [ 7, 9 ] )
+         expect( vec ).to eq( [ 9, 0, 7, 0 ] )
+
+         vec.put( [ 1, 3 ], 5 )
+         expect( vec ).to eq( [ 9, 5, 7, 5 ] )
+      end
+
+      it "accumulates repeated indices in a scatter-add" do
+         [ VectorSSE::Type::S32, VectorSSE::Type::S64,
+           VectorSSE::Type::F32, VectorSSE::Type::F64 ].each do |type|
+            vec = typed( type, [ 1, 1, 1 ] )
+            vec.index_add!( [ 0, 2, 0, 0 ], [ 1, 2, 3, 4 ] )
+            expect( vec ).to eq( [ 9, 1, 3 ] )
+         end
+      end
+   end
+
+   describe "histogram" do
+
+      it "counts values in uniform bins" do
+         vec = typed( VectorSSE::Type::F64, [ 0.0, 0.5, 1.0, 2.5, 3.9, 4.0, -1.0, 7.0 ] )
+         result = vec.histogram( bins: 4, range: 0..4 )
+         expect( result.class ).to eq( VectorSSE::Array )
+         expect( result.type ).to eq( VectorSSE::Type::S64 )
+         expect( result ).to eq( [ 2, 1, 1, 2 ] )
+      end
+
+      it "spans the element range by default" do
+         vec = typed( VectorSSE::Type::S32, [ 3, 1, 2, 3, 5 ] )
+         expect( vec.histogram( bins: 2 ) ).to eq( [ 2, 3 ] )
+         expect( typed( VectorSSE::Type::S32, [ 4, 4 ] ).histogram( bins: 1 ) ).to eq( [ 2 ] )
+      end
+
+      it "counts values between explicit edges" do
+         vec = typed( VectorSSE::Type::F32, [ 0.5, 1.0, 1.5, 9.0, 10.0, 11.0, -2.0 ] )
+         expect( vec.histogram( bins: [ 0, 1, 2, 10 ] ) ).to eq( [ 1, 2, 2 ] )
+      end
+
+      it "matches a scalar count across threads" do
+         random = Random.new( 7 )
+         vec = typed( VectorSSE::Type::F64, ::Array.new( 300001 ) { random.rand * 100.0 } )
+         edges = [ 0.0, 1.0, 5.0, 20.0, 50.0, 99.0 ]
+
+         uniform, explicit = with_thread_count( 4 ) do
+            [ vec.histogram( bins: 10, range: [ 0.0, 100.0 ] ), vec.histogram( bins: edges ) ]
+         end
+
+         expect( uniform ).to eq( ( 0...10 ).map { |bin| vec.count { |value| ( value / 10.0 ).floor == bin } } )
+         expect( explicit ).to eq( edges.each_cons( 2 ).map { |low,high| vec.count { |value| value >= low && value < high } } )
+      end
+
+      it "digitizes values by edge" do
+         vec = typed( VectorSSE::Type::S64, [ -5, 0, 3, 4, 5, 100 ] )
+         result = vec.digitize( [ 0, 4, 4, 10 ] )
+         expect( result.type ).to eq( VectorSSE::Type::S32 )
+         expect( result ).to eq( [ 0, 1, 1, 3, 3, 4 ] )
+      end
+
+      it "raises exception on unordered edges or range" do
+         vec = typed( VectorSSE::Type::F32, [ 1.0 ] )
+         expect {
+            vec.digitize( [ 1, 0 ] )
+         }.to raise_error ArgumentError, "bin edges must be non-decreasing"
+         expect {
+            vec.histogram( bins: 2, range: [ 1, 0 ] )
+         }.to raise_error ArgumentError, "histogram range must be increasing"
+      end
+
+      it "raises exception on exclusive or unbounded ranges" do
+         vec = typed( VectorSSE::Type::F32, [ 1.0 ] )
+         expect {
+            vec.histogram( bins: 2, range: 0...4 )
+         }.to raise_error ArgumentError, "histogram range must include its end"
+         expect {
+            vec.histogram( bins: 2, range: 0.. )
+         }.to raise_error ArgumentError, "histogram range must be bounded"
+         expect {
+            vec.histogram( bins: 2, range: ..4 )
+         }.to raise_error ArgumentError, "histogram range must be bounded"
+      end
+   end
+
+   describe "sort" do
+
+      def types
+         [ VectorSSE::Type::S32, VectorSSE::Type::S64,
+           VectorSSE::Type::F32, VectorSSE::Type::F64 ]
+      end
+
+      it "sorts every length around the vector blocks" do
+         random = Random.new( 3 )
+         types.each do |type|
+            [ 0, 1, 3, 4, 15, 16, 17, 33, 100, 1023 ].each do |length|
+               values = ::Array.new( length ) { random.rand( 200 ) - 100 }
+               vec = typed( type, values )
+               result = vec.sort
+               expect( result.class ).to eq( VectorSSE::Array )
+               expect( result.type ).to eq( type )
+               expect( result ).to eq( values.sort )
+            end
+         end
+      end
+
+      it "keeps Array#sort with a block and sorts in place" do
+         vec = typed( VectorSSE::Type::S32, [ 3, 1, 2 ] )
+         expect( vec.sort { |a,b| b <=> a } ).to eq( [ 3, 2, 1 ] )
+         vec.sort!
+         expect( vec ).to eq( [ 1, 2, 3 ] )
+      end
+
+      it "places NaNs last" do
+         vec = typed( VectorSSE::Type::F64, [ 2.0, Float::NAN, -1.0, 0.5 ] )
+         result = vec.sort
+         expect( result.first( 3 ) ).to eq( [ -1.0, 0.5, 2.0 ] )
+         expect( result.last.nan? ).to be true
+         expect( vec.argsort ).to eq( [ 2, 3, 0, 1 ] )
+      end
+
+      it "argsorts stably" do
+         random = Random.new( 5 )
+         values = ::Array.new( 500 ) { random.rand( 20 ) - 10 }
+         expected = ( 0...values.length ).sort_by { |pos| [ values[ pos ], pos ] }
+
+         types.each do |type|
+            result = typed( type, values ).argsort
+            expect( result.type ).to eq( VectorSSE::Type::S32 )
+            expect( result ).to eq( expected )
+         end
+      end
+
+      it "orders negative floats and zeros by value" do
+         vec = typed( VectorSSE::Type::F32, [ 0.0, -2.5, 1.5, -0.5, -100.0 ] )
+         expect( vec.argsort ).to eq( [ 4, 1, 3, 0, 2 ] )
+      end
+
+      it "selects the k largest elements" do
+         random = Random.new( 9 )
+         values = ::Array.new( 1000 ) { random.rand( 5000 ) }
+         expected = ( 0...values.length ).sort_by { |pos| [ -values[ pos ], pos ] }.first( 10 )
+
+         types.each do |type|
+            top, positions = typed( type, values ).top_k( 10, indices: true )
+            expect( top.type ).to eq( type )
+            expect( top ).to eq( expected.map { |pos| values[ pos ] } )
+            expect( positions ).to eq( expected )
+         end
+      end
+
+      it "selects every element when k exceeds the length" do
+         vec = typed( VectorSSE::Type::F32, [ 1.0, Float::NAN, 3.0, 3.0 ] )
+         expect( vec.top_k( 10, indices: true ) ).to eq( [ [ 3.0, 3.0, 1.0 ], [ 2, 3, 0 ] ] )
+         expect( vec.top_k( 0 ) ).to eq( [] )
+         expect {
+            vec.top_k( -1 )
+         }.to raise_error ArgumentError, "k must not be negative"
+      end
+   end
+
+   describe "convolution" do
+
+      it "convolves in every mode" do
+         [ VectorSSE::Type::F32, VectorSSE::Type::F64 ].each do |type|
+            signal = typed( type, [ 1.0, 2.0, 3.0 ] )
+            kernel = [ 0.0, 1.0, 0.5 ]
+
+            result = signal.convolve( kernel )
+            expect( result.type ).to eq( type )
+            expect( result ).to eq( [ 0.0, 1.0, 2.5, 4.0, 1.5 ] )
+            expect( signal.convolve( kernel, mode: :same ) ).to eq( [ 1.0, 2.5, 4.0 ] )
+            expect( signal.convolve( kernel, mode: :valid ) ).to eq( [ 2.5 ] )
+            expect( signal.convolve( [ 1.0, 1.0 ], mode: :same ) ).to eq( [ 1.0, 3.0, 5.0 ] )
+         end
+      end
+
+      it "cross-correlates without reversing the kernel" do
+         signal = typed( VectorSSE::Type::F64, [ 1.0, 2.0, 3.0, 4.0 ] )
+         expect( signal.correlate( [ 1.0, 0.0, -1.0 ] ) ).to eq( [ -2.0, -2.0 ] )
+      end
+
+      it "matches a scalar FIR filter across threads" do
+         random = Random.new( 11 )
+         values = ::Array.new( 20001 ) { random.rand( 10 ).to_f }
+         taps = ::Array.new( 31 ) { random.rand( 4 ).to_f }
+
+         result = with_thread_count( 4 ) do
+            typed( VectorSSE::Type::F64, values ).convolve( taps, mode: :valid )
+         end
+
+         expected = ( 0..( values.length - taps.length ) ).map do |pos|
+            taps.each_with_index.sum { |tap,offset| tap * values[ pos + taps.length - 1 - offset ] }
+         end
+         expect( result ).to eq( expected )
+      end
+
+      it "raises exception on integer arrays or invalid modes" do
+         expect {
+            typed( VectorSSE::Type::S32, [ 1, 2 ] ).convolve( [ 1 ] )
+         }.to raise_error ArgumentError, "convolution requires an F32 or F64 array"
+         expect {
+            typed( VectorSSE::Type::F32, [ 1.0 ] ).convolve( [ 1.0 ], mode: :wrap )
+         }.to raise_error ArgumentError, "invalid convolution mode :wrap"
+      end
+   end
+
 end